@@ -12,24 +12,172 @@ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTH
 WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
 */
 
+#if defined(__linux__)
+#define _GNU_SOURCE
+#elif !defined(_WIN32)
+#define _POSIX_C_SOURCE 200809L
+#endif
+
 #include <string.h>
 #include <stdio.h>
 #include <stdlib.h>
-#include "getline.c"
-
-#define MAX_BUFFER_SIZE 1000 * 100 // 100,000 data members per buffer
-#define FLT_EQUALS(a, b) (fabs(a - b) < 0.000001)
-#define GETLINE_ERR -1
-
-const char kFlipTexcoordArg[3] = "-f";
-const char kTangentArg[3] = "-t";
-const char kVerboseArg[3] = "-v";
-const char kInputExt[5] = ".obj";
-const char kVertexDelim[2] = " ";
-const char kPositionIndicator[2] = "v";
-const char kTexcoordIndicator[3] = "vt";
-const char kNormalIndicator[3] = "vn";
-const char kIndexIndicator[2] = "f";
+#include <stdint.h>
+#include <stddef.h>
+#include <math.h>
+#include <float.h>
+#include <stdarg.h>
+
+#if defined(__SSE2__) || defined(_M_X64) || defined(_M_AMD64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define SIMD_SSE2
+#include <emmintrin.h>
+#endif
+// AVX2 paths are compiled in on any x86 compiler that can target them per function and picked at runtime
+#if defined(SIMD_SSE2) && (defined(__GNUC__) || defined(__clang__))
+#define SIMD_AVX2
+#define TARGET_AVX2 __attribute__((target("avx2")))
+#include <immintrin.h>
+#elif defined(SIMD_SSE2) && defined(_MSC_VER)
+#define SIMD_AVX2
+#define TARGET_AVX2
+#include <immintrin.h>
+#include <intrin.h>
+#endif
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#include <psapi.h>
+#else
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/resource.h>
+#include <pthread.h>
+#include <dirent.h>
+#include <time.h>
+#endif
+
+#include "objtobin.h"
+#include "objtobin_stream.h"
+
+#define ARENA_MIN_BLOCK (1 << 20)
+#define ARENA_ALIGNMENT 64
+#define PARSE_MIN_CHUNK (256 * 1024) // Smallest slice of the file given to a parse worker
+#define PARSE_CHUNKS_PER_THREAD 4 // Over-split so uneven record density still balances
+#define OBJ_INVALID_INDEX 0xFFFFFFFF // Face index to an attribute the file does not have
+#define COPY_BUFFER_SIZE (4 * 1024 * 1024)
+#define STREAM_DEFAULT_BUDGET (1024 * 1024 * 1024) // Memory budget of -s without a size
+#define STREAM_FACE_BYTES 960 // Working memory per face of a streamed run, across weld tables, vertices and indices
+#define STREAM_LOD_FACE_BYTES 576 // Extra working memory per face when simplifying, mostly quadrics and edge tables
+#define STREAM_MESHLET_FACE_BYTES 64 // Extra working memory per face when building meshlets
+#define STREAM_BVH_FACE_BYTES 192 // Extra working memory per face when building BVHs
+#define STREAM_MIN_FACES 4096
+#define STREAM_RELEASE_BYTES (8 * 1024 * 1024) // Parsed input dropped from memory in steps of this size
+#define CACHE_SIM_SIZE 16 // FIFO post transform cache used to measure ACMR and ATVR
+#define FORSYTH_CACHE_SIZE 32 // LRU cache modelled by the vertex cache optimizer
+#define FORSYTH_CACHE_DECAY_POWER 1.5f
+#define FORSYTH_LAST_TRI_SCORE 0.75f
+#define FORSYTH_VALENCE_BOOST_SCALE 2.0f
+#define FORSYTH_VALENCE_BOOST_POWER 0.5f
+#define FORSYTH_MAX_VALENCE 32 // Remaining triangle counts with a precomputed score, larger ones are scored as needed
+#define FORSYTH_NO_TRIANGLE 0xFFFFFFFF
+#define LOD_MAX_LEVELS 8
+#define LOD_TARGET_RATIO 0.5 // Each level of detail aims for this fraction of the previous level's triangles
+#define LOD_MIN_REDUCTION 0.75 // A level keeping more than this fraction of the previous level's triangles ends the chain
+#define LOD_MIN_TRIANGLES 16 // Meshes and levels this small are not simplified further
+#define LOD_FLIP_COSINE 0.5 // Collapses turning a triangle's normal further than this are rejected
+#define LOD_MAX_ERROR 0.1 // Collapses moving the surface further than this fraction of the mesh's radius are rejected
+#define MESHLET_MAX_VERTICES 64
+#define MESHLET_MAX_TRIANGLES 124 // Keeps each triangle list a multiple of 4 bytes
+#define MESHLET_MIN_TRIANGLES 20 // Every meshlet of a mesh but the last, as a triangle adds at most 3 vertices
+#define MESHLET_CONE_MIN_DOT 0.1 // Meshlets with a normal further than this from the cone axis are never culled
+#define BVH_BINS 16 // Candidate splits along each axis of a BVH node, between bins of its triangles' centroids
+#define BVH_MAX_LEAF_TRIANGLES 4 // Larger nodes are always split, smaller ones only when the SAH says it pays
+#define BVH_TRAVERSAL_COST 1.0f // Of visiting a node, relative to testing a triangle
+#define TANGENT_BATCH 4 // Triangles per SoA batch, one per SSE lane
+#define TANGENT_ORIENT_PRESERVING 0
+#define TANGENT_ORIENT_MIRRORED 1
+#define TANGENT_ORIENT_ANY 2 // No uv area, so no handedness of its own
+#define TANGENT_SPLIT_COSINE 0.0f // Corners of a vertex whose tangents are further apart than this are split in to two vertices
+
+#ifdef _WIN32
+#define FileSeek(file, offset) _fseeki64((file), (long long)(offset), SEEK_SET)
+#define FileTell(file) (uint64_t)_ftelli64(file)
+#else
+#define FileSeek(file, offset) fseeko((file), (off_t)(offset), SEEK_SET)
+#define FileTell(file) (uint64_t)ftello(file)
+#endif
+
+#ifdef _WIN32
+typedef HANDLE Thread;
+typedef CRITICAL_SECTION Mutex;
+typedef LPTHREAD_START_ROUTINE ThreadFunc;
+#define THREAD_FUNC(name) DWORD WINAPI name(LPVOID param)
+#define THREAD_LOCAL __declspec(thread)
+#define AtomicFetchAdd(ptr, value) InterlockedExchangeAdd64((volatile LONG64*)(ptr), (value))
+#else
+typedef pthread_t Thread;
+typedef pthread_mutex_t Mutex;
+typedef void* (*ThreadFunc)(void*);
+#define THREAD_FUNC(name) void* name(void* param)
+#define THREAD_LOCAL __thread
+#define AtomicFetchAdd(ptr, value) __atomic_fetch_add((ptr), (value), __ATOMIC_SEQ_CST)
+#endif
+#define FLT_TOLERANCE 0.000001
+#define FLT_EQUALS(a, b) (fabs(a - b) < FLT_TOLERANCE)
+#define WELD_CELL_SCALE 1024.0 // Quantization grid for tolerant welding, cells must be much wider than FLT_TOLERANCE
+#define WELD_PROBE_MARGIN (FLT_TOLERANCE * 2.0) // Covers float rounding in FLT_EQUALS so no matching cell is missed
+#define WELD_CELL_BIAS 0.5 // Centers cells on multiples of the grid, so common values such as 0 and 1 do not straddle two cells
+#define WELD_MAX_COMPONENTS 16
+#define WELD_EMPTY 0xFFFFFFFF
+#define WELD_BATCH 1024 // New vertices gathered, keyed and interleaved together before they are welded in order
+#define WELD_KEY_LIMIT 1073741824.0 // Quantized values up to 2^30 fit the 32-bit SIMD keys, anything larger uses the scalar path
+#define LZ_HASH_BITS 16 // Entries of the LZ match finder, positions of recent 4 byte sequences
+#define LZ_MIN_MATCH 4
+#define LZ_MAX_OFFSET 65535
+#define STAGE_COUNT 11 // Timed stages of a conversion, see kStageNames
+#define PACK_SECTION_TYPES 9 // OBJTOBIN_SECTION_MESHES to OBJTOBIN_SECTION_BVH
+
+#ifndef OBJTOBIN_NO_MAIN
+static const char kFlipTexcoordArg[3] = "-f";
+static const char kTangentArg[3] = "-t";
+static const char kVerboseArg[3] = "-v";
+static const char kThreadsArg[3] = "-j";
+static const char kOptimizeArg[3] = "-o";
+static const char kCompactArg[3] = "-q";
+static const char kPlanarArg[3] = "-p";
+static const char kStreamArg[3] = "-s";
+static const char kLodArg[3] = "-l";
+static const char kCompressArg[3] = "-z";
+static const char kPositionFormatArg[11] = "--position";
+static const char kTexcoordFormatArg[11] = "--texcoord";
+static const char kNormalFormatArg[9] = "--normal";
+static const char kTangentFormatArg[10] = "--tangent";
+static const char kIndexFormatArg[8] = "--index";
+static const char kCacheArg[8] = "--cache";
+static const char kStatsArg[8] = "--stats";
+static const char kMeshletArg[11] = "--meshlets";
+static const char kSharedArg[9] = "--shared";
+static const char kBvhArg[6] = "--bvh";
+static const char kMinAreaArg[11] = "--min-area";
+static const char kToolVersion[4] = "3.1"; // Part of every cache key, change it whenever the same input and options give a different pack
+static const char kCacheManifestName[13] = "manifest.txt";
+static const char* const kFormatNames[5] = { "float", "half", "snorm16", "unorm16", "oct16" };
+static const char* const kShapeNames[3] = { "grid", "sphere", "soup" };
+static const char* const kAttributeSetNames[4] = { "p", "pt", "pn", "ptn" }; // Indexed by the texcoord and normal bits of ObjToBinVertexComponents
+static const char* const kStageNames[STAGE_COUNT] = { "open", "parse", "weld", "tangents", "optimize", "simplify", "meshlets", "bounds", "write", "compress", "total" };
+static const char kOutputExt[5] = ".bin";
+static const char kInputExt[5] = ".obj";
+#endif
+static const char kPositionIndicator[2] = "v";
+static const char kTexcoordIndicator[3] = "vt";
+static const char kNormalIndicator[3] = "vn";
+static const char kIndexIndicator[2] = "f";
+static const char kObjectIndicator[2] = "o";
+static const char kGroupIndicator[2] = "g";
+static const char kMaterialIndicator[7] = "usemtl";
 
 typedef int bool;
 enum { 
@@ -37,408 +185,5952 @@ enum {
     true  = 1
 };
 
-typedef enum Flags {
-    FLAG_VERBOSE = 0x0002,
-    FLAG_GENERATE_TANGENTS = 0x0004,
-    FLAG_FLIP_TEXCOORD_V = 0x0008
-} Flags;
-
-enum VertexComponents {
-    VERTEX_POSITION = 0x0001,
-    VERTEX_TEXCOORDS = 0x0002,
-    VERTEX_NORMALS = 0x0004,
-    VERTEX_TANGENTS = 0x0008
+// Kinds of obj record the parser acts on, anything else (comments, s, mtllib, l) is skipped
+typedef enum ObjRecord {
+    RECORD_OTHER = 0,
+    RECORD_POSITION = 1, // Also ends the current mesh in objs without groups, as attributes following faces start the next object
+    RECORD_TEXCOORD = 2,
+    RECORD_NORMAL = 3,
+    RECORD_FACE = 4,
+    RECORD_GROUP = 5 // o, g or usemtl, ends the current mesh
+} ObjRecord;
+
+// Passes FinishMesh runs on a welded mesh, each only if the flags also ask for it
+typedef enum MeshPasses {
+    PASS_TANGENTS = 0x01,
+    PASS_OPTIMIZE = 0x02, // Vertex cache and overdraw
+    PASS_FETCH = 0x04, // Vertex fetch, with PASS_OPTIMIZE
+    PASS_SIMPLIFY = 0x08,
+    PASS_MESHLETS = 0x10,
+    PASS_BOUNDS = 0x20, // And the BVH
+    PASS_ALL = 0x3F
+} MeshPasses;
+
+// Surfaces the synthetic obj generator can write
+typedef enum SyntheticShape {
+    SHAPE_GRID = 0, // Height field, every lattice point is one shared vertex
+    SHAPE_SPHERE = 1, // Uv sphere with a texture seam and degenerate pole triangles
+    SHAPE_SOUP = 2 // Scan-like soup of small triangles that share no vertices
+} SyntheticShape;
+
+// Growable bump allocator holding all per-file working memory. Blocks grow geometrically while a file
+// is converted and are coalesced in to a single block on reset, so steady state is one allocation.
+typedef struct ArenaBlock {
+    struct ArenaBlock* Prev;
+    size_t Size;
+    size_t Used;
+} ArenaBlock;
+
+typedef struct Arena {
+    ArenaBlock* Head;
+    size_t Reserved; // Bytes across all blocks
+    size_t Used; // Bytes handed out since the last reset
+    size_t Peak; // Most bytes in use at once since the last reset
+    size_t Allocations; // Allocations since the last reset
+    size_t Blocks; // Blocks taken from the heap since the last reset
+} Arena;
+
+// Position to roll an arena back to once temporary allocations are no longer needed
+typedef struct ArenaMark {
+    ArenaBlock* Block;
+    size_t BlockUsed;
+    size_t Used;
+} ArenaMark;
+
+// Number of each record type, found by a cheap pass before parsing so buffers can be sized exactly
+typedef struct ObjCounts {
+    size_t Lines;
+    size_t Positions;
+    size_t Texcoords;
+    size_t Normals;
+    size_t Faces; // Triangles, once polygons are fan triangulated
+    size_t Groups; // o, g and usemtl records
+    size_t FaceRuns; // Meshes, each is the faces between two records that end a mesh
+    size_t LargestFace; // Most triangles of a single face
+    bool LeadingFaces; // A face comes before any record that ends a mesh, used to join meshes split across parse chunks
+    bool TrailingFaces; // The last mesh is still open at the end
+    // The same when v records following faces end a mesh too, as they do in objs without groups
+    size_t ObjectRuns;
+    bool LeadingObjectFaces;
+    bool TrailingObjectFaces;
+} ObjCounts;
+
+// Newline aligned slice of the file parsed by one task, offsets are where its records land in the global buffers
+typedef struct ObjChunk {
+    const char* Data;
+    size_t Size;
+    ObjCounts Counts;
+    bool ContinuesRun; // The first face run carries on from the previous chunk and does not start a mesh
+    const char* InvalidRecord; // First malformed record, see ReportInvalidRecord
+    size_t PositionOffset;
+    size_t TexcoordOffset;
+    size_t NormalOffset;
+    size_t IndexOffset;
+    size_t RunOffset;
+} ObjChunk;
+
+// Seconds spent in each stage of converting a file, and how much it converted
+typedef struct ConvertStats {
+    double Open;
+    double Parse; // Counting and parsing records
+    double Weld;
+    double Tangents;
+    double Optimize;
+    double Simplify; // Generating levels of detail
+    double Meshlets;
+    double Bounds; // Mesh bounds and BVHs
+    double Write; // Encoding and writing the pack
+    double Compress; // Rewriting the pack with compressed vertices and indices
+    double Total;
+    uint64_t InputBytes;
+    uint64_t OutputBytes;
+    uint64_t Lines;
+    uint64_t Meshes;
+    uint64_t Triangles;
+    uint64_t StrippedTriangles; // Duplicate, degenerate and small triangles stripped after welding
+    uint64_t InputVertices; // Face corners, each one a vertex before welding
+    uint64_t UniqueVertices;
+    uint64_t PeakMemory; // Most working memory in use at once
+    uint64_t Allocations;
+    uint64_t HeapBlocks;
+} ConvertStats;
+
+#ifndef OBJTOBIN_NO_MAIN
+// Offsets of the ConvertStats timings, in kStageNames order
+static const size_t kStageOffsets[STAGE_COUNT] = {
+    offsetof(ConvertStats, Open), offsetof(ConvertStats, Parse), offsetof(ConvertStats, Weld), offsetof(ConvertStats, Tangents),
+    offsetof(ConvertStats, Optimize), offsetof(ConvertStats, Simplify), offsetof(ConvertStats, Meshlets),
+    offsetof(ConvertStats, Bounds), offsetof(ConvertStats, Write), offsetof(ConvertStats, Compress), offsetof(ConvertStats, Total)
+};
+#endif
+
+// One obj to convert in batch mode
+typedef struct BatchJob {
+    char* Input;
+    char* Output;
+    size_t Size;
+    bool Success;
+    bool Cached;
+    double Seconds;
+    ConvertStats Stats;
+} BatchJob;
+
+// A synthetic obj timed by benchmark mode, every case has the same number of triangles
+typedef struct BenchmarkCase {
+    const char* Name;
+    unsigned int Shape;
+    unsigned int Components; // ObjToBinVertexComponents written to the obj
+    unsigned int Objects;
+} BenchmarkCase;
+
+// One load of a pack by load benchmark mode, from the start of the load
+typedef struct LoadTimes {
+    double First; // Until the first mesh can be used
+    double All; // Until every mesh can be used
+} LoadTimes;
+
+typedef struct LoadProgress {
+    double Start;
+    double First;
+    uint32_t Loaded;
+    uint32_t Failed;
+} LoadProgress;
+
+// Per worker deque of job indices, the owner pops from the front and idle workers steal from the back
+typedef struct WorkQueue {
+    size_t* Jobs;
+    size_t Head;
+    size_t Tail;
+    Mutex Lock;
+} WorkQueue;
+
+typedef struct BatchWorker {
+    unsigned int Id;
+    unsigned int WorkerCount;
+    WorkQueue* Queues;
+    BatchJob* Jobs;
+    const ObjToBinOptions* Options; // Shared by every worker, each parses on its own thread
+    Arena Arena; // Each worker keeps its own buffers alive across all of its files
+} BatchWorker;
+
+typedef void (*ParallelTask)(void* context, size_t index);
+
+typedef struct ParallelJob {
+    ParallelTask Task;
+    void* Context;
+    size_t Count;
+    volatile int64_t Next;
+} ParallelJob;
+
+// Read only view of a whole input file
+typedef struct MappedFile {
+    const char* Name; // Named when reporting on the obj
+    const char* Data;
+    size_t Size;
+#ifdef _WIN32
+    HANDLE File;
+    HANDLE Mapping;
+#else
+    int Fd;
+#endif
+} MappedFile;
+
+// Walks a mapped obj one record (line) at a time without copying it
+typedef struct ObjScanner {
+    const char* Cursor; // Read position within the current record
+    const char* LineEnd;
+    const char* NextLine;
+    const char* End;
+    const char* Token; // Indicator of the current record, NULL at the end of the file
+    size_t TokenLength;
+} ObjScanner;
+
+// The converter builds packs directly in the loader's file records
+typedef ObjToBinHeader Header;
+typedef ObjToBinMesh Mesh;
+typedef ObjToBinOptions Options;
+
+// Hash tables used to weld vertices in expected linear time, scoped to a single mesh.
+// Attribute index triples map straight to the vertex they produced, anything else falls back to a
+// quantized grid of vertex values so that the FLT_EQUALS tolerance is still honoured.
+typedef struct IndexTriple {
+    unsigned int Pos;
+    unsigned int Tex;
+    unsigned int Norm;
+    unsigned int Vertex;
+} IndexTriple;
+
+typedef struct Welder {
+    size_t TripleMask; // Power of 2 table size in use for the current mesh, minus one
+    size_t CellMask;
+    IndexTriple* Triples;
+    unsigned int* CellHeads; // First vertex in each grid bucket
+    unsigned int* CellNext; // Next vertex in the same bucket, indexed by vertex - base
+    unsigned int Base; // First vertex of the mesh being welded
+    float Tolerance; // Largest float below FLT_TOLERANCE, a float compare against it matches FLT_EQUALS
+} Welder;
+
+// Where the components of new vertices come from, one component plane and attribute index array per working float
+typedef struct WeldSources {
+    const float* Planes[WELD_MAX_COMPONENTS]; // NULL for components that start as zero
+    const unsigned int* Indices[WELD_MAX_COMPONENTS];
+    unsigned int Floats;
+    unsigned int PaddedFloats; // Floats rounded up to whole SSE registers
+    int FlipPlane; // Component to store as 1 - value, -1 for none
+} WeldSources;
+
+// A batch of new vertices as component planes, then as padded rows, with the grid cells each one is welded by
+typedef struct WeldBatch {
+    float Planes[WELD_MAX_COMPONENTS][WELD_BATCH];
+    float Rows[WELD_BATCH * WELD_MAX_COMPONENTS];
+    int32_t Lo[WELD_MAX_COMPONENTS][WELD_BATCH]; // Cell of value - WELD_PROBE_MARGIN
+    int32_t Hi[WELD_MAX_COMPONENTS][WELD_BATCH]; // Cell of value + WELD_PROBE_MARGIN
+    int32_t Cell[WELD_MAX_COMPONENTS][WELD_BATCH]; // Cell the vertex is inserted in to
+    unsigned char Scalar[WELD_BATCH]; // Set when a value is out of key range, so the scalar welder is used
+} WeldBatch;
+
+// Batch kernels of the weld stage, chosen for the running CPU by SelectWeldKernels
+typedef struct WeldKernels {
+    void (*Gather)(WeldBatch* batch, const WeldSources* sources, size_t first, size_t count);
+    void (*Keys)(WeldBatch* batch, unsigned int floats, size_t count);
+    void (*Interleave)(WeldBatch* batch, unsigned int paddedFloats, size_t count);
+    const char* Name;
+} WeldKernels;
+
+// Weld state shared by every mesh of a file
+typedef struct ConvertContext {
+    WeldSources Sources;
+    WeldKernels Kernels;
+    WeldBatch* Batch;
+    unsigned int* CandidatePos;
+    unsigned int* CandidateTex;
+    unsigned int* CandidateNorm;
+    unsigned int* CandidateVertex; // Vertex each candidate welded to
+    ConvertStats* Stats;
+} ConvertContext;
+
+// What stripping removed from a mesh
+typedef struct StripCounts {
+    unsigned int Duplicate; // Repeats of an earlier triangle, starting from any of its corners
+    unsigned int Degenerate; // Using a vertex more than once
+    unsigned int Small; // Less area than the MinArea option
+} StripCounts;
+
+// Where a pack is written, a file or memory. Memory grows as it is written unless it is the caller's, then writes past
+// its capacity are dropped but still counted, so the size the pack needs is known.
+typedef struct Writer {
+    FILE* File; // NULL when writing to Data
+    unsigned char* Data;
+    size_t Capacity;
+    size_t Size; // Furthest byte written
+    size_t Position;
+    bool Fixed; // Data is the caller's and can not grow
+    bool Overflow; // Some writes went past a fixed Data
+} Writer;
+
+// Spill files and pack wide records of a streamed pack, gathered a mesh at a time until the pack is assembled
+typedef struct StreamOutput {
+    FILE* VertexFile;
+    FILE* IndexFile;
+    FILE* MeshletFile; // NULL without OBJTOBIN_FLAG_MESHLETS
+    FILE* BvhFile; // NULL without OBJTOBIN_FLAG_BVH
+    Mesh* Meshes;
+    ObjToBinLod* Lods;
+    ObjToBinMeshlet* Meshlets;
+    unsigned int MeshCount;
+    size_t LodCount;
+    size_t MeshletCount;
+    uint64_t IndexBytes;
+    uint64_t MeshletDataBytes;
+    uint64_t BvhBytes;
+    unsigned char* Scratch; // Encoding and copy buffer
+} StreamOutput;
+
+typedef struct Buffers {
+    size_t LineCount;
+    size_t PositionCount;
+    size_t TexcoordCount;
+    size_t NormalCount;
+
+    // Attribute values are kept as one plane per component so they can be gathered a SIMD register at a time
+    float* Positions[3];
+    float* Texcoords[2];
+    float* Normals[3];
+
+    unsigned int* PosIndices;
+    unsigned int* TexIndices;
+    unsigned int* NormIndices;
+
+    Header Header;
+    Mesh* Meshes;
+    unsigned int VertexFloats; // Floats making up a working vertex, the written layout is set by Header.Formats
+    float* Vertices;
+    unsigned int* Indices;
+
+    // Levels of detail of every mesh in mesh order. Each mesh's LodFirst is in to Lods, whose IndexOffset is in to LodIndices.
+    unsigned int* LodIndices;
+    size_t LodIndexCount;
+    ObjToBinLod* Lods;
+    size_t LodCount;
+
+    // Meshlets of every mesh in mesh order, each DataOffset is in to MeshletData
+    ObjToBinMeshlet* Meshlets;
+    size_t MeshletCount;
+    unsigned char* MeshletData;
+    size_t MeshletDataBytes;
+
+    // BVHs of every mesh in mesh order, each mesh's BvhOffset is in to BvhData
+    unsigned char* BvhData;
+    size_t BvhBytes;
+
+    Welder Welder;
+    Arena* Arena;
+    const Options* Options;
+    const char* Name; // Obj the buffers were read from, named when reporting on its meshes
+} Buffers;
+
+// One mesh of a shared vertex buffer, gathered so the per mesh passes only touch the vertices it uses
+typedef struct SharedView {
+    Buffers Buffers; // The working buffers with Vertices and Meshes swapped for the view's
+    Mesh Mesh;
+    unsigned int* Remap; // Local vertex of each shared vertex, WELD_EMPTY if the mesh does not use it
+    unsigned int* Global; // Shared vertex of each local vertex
+    float* Vertices;
+} SharedView;
+
+// Where the messages of the conversion running on a thread go. The tool prints them, while the library hands them
+// to the caller's Log, if any, and keeps the result of the first error for the entry point to return.
+typedef struct Reporter {
+    bool Library;
+    ObjToBinLog Log;
+    void* LogUser;
+    int Result;
+} Reporter;
+
+// Only the command line tool keeps state between conversions, conversions themselves take Options
+#ifndef OBJTOBIN_NO_MAIN
+static const char* g_CacheDir = NULL;
+static const char* g_StatsOutput = NULL; // "table" to print per file stats, otherwise the JSON file to write them to
+static volatile int64_t g_CacheTempCount = 0; // Makes the names of entries being stored unique across workers, the pid across processes
+#endif
+static THREAD_LOCAL Reporter g_Reporter; // Zeroed on every thread, so messages are printed unless a library entry point set it
+
+static void ReportArgs(const char* format, va_list args) {
+    if (!g_Reporter.Library) {
+        vprintf(format, args);
+        return;
+    }
+    if (!g_Reporter.Log) return;
+    char message[1024];
+    vsnprintf(message, sizeof(message), format, args);
+    size_t length = strlen(message);
+    if (length > 0 && message[length - 1] == '\n') message[length - 1] = '\0';
+    g_Reporter.Log(g_Reporter.LogUser, message);
+}
+
+// Verbose output and warnings
+static void Report(const char* format, ...) {
+    va_list args;
+    va_start(args, format);
+    ReportArgs(format, args);
+    va_end(args);
+}
+
+// Errors, result being the ObjToBinResult the library's entry points return for the first of them
+static void ReportError(int result, const char* format, ...) {
+    if (g_Reporter.Result == OBJTOBIN_OK) g_Reporter.Result = result;
+    va_list args;
+    va_start(args, format);
+    ReportArgs(format, args);
+    va_end(args);
+}
+
+// Same result as FLT_EQUALS on every component, tolerance being the largest float below FLT_TOLERANCE
+static bool VertexEqual(const float* v0, const float* v1, const size_t vertexSize, float tolerance) {
+    size_t i = 0;
+#ifdef SIMD_SSE2
+    const __m128 signMask = _mm_set1_ps(-0.0f);
+    const __m128 limit = _mm_set1_ps(tolerance);
+    for (; i + 4 <= vertexSize; i += 4) {
+        __m128 difference = _mm_andnot_ps(signMask, _mm_sub_ps(_mm_loadu_ps(&v0[i]), _mm_loadu_ps(&v1[i])));
+        if (_mm_movemask_ps(_mm_cmple_ps(difference, limit)) != 0xF) return false;
+    }
+#endif
+    for (; i < vertexSize; ++i) {
+        if (!FLT_EQUALS(v0[i], v1[i])) return false;
+    }
+    return true;
+}
+
+static ArenaBlock* ArenaAddBlock(Arena* arena, size_t size) {
+    ArenaBlock* block = malloc(sizeof(ArenaBlock) + ARENA_ALIGNMENT + size);
+    if (!block) return NULL;
+    block->Prev = arena->Head;
+    block->Size = size;
+    block->Used = 0;
+    arena->Head = block;
+    arena->Reserved += size;
+    arena->Blocks++;
+    return block;
+}
+
+// Makes sure the next allocations totalling up to size bytes come from one block
+static bool ArenaReserve(Arena* arena, size_t size) {
+    if (arena->Head && arena->Head->Size - arena->Head->Used >= size) return true;
+    size_t blockSize = arena->Head ? arena->Head->Size * 2 : ARENA_MIN_BLOCK;
+    while (blockSize < size) blockSize *= 2;
+    return ArenaAddBlock(arena, blockSize) != NULL;
+}
+
+static void* ArenaAlloc(Arena* arena, size_t size) {
+    size = (size + ARENA_ALIGNMENT - 1) & ~(size_t)(ARENA_ALIGNMENT - 1);
+    if (!ArenaReserve(arena, size)) return NULL;
+    ArenaBlock* block = arena->Head;
+    char* base = (char*)(((uintptr_t)(block + 1) + ARENA_ALIGNMENT - 1) & ~(uintptr_t)(ARENA_ALIGNMENT - 1));
+    void* ptr = base + block->Used;
+    block->Used += size;
+    arena->Used += size;
+    arena->Allocations++;
+    if (arena->Used > arena->Peak) arena->Peak = arena->Used;
+    return ptr;
+}
+
+// Releases everything allocated so far. Multiple blocks are merged in to one so the next file of a similar
+// size is served from a single block without fragmenting the heap.
+static void ArenaReset(Arena* arena) {
+    if (arena->Head && arena->Head->Prev) {
+        size_t total = arena->Reserved;
+        while (arena->Head) {
+            ArenaBlock* prev = arena->Head->Prev;
+            free(arena->Head);
+            arena->Head = prev;
+        }
+        arena->Reserved = 0;
+        ArenaAddBlock(arena, total);
+    }
+    else if (arena->Head) {
+        arena->Head->Used = 0;
+    }
+    arena->Used = 0;
+    arena->Peak = 0;
+    arena->Allocations = 0;
+    arena->Blocks = 0;
+}
+
+static ArenaMark ArenaGetMark(const Arena* arena) {
+    ArenaMark mark = { arena->Head, arena->Head ? arena->Head->Used : 0, arena->Used };
+    return mark;
+}
+
+// Frees everything allocated since the mark, blocks added since then are kept empty for reuse
+static void ArenaRelease(Arena* arena, ArenaMark mark) {
+    for (ArenaBlock* block = arena->Head; block && block != mark.Block; block = block->Prev) {
+        block->Used = 0;
+    }
+    if (mark.Block) mark.Block->Used = mark.BlockUsed;
+    arena->Used = mark.Used;
+}
+
+static void ArenaFree(Arena* arena) {
+    while (arena->Head) {
+        ArenaBlock* prev = arena->Head->Prev;
+        free(arena->Head);
+        arena->Head = prev;
+    }
+    memset(arena, 0, sizeof(Arena));
+}
+
+static uint64_t HashMix(uint64_t h) {
+    h ^= h >> 33;
+    h *= 0xFF51AFD7ED558CCDULL;
+    h ^= h >> 33;
+    h *= 0xC4CEB9FE1A85EC53ULL;
+    h ^= h >> 33;
+    return h;
+}
+
+#ifndef OBJTOBIN_NO_MAIN
+// Streaming XXH64, used to key cached conversions on the content of their input
+#define XXH_PRIME64_1 0x9E3779B185EBCA87ULL
+#define XXH_PRIME64_2 0xC2B2AE3D27D4EB4FULL
+#define XXH_PRIME64_3 0x165667B19E3779F9ULL
+#define XXH_PRIME64_4 0x85EBCA77C2B2AE63ULL
+#define XXH_PRIME64_5 0x27D4EB2F165667C5ULL
+
+typedef struct Hasher {
+    uint64_t Acc[4];
+    uint64_t Seed;
+    uint64_t Total;
+    unsigned char Buffer[32]; // Input not yet making up a whole 32 byte stripe
+    size_t Buffered;
+} Hasher;
+
+static uint64_t Rotl64(uint64_t x, int r) {
+    return (x << r) | (x >> (64 - r));
+}
+
+static uint64_t Read64(const unsigned char* p) {
+    uint64_t value;
+    memcpy(&value, p, sizeof(value));
+    return value;
+}
+
+static uint64_t XxhRound(uint64_t acc, uint64_t input) {
+    acc += input * XXH_PRIME64_2;
+    return Rotl64(acc, 31) * XXH_PRIME64_1;
+}
+
+static uint64_t XxhMergeRound(uint64_t acc, uint64_t value) {
+    acc ^= XxhRound(0, value);
+    return acc * XXH_PRIME64_1 + XXH_PRIME64_4;
+}
+
+static void HasherInit(Hasher* hasher, uint64_t seed) {
+    memset(hasher, 0, sizeof(Hasher));
+    hasher->Seed = seed;
+    hasher->Acc[0] = seed + XXH_PRIME64_1 + XXH_PRIME64_2;
+    hasher->Acc[1] = seed + XXH_PRIME64_2;
+    hasher->Acc[2] = seed;
+    hasher->Acc[3] = seed - XXH_PRIME64_1;
+}
+
+static void HasherUpdate(Hasher* hasher, const void* data, size_t size) {
+    const unsigned char* p = data;
+    const unsigned char* end = p + size;
+    hasher->Total += size;
+    if (hasher->Buffered + size < 32) {
+        if (size > 0) memcpy(hasher->Buffer + hasher->Buffered, p, size);
+        hasher->Buffered += size;
+        return;
+    }
+    if (hasher->Buffered > 0) {
+        size_t fill = 32 - hasher->Buffered;
+        memcpy(hasher->Buffer + hasher->Buffered, p, fill);
+        for (int k = 0; k < 4; ++k) hasher->Acc[k] = XxhRound(hasher->Acc[k], Read64(hasher->Buffer + k * 8));
+        p += fill;
+        hasher->Buffered = 0;
+    }
+    for (; end - p >= 32; p += 32) {
+        for (int k = 0; k < 4; ++k) hasher->Acc[k] = XxhRound(hasher->Acc[k], Read64(p + k * 8));
+    }
+    memcpy(hasher->Buffer, p, end - p);
+    hasher->Buffered = end - p;
+}
+
+static uint64_t HasherDigest(const Hasher* hasher) {
+    uint64_t h;
+    if (hasher->Total >= 32) {
+        h = Rotl64(hasher->Acc[0], 1) + Rotl64(hasher->Acc[1], 7) + Rotl64(hasher->Acc[2], 12) + Rotl64(hasher->Acc[3], 18);
+        for (int k = 0; k < 4; ++k) h = XxhMergeRound(h, hasher->Acc[k]);
+    }
+    else h = hasher->Seed + XXH_PRIME64_5;
+    h += hasher->Total;
+
+    const unsigned char* p = hasher->Buffer;
+    const unsigned char* end = p + hasher->Buffered;
+    for (; end - p >= 8; p += 8) {
+        h ^= XxhRound(0, Read64(p));
+        h = Rotl64(h, 27) * XXH_PRIME64_1 + XXH_PRIME64_4;
+    }
+    if (end - p >= 4) {
+        uint32_t value;
+        memcpy(&value, p, sizeof(value));
+        h ^= value * XXH_PRIME64_1;
+        h = Rotl64(h, 23) * XXH_PRIME64_2 + XXH_PRIME64_3;
+        p += 4;
+    }
+    for (; p < end; ++p) {
+        h ^= *p * XXH_PRIME64_5;
+        h = Rotl64(h, 11) * XXH_PRIME64_1;
+    }
+    h ^= h >> 33;
+    h *= XXH_PRIME64_2;
+    h ^= h >> 29;
+    h *= XXH_PRIME64_3;
+    h ^= h >> 32;
+    return h;
+}
+#endif
+
+static size_t NextPowerOf2(size_t n) {
+    size_t p = 16;
+    while (p < n) p <<= 1;
+    return p;
+}
+
+static bool WelderAllocate(Welder* welder, Arena* arena, size_t maxIndexCount) {
+    memset(welder, 0, sizeof(Welder));
+    welder->Triples = ArenaAlloc(arena, NextPowerOf2(maxIndexCount * 2) * sizeof(IndexTriple));
+    welder->CellHeads = ArenaAlloc(arena, NextPowerOf2(maxIndexCount * 2) * sizeof(unsigned int));
+    welder->CellNext = ArenaAlloc(arena, (maxIndexCount > 16 ? maxIndexCount : 16) * sizeof(unsigned int));
+    welder->Tolerance = (float)FLT_TOLERANCE;
+    if ((double)welder->Tolerance >= FLT_TOLERANCE) welder->Tolerance = nextafterf(welder->Tolerance, 0.0f);
+    return welder->Triples && welder->CellHeads && welder->CellNext;
+}
+
+// Prepares the welder for a mesh with up to indexCount face indices, the first new vertex being base
+static void WelderReset(Welder* welder, size_t indexCount, unsigned int base) {
+    size_t tripleCapacity = NextPowerOf2(indexCount * 2);
+    size_t cellCapacity = NextPowerOf2(indexCount * 2);
+    // Only clear the part of the tables this mesh uses so small meshes after large ones stay cheap
+    welder->TripleMask = tripleCapacity - 1;
+    welder->CellMask = cellCapacity - 1;
+    memset(welder->Triples, 0xFF, tripleCapacity * sizeof(IndexTriple));
+    memset(welder->CellHeads, 0xFF, cellCapacity * sizeof(unsigned int));
+    welder->Base = base;
+}
+
+// Returns the slot holding the triple, or the empty slot it should be inserted in to
+static IndexTriple* WelderFindTriple(Welder* welder, unsigned int pos, unsigned int tex, unsigned int norm) {
+    uint64_t h = HashMix(((uint64_t)pos << 32 | tex) ^ HashMix(norm));
+    for (size_t slot = h & welder->TripleMask;; slot = (slot + 1) & welder->TripleMask) {
+        IndexTriple* triple = &welder->Triples[slot];
+        if (triple->Vertex == WELD_EMPTY) return triple;
+        if (triple->Pos == pos && triple->Tex == tex && triple->Norm == norm) return triple;
+    }
+}
+
+static size_t WelderCellBucket(const Welder* welder, const int64_t* cell, size_t vertexSize) {
+    uint64_t h = 0;
+    for (size_t i = 0; i < vertexSize; ++i) {
+        h = HashMix(h ^ (uint64_t)cell[i]);
+    }
+    return h & welder->CellMask;
+}
+
+// Finds the lowest vertex of the mesh that is FLT_EQUALS to vertex, matching the result of a linear scan.
+// Returns WELD_EMPTY if there is none. Every vertex within tolerance lies in one of the grid cells
+// adjacent to the query value, and a dimension only needs its neighbour probed when near a cell edge.
+static unsigned int WelderSearch(const Welder* welder, const float* vertices, const float* vertex, size_t vertexSize, const int64_t* lo, const int64_t* hi) {
+    int64_t cell[WELD_MAX_COMPONENTS];
+    size_t straddling[WELD_MAX_COMPONENTS];
+    size_t straddleCount = 0;
+    for (size_t i = 0; i < vertexSize; ++i) {
+        if (lo[i] != hi[i]) straddling[straddleCount++] = i;
+    }
+
+    unsigned int best = WELD_EMPTY;
+    for (size_t combo = 0; combo < ((size_t)1 << straddleCount); ++combo) {
+        memcpy(cell, lo, vertexSize * sizeof(int64_t));
+        for (size_t s = 0; s < straddleCount; ++s) {
+            if (combo & ((size_t)1 << s)) cell[straddling[s]] = hi[straddling[s]];
+        }
+        for (unsigned int v = welder->CellHeads[WelderCellBucket(welder, cell, vertexSize)]; v != WELD_EMPTY; v = welder->CellNext[v - welder->Base]) {
+            if (v < best && VertexEqual(vertex, &vertices[(size_t)v * vertexSize], vertexSize, welder->Tolerance)) best = v;
+        }
+    }
+    return best;
+}
+
+static unsigned int WelderFindVertex(const Welder* welder, const float* vertices, const float* vertex, size_t vertexSize) {
+    int64_t lo[WELD_MAX_COMPONENTS];
+    int64_t hi[WELD_MAX_COMPONENTS];
+    for (size_t i = 0; i < vertexSize; ++i) {
+        // Non-finite components can never compare equal to anything
+        if (!isfinite(vertex[i]) || fabs(vertex[i]) * WELD_CELL_SCALE > 4e18) return WELD_EMPTY;
+        lo[i] = (int64_t)floor((vertex[i] - WELD_PROBE_MARGIN) * WELD_CELL_SCALE + WELD_CELL_BIAS);
+        hi[i] = (int64_t)floor((vertex[i] + WELD_PROBE_MARGIN) * WELD_CELL_SCALE + WELD_CELL_BIAS);
+    }
+    return WelderSearch(welder, vertices, vertex, vertexSize, lo, hi);
+}
+
+// As WelderFindVertex, for vertex k of a batch whose keys are in range
+static unsigned int WelderFindBatchVertex(const Welder* welder, const float* vertices, const WeldBatch* batch, size_t k, size_t vertexSize, unsigned int paddedFloats) {
+    int64_t lo[WELD_MAX_COMPONENTS];
+    int64_t hi[WELD_MAX_COMPONENTS];
+    for (size_t i = 0; i < vertexSize; ++i) {
+        lo[i] = batch->Lo[i][k];
+        hi[i] = batch->Hi[i][k];
+    }
+    return WelderSearch(welder, vertices, &batch->Rows[k * paddedFloats], vertexSize, lo, hi);
+}
+
+static void WelderInsertCell(Welder* welder, const int64_t* cell, size_t vertexSize, unsigned int v) {
+    unsigned int* head = &welder->CellHeads[WelderCellBucket(welder, cell, vertexSize)];
+    welder->CellNext[v - welder->Base] = *head;
+    *head = v;
+}
+
+// Adds a newly emitted vertex to the grid, must be called with increasing vertex indices
+static void WelderInsertVertex(Welder* welder, const float* vertex, size_t vertexSize, unsigned int v) {
+    int64_t cell[WELD_MAX_COMPONENTS];
+    for (size_t i = 0; i < vertexSize; ++i) {
+        if (!isfinite(vertex[i]) || fabs(vertex[i]) * WELD_CELL_SCALE > 4e18) return;
+        cell[i] = (int64_t)floor(vertex[i] * WELD_CELL_SCALE + WELD_CELL_BIAS);
+    }
+    WelderInsertCell(welder, cell, vertexSize, v);
+}
+
+static void WelderInsertBatchVertex(Welder* welder, const WeldBatch* batch, size_t k, size_t vertexSize, unsigned int v) {
+    int64_t cell[WELD_MAX_COMPONENTS];
+    for (size_t i = 0; i < vertexSize; ++i) {
+        cell[i] = batch->Cell[i][k];
+    }
+    WelderInsertCell(welder, cell, vertexSize, v);
+}
+
+// Scalar weld kernels, used where no SIMD is available and for batch tails
+static void GatherScalar(WeldBatch* batch, const WeldSources* sources, size_t first, size_t count) {
+    for (unsigned int c = 0; c < sources->PaddedFloats; ++c) {
+        float* out = batch->Planes[c];
+        const float* plane = sources->Planes[c];
+        const unsigned int* indices = sources->Indices[c];
+        if (!plane) {
+            memset(out, 0, count * sizeof(float));
+            continue;
+        }
+        for (size_t k = 0; k < count; ++k) {
+            out[k] = (int)c == sources->FlipPlane ? 1.0f - plane[indices[first + k]] : plane[indices[first + k]];
+        }
+    }
+}
+
+static void KeysScalar(WeldBatch* batch, unsigned int floats, size_t first, size_t count) {
+    for (unsigned int c = 0; c < floats; ++c) {
+        for (size_t k = first; k < count; ++k) {
+            double value = batch->Planes[c][k];
+            if (!(fabs(value * WELD_CELL_SCALE) < WELD_KEY_LIMIT)) {
+                batch->Scalar[k] = 1;
+                continue;
+            }
+            batch->Lo[c][k] = (int32_t)floor((value - WELD_PROBE_MARGIN) * WELD_CELL_SCALE + WELD_CELL_BIAS);
+            batch->Hi[c][k] = (int32_t)floor((value + WELD_PROBE_MARGIN) * WELD_CELL_SCALE + WELD_CELL_BIAS);
+            batch->Cell[c][k] = (int32_t)floor(value * WELD_CELL_SCALE + WELD_CELL_BIAS);
+        }
+    }
+}
+
+static void WeldKeysScalar(WeldBatch* batch, unsigned int floats, size_t count) {
+    memset(batch->Scalar, 0, count);
+    KeysScalar(batch, floats, 0, count);
+}
+
+static void InterleaveScalar(WeldBatch* batch, unsigned int paddedFloats, size_t first, size_t count) {
+    for (size_t k = first; k < count; ++k) {
+        for (unsigned int c = 0; c < paddedFloats; ++c) {
+            batch->Rows[k * paddedFloats + c] = batch->Planes[c][k];
+        }
+    }
+}
+
+static void WeldInterleaveScalar(WeldBatch* batch, unsigned int paddedFloats, size_t count) {
+    InterleaveScalar(batch, paddedFloats, 0, count);
+}
+
+#ifdef SIMD_SSE2
+static void GatherSse2(WeldBatch* batch, const WeldSources* sources, size_t first, size_t count) {
+    const __m128 one = _mm_set1_ps(1.0f);
+    for (unsigned int c = 0; c < sources->PaddedFloats; ++c) {
+        float* out = batch->Planes[c];
+        const float* plane = sources->Planes[c];
+        const unsigned int* indices = &sources->Indices[c][first];
+        size_t k = 0;
+        if (!plane) {
+            for (; k + 4 <= count; k += 4) _mm_storeu_ps(&out[k], _mm_setzero_ps());
+            for (; k < count; ++k) out[k] = 0.0f;
+            continue;
+        }
+        // No gather instruction, but the flip and stores are still a register at a time
+        for (; k + 4 <= count; k += 4) {
+            __m128 value = _mm_set_ps(plane[indices[k + 3]], plane[indices[k + 2]], plane[indices[k + 1]], plane[indices[k]]);
+            if ((int)c == sources->FlipPlane) value = _mm_sub_ps(one, value);
+            _mm_storeu_ps(&out[k], value);
+        }
+        for (; k < count; ++k) {
+            out[k] = (int)c == sources->FlipPlane ? 1.0f - plane[indices[k]] : plane[indices[k]];
+        }
+    }
+}
+
+// floor of two doubles to the low two int32 lanes, SSE2 only has truncation
+static __m128i FloorToInt32Sse2(__m128d value) {
+    __m128i truncated = _mm_cvttpd_epi32(value);
+    __m128d above = _mm_cmpgt_pd(_mm_cvtepi32_pd(truncated), value);
+    return _mm_add_epi32(truncated, _mm_shuffle_epi32(_mm_castpd_si128(above), _MM_SHUFFLE(3, 3, 2, 0)));
+}
+
+static void WeldKeysSse2(WeldBatch* batch, unsigned int floats, size_t count) {
+    const __m128d margin = _mm_set1_pd(WELD_PROBE_MARGIN);
+    const __m128d scale = _mm_set1_pd(WELD_CELL_SCALE);
+    const __m128d limit = _mm_set1_pd(WELD_KEY_LIMIT);
+    const __m128d bias = _mm_set1_pd(WELD_CELL_BIAS);
+    const __m128d signMask = _mm_set1_pd(-0.0);
+    memset(batch->Scalar, 0, count);
+    size_t vectorCount = count & ~(size_t)1;
+    for (unsigned int c = 0; c < floats; ++c) {
+        for (size_t k = 0; k < vectorCount; k += 2) {
+            __m128d value = _mm_cvtps_pd(_mm_castsi128_ps(_mm_loadl_epi64((const __m128i*)&batch->Planes[c][k])));
+            __m128d cell = _mm_mul_pd(value, scale);
+            int inRange = _mm_movemask_pd(_mm_cmplt_pd(_mm_andnot_pd(signMask, cell), limit));
+            if (!(inRange & 1)) batch->Scalar[k] = 1;
+            if (!(inRange & 2)) batch->Scalar[k + 1] = 1;
+            _mm_storel_epi64((__m128i*)&batch->Lo[c][k], FloorToInt32Sse2(_mm_add_pd(_mm_mul_pd(_mm_sub_pd(value, margin), scale), bias)));
+            _mm_storel_epi64((__m128i*)&batch->Hi[c][k], FloorToInt32Sse2(_mm_add_pd(_mm_mul_pd(_mm_add_pd(value, margin), scale), bias)));
+            _mm_storel_epi64((__m128i*)&batch->Cell[c][k], FloorToInt32Sse2(_mm_add_pd(cell, bias)));
+        }
+    }
+    KeysScalar(batch, floats, vectorCount, count);
+}
+
+// Transposes 4x4 blocks of component planes in to vertex rows
+static void WeldInterleaveSse2(WeldBatch* batch, unsigned int paddedFloats, size_t count) {
+    size_t vectorCount = count & ~(size_t)3;
+    for (size_t k = 0; k < vectorCount; k += 4) {
+        for (unsigned int c = 0; c < paddedFloats; c += 4) {
+            __m128 row0 = _mm_loadu_ps(&batch->Planes[c][k]);
+            __m128 row1 = _mm_loadu_ps(&batch->Planes[c + 1][k]);
+            __m128 row2 = _mm_loadu_ps(&batch->Planes[c + 2][k]);
+            __m128 row3 = _mm_loadu_ps(&batch->Planes[c + 3][k]);
+            _MM_TRANSPOSE4_PS(row0, row1, row2, row3);
+            _mm_storeu_ps(&batch->Rows[k * paddedFloats + c], row0);
+            _mm_storeu_ps(&batch->Rows[(k + 1) * paddedFloats + c], row1);
+            _mm_storeu_ps(&batch->Rows[(k + 2) * paddedFloats + c], row2);
+            _mm_storeu_ps(&batch->Rows[(k + 3) * paddedFloats + c], row3);
+        }
+    }
+    InterleaveScalar(batch, paddedFloats, vectorCount, count);
+}
+#endif
+
+#ifdef SIMD_AVX2
+TARGET_AVX2 static void GatherAvx2(WeldBatch* batch, const WeldSources* sources, size_t first, size_t count) {
+    const __m256 one = _mm256_set1_ps(1.0f);
+    for (unsigned int c = 0; c < sources->PaddedFloats; ++c) {
+        float* out = batch->Planes[c];
+        const float* plane = sources->Planes[c];
+        const unsigned int* indices = &sources->Indices[c][first];
+        size_t k = 0;
+        if (!plane) {
+            for (; k + 8 <= count; k += 8) _mm256_storeu_ps(&out[k], _mm256_setzero_ps());
+            for (; k < count; ++k) out[k] = 0.0f;
+            continue;
+        }
+        for (; k + 8 <= count; k += 8) {
+            __m256 value = _mm256_i32gather_ps(plane, _mm256_loadu_si256((const __m256i*)&indices[k]), 4);
+            if ((int)c == sources->FlipPlane) value = _mm256_sub_ps(one, value);
+            _mm256_storeu_ps(&out[k], value);
+        }
+        for (; k < count; ++k) {
+            out[k] = (int)c == sources->FlipPlane ? 1.0f - plane[indices[k]] : plane[indices[k]];
+        }
+    }
+}
+
+TARGET_AVX2 static void WeldKeysAvx2(WeldBatch* batch, unsigned int floats, size_t count) {
+    const __m256d margin = _mm256_set1_pd(WELD_PROBE_MARGIN);
+    const __m256d scale = _mm256_set1_pd(WELD_CELL_SCALE);
+    const __m256d limit = _mm256_set1_pd(WELD_KEY_LIMIT);
+    const __m256d bias = _mm256_set1_pd(WELD_CELL_BIAS);
+    const __m256d signMask = _mm256_set1_pd(-0.0);
+    memset(batch->Scalar, 0, count);
+    size_t vectorCount = count & ~(size_t)3;
+    for (unsigned int c = 0; c < floats; ++c) {
+        for (size_t k = 0; k < vectorCount; k += 4) {
+            __m256d value = _mm256_cvtps_pd(_mm_loadu_ps(&batch->Planes[c][k]));
+            __m256d cell = _mm256_mul_pd(value, scale);
+            int inRange = _mm256_movemask_pd(_mm256_cmp_pd(_mm256_andnot_pd(signMask, cell), limit, _CMP_LT_OQ));
+            for (int lane = 0; lane < 4; ++lane) {
+                if (!(inRange >> lane & 1)) batch->Scalar[k + lane] = 1;
+            }
+            _mm_storeu_si128((__m128i*)&batch->Lo[c][k], _mm256_cvttpd_epi32(_mm256_floor_pd(_mm256_add_pd(_mm256_mul_pd(_mm256_sub_pd(value, margin), scale), bias))));
+            _mm_storeu_si128((__m128i*)&batch->Hi[c][k], _mm256_cvttpd_epi32(_mm256_floor_pd(_mm256_add_pd(_mm256_mul_pd(_mm256_add_pd(value, margin), scale), bias))));
+            _mm_storeu_si128((__m128i*)&batch->Cell[c][k], _mm256_cvttpd_epi32(_mm256_floor_pd(_mm256_add_pd(cell, bias))));
+        }
+    }
+    KeysScalar(batch, floats, vectorCount, count);
+}
+#endif
+
+// Picks the widest weld kernels the running CPU supports
+static void SelectWeldKernels(WeldKernels* kernels) {
+    kernels->Gather = GatherScalar;
+    kernels->Keys = WeldKeysScalar;
+    kernels->Interleave = WeldInterleaveScalar;
+    kernels->Name = "scalar";
+#ifdef SIMD_SSE2
+    kernels->Gather = GatherSse2;
+    kernels->Keys = WeldKeysSse2;
+    kernels->Interleave = WeldInterleaveSse2;
+    kernels->Name = "SSE2";
+#endif
+#ifdef SIMD_AVX2
+    bool avx2 = false;
+#ifdef _MSC_VER
+    int info[4];
+    __cpuid(info, 1);
+    bool osxsave = (info[2] & (1 << 27)) != 0 && (info[2] & (1 << 28)) != 0;
+    if (osxsave && (_xgetbv(0) & 6) == 6) {
+        __cpuidex(info, 7, 0);
+        avx2 = (info[1] & (1 << 5)) != 0;
+    }
+#else
+    __builtin_cpu_init();
+    avx2 = __builtin_cpu_supports("avx2");
+#endif
+    if (avx2) {
+        kernels->Gather = GatherAvx2;
+        kernels->Keys = WeldKeysAvx2;
+        kernels->Name = "AVX2";
+    }
+#endif
+}
+
+// Most meshlets that triangles split across meshCount meshes can make
+static size_t GetMaxMeshlets(size_t triangles, size_t meshCount) {
+    return triangles / MESHLET_MIN_TRIANGLES + meshCount;
+}
+
+// Most BVH bytes that triangles split across meshCount meshes can take, a mesh's BVH being at most two nodes and a
+// list entry per triangle, padded to a pair of nodes
+static size_t GetMaxBvhBytes(size_t triangles, size_t meshCount) {
+    return triangles * (2 * sizeof(ObjToBinBvhNode) + sizeof(uint32_t)) + meshCount * 2 * sizeof(ObjToBinBvhNode);
+}
+
+// Sizes every buffer from the record counts of the file, the largest vertex being position, uv, normal, and tangent with handedness
+static bool AllocateBuffers(Buffers* buffers, Arena* arena, const ObjCounts* counts, const Options* options) {
+    memset(buffers, 0, sizeof(Buffers));
+    size_t indexCount = counts->Faces * 3;
+    size_t vertexSize = 3 + (counts->Texcoords ? 2 : 0) + (counts->Normals ? 3 : 0) + 4;
+    ArenaReset(arena);
+    if (!ArenaReserve(arena, (counts->Positions * 3 + counts->Texcoords * 2 + counts->Normals * 3) * sizeof(float) +
+                             indexCount * sizeof(unsigned int) * (options->LodLevels > 0 ? 5 : 4) + indexCount * vertexSize * sizeof(float) +
+                             (counts->FaceRuns + 1) * (sizeof(Mesh) + options->LodLevels * sizeof(ObjToBinLod)) + 24 * ARENA_ALIGNMENT)) {
+        return false;
+    }
+    bool planes = true;
+    for (size_t k = 0; k < 3; ++k) {
+        buffers->Positions[k] = ArenaAlloc(arena, counts->Positions * sizeof(float));
+        buffers->Normals[k] = ArenaAlloc(arena, counts->Normals * sizeof(float));
+        if (k < 2) buffers->Texcoords[k] = ArenaAlloc(arena, counts->Texcoords * sizeof(float));
+        planes = planes && buffers->Positions[k] && buffers->Normals[k] && (k == 2 || buffers->Texcoords[k]);
+    }
+    buffers->PosIndices = ArenaAlloc(arena, indexCount * sizeof(unsigned int));
+    buffers->TexIndices = ArenaAlloc(arena, indexCount * sizeof(unsigned int));
+    buffers->NormIndices = ArenaAlloc(arena, indexCount * sizeof(unsigned int));
+    buffers->Indices = ArenaAlloc(arena, indexCount * sizeof(unsigned int));
+    buffers->Vertices = ArenaAlloc(arena, indexCount * vertexSize * sizeof(float));
+    buffers->Meshes = ArenaAlloc(arena, (counts->FaceRuns + 1) * sizeof(Mesh));
+    if (buffers->Meshes) memset(buffers->Meshes, 0, (counts->FaceRuns + 1) * sizeof(Mesh));
+    buffers->Arena = arena;
+    buffers->Options = options;
+    buffers->LineCount = counts->Lines;
+    // A mesh's levels of detail never use more indices than the mesh itself
+    bool lods = true;
+    if (options->LodLevels > 0) {
+        buffers->LodIndices = ArenaAlloc(arena, indexCount * sizeof(unsigned int));
+        buffers->Lods = ArenaAlloc(arena, (counts->FaceRuns + 1) * options->LodLevels * sizeof(ObjToBinLod));
+        lods = buffers->LodIndices && buffers->Lods;
+    }
+    // Each triangle adds at most 3 vertices and 3 bytes of triangle list to its meshlet, which are padded to 4 bytes
+    bool meshlets = true;
+    if (options->Flags & OBJTOBIN_FLAG_MESHLETS) {
+        size_t maxMeshlets = GetMaxMeshlets(counts->Faces, counts->FaceRuns + 1);
+        buffers->Meshlets = ArenaAlloc(arena, maxMeshlets * sizeof(ObjToBinMeshlet));
+        buffers->MeshletData = ArenaAlloc(arena, indexCount * (sizeof(unsigned int) + 1) + maxMeshlets * 3);
+        meshlets = buffers->Meshlets && buffers->MeshletData;
+    }
+    bool bvh = true;
+    if (options->Flags & OBJTOBIN_FLAG_BVH) {
+        buffers->BvhData = ArenaAlloc(arena, GetMaxBvhBytes(counts->Faces, counts->FaceRuns + 1));
+        bvh = buffers->BvhData != NULL;
+    }
+
+    return planes && lods && meshlets && bvh && buffers->PosIndices &&
+           buffers->TexIndices && buffers->NormIndices && buffers->Indices && buffers->Vertices && buffers->Meshes;
+}
+
+static bool MapFile(MappedFile* file, const char* name) {
+    memset(file, 0, sizeof(MappedFile));
+    file->Name = name;
+#ifdef _WIN32
+    file->File = CreateFileA(name, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+    if (file->File == INVALID_HANDLE_VALUE) return false;
+    LARGE_INTEGER size;
+    if (!GetFileSizeEx(file->File, &size)) {
+        CloseHandle(file->File);
+        return false;
+    }
+    file->Size = (size_t)size.QuadPart;
+    if (file->Size == 0) return true;
+    file->Mapping = CreateFileMappingA(file->File, NULL, PAGE_READONLY, 0, 0, NULL);
+    if (file->Mapping) file->Data = MapViewOfFile(file->Mapping, FILE_MAP_READ, 0, 0, 0);
+    if (!file->Data) {
+        if (file->Mapping) CloseHandle(file->Mapping);
+        CloseHandle(file->File);
+        return false;
+    }
+#else
+    file->Fd = open(name, O_RDONLY);
+    if (file->Fd < 0) return false;
+    struct stat st;
+    if (fstat(file->Fd, &st) != 0) {
+        close(file->Fd);
+        return false;
+    }
+    file->Size = (size_t)st.st_size;
+    if (file->Size == 0) return true;
+    void* data = mmap(NULL, file->Size, PROT_READ, MAP_PRIVATE, file->Fd, 0);
+    if (data == MAP_FAILED) {
+        close(file->Fd);
+        return false;
+    }
+    posix_madvise(data, file->Size, POSIX_MADV_SEQUENTIAL);
+    file->Data = data;
+#endif
+    return true;
+}
+
+static void UnmapFile(MappedFile* file) {
+#ifdef _WIN32
+    if (file->Data) UnmapViewOfFile(file->Data);
+    if (file->Mapping) CloseHandle(file->Mapping);
+    CloseHandle(file->File);
+#else
+    if (file->Data) munmap((void*)file->Data, file->Size);
+    close(file->Fd);
+#endif
+    memset(file, 0, sizeof(MappedFile));
+}
+
+// Drops the pages of [begin, end) in a mapping, they are read back from the file if touched again. Does nothing on
+// Windows, where clean mapped pages are trimmed from the working set under memory pressure anyway.
+static void ReleaseMappedRange(const MappedFile* file, size_t begin, size_t end) {
+#ifndef _WIN32
+    size_t page = (size_t)sysconf(_SC_PAGESIZE);
+    begin = (begin + page - 1) / page * page;
+    end = end / page * page;
+    if (!file->Data || end <= begin) return;
+#ifdef __linux__
+    madvise((void*)(file->Data + begin), end - begin, MADV_DONTNEED); // glibc ignores POSIX_MADV_DONTNEED
+#else
+    posix_madvise((void*)(file->Data + begin), end - begin, POSIX_MADV_DONTNEED);
+#endif
+#endif
+}
+
+static void ScannerInit(ObjScanner* scanner, const char* data, size_t size) {
+    memset(scanner, 0, sizeof(ObjScanner));
+    scanner->NextLine = data;
+    scanner->End = data + size;
+}
+
+static bool IsSpace(char c) {
+    return c == ' ' || c == '\t' || c == '\r';
+}
+
+static void ScannerSkipSpace(ObjScanner* scanner) {
+    while (scanner->Cursor < scanner->LineEnd && IsSpace(*scanner->Cursor)) ++scanner->Cursor;
+}
+
+// Moves to the next line and reads its indicator token, returns false at the end of the file
+static bool ScannerNextRecord(ObjScanner* scanner) {
+    if (!scanner->NextLine || scanner->NextLine >= scanner->End) {
+        scanner->Token = NULL;
+        scanner->TokenLength = 0;
+        return false;
+    }
+    scanner->Cursor = scanner->NextLine;
+    scanner->LineEnd = memchr(scanner->Cursor, '\n', scanner->End - scanner->Cursor);
+    if (scanner->LineEnd) scanner->NextLine = scanner->LineEnd + 1;
+    else scanner->NextLine = scanner->LineEnd = scanner->End;
+
+    ScannerSkipSpace(scanner);
+    scanner->Token = scanner->Cursor;
+    while (scanner->Cursor < scanner->LineEnd && !IsSpace(*scanner->Cursor)) ++scanner->Cursor;
+    scanner->TokenLength = scanner->Cursor - scanner->Token;
+    return true;
+}
+
+static const double kPow10[] = {
+    1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+    1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
 };
 
-typedef struct Vec2 {
-    float x;
-    float y;
-} Vec2;
+// Parses a decimal float, giving the same result as atof. Values with an exactly representable mantissa
+// and small exponent are computed directly (Clinger's fast path), anything else goes through strtod. A missing
+// value is 0, valid is cleared for a malformed or over long one, such as a hex float, which is skipped as 0.
+static float ParseFloat(const char** cursor, const char* end, bool* valid) {
+    const char* start = *cursor;
+    const char* p = start;
+    bool negative = false;
+    uint64_t mantissa = 0;
+    int digits = 0;
+    int exponent = 0;
+    bool exact = true;
+    bool any = false;
+
+    if (p < end && (*p == '-' || *p == '+')) negative = *p++ == '-';
+    for (; p < end && *p >= '0' && *p <= '9'; ++p) {
+        any = true;
+        if (digits < 19) {
+            mantissa = mantissa * 10 + (*p - '0');
+            if (mantissa) ++digits;
+        }
+        else {
+            ++exponent;
+            exact &= *p == '0';
+        }
+    }
+    if (p < end && *p == '.') {
+        for (++p; p < end && *p >= '0' && *p <= '9'; ++p) {
+            any = true;
+            if (digits < 19) {
+                mantissa = mantissa * 10 + (*p - '0');
+                if (mantissa) ++digits;
+                --exponent;
+            }
+            else exact &= *p == '0';
+        }
+    }
+    if (any && p < end && (*p == 'e' || *p == 'E')) {
+        const char* e = p + 1;
+        bool negativeExp = false;
+        int value = 0;
+        if (e < end && (*e == '-' || *e == '+')) negativeExp = *e++ == '-';
+        if (e < end && *e >= '0' && *e <= '9') {
+            for (; e < end && *e >= '0' && *e <= '9'; ++e) {
+                if (value < 100000) value = value * 10 + (*e - '0');
+            }
+            exponent += negativeExp ? -value : value;
+            p = e;
+        }
+    }
+
+    bool terminated = p == end || IsSpace(*p) || *p == '#';
+    if (any && terminated && exact && mantissa <= (1ULL << 53) && exponent >= -22 && exponent <= 22) {
+        double value = (double)mantissa;
+        value = exponent < 0 ? value / kPow10[-exponent] : value * kPow10[exponent];
+        *cursor = p;
+        return (float)(negative ? -value : value);
+    }
+
+    // Slow path for long mantissas, large exponents and inf/nan, the mapping is not null terminated. Digits followed
+    // by anything else, such as 0x, are never a decimal float.
+    char token[64];
+    size_t len = 0;
+    for (p = start; p < end && !IsSpace(*p) && *p != '#'; ++p) {
+        if (len < sizeof(token) - 1) token[len] = *p;
+        ++len;
+    }
+    *cursor = p;
+    if (len == 0) return 0.0f;
+    if ((any && !terminated) || len >= sizeof(token)) {
+        *valid = false;
+        return 0.0f;
+    }
+    token[len] = '\0';
+    char* tokenEnd;
+    double value = strtod(token, &tokenEnd);
+    if (tokenEnd != token + len) {
+        *valid = false;
+        return 0.0f;
+    }
+    return (float)value;
+}
+
+static float ScannerFloat(ObjScanner* scanner, bool* valid) {
+    ScannerSkipSpace(scanner);
+    return ParseFloat(&scanner->Cursor, scanner->LineEnd, valid);
+}
+
+// Parses a 1 based obj index, or a negative one counting back from the end of the read elements, and returns it 0 based.
+// Returns OBJ_INVALID_INDEX for a missing index or one past the elements of the whole file.
+static unsigned int ScannerIndex(ObjScanner* scanner, size_t read, size_t total) {
+    bool negative = scanner->Cursor < scanner->LineEnd && *scanner->Cursor == '-';
+    if (negative) ++scanner->Cursor;
+    size_t value = 0;
+    for (; scanner->Cursor < scanner->LineEnd && *scanner->Cursor >= '0' && *scanner->Cursor <= '9'; ++scanner->Cursor) {
+        if (value <= total) value = value * 10 + (*scanner->Cursor - '0');
+    }
+    if (negative) return value > 0 && value <= read ? (unsigned int)(read - value) : OBJ_INVALID_INDEX;
+    return value > 0 && value <= total ? (unsigned int)(value - 1) : OBJ_INVALID_INDEX;
+}
+
+// Reads the floats of one v, vt, or vn record in to element index of each component plane. valid is cleared if
+// one is malformed.
+static void ExtractFloats(float* const* planes, size_t floats, size_t index, ObjScanner* scanner, bool* valid) {
+    for (size_t k = 0; k < floats; ++k) {
+        planes[k][index] = ScannerFloat(scanner, valid);
+    }
+}
+
+static bool IsIndexStart(const ObjScanner* scanner) {
+    return scanner->Cursor < scanner->LineEnd && ((*scanner->Cursor >= '0' && *scanner->Cursor <= '9') || *scanner->Cursor == '-');
+}
+
+// Reads a p, p/t, p//n or p/t/n corner in to its position, texcoord and normal index, setting bit k of given for each index
+// it has. read and total are the elements of each attribute read so far and in the whole file. Returns false if the corner
+// refers to an attribute that does not exist. A missing texcoord or normal index is 0.
+static bool ExtractCorner(unsigned int* corner, unsigned int* given, const size_t* read, const size_t* total, ObjScanner* scanner) {
+    corner[0] = ScannerIndex(scanner, read[0], total[0]);
+    corner[1] = 0;
+    corner[2] = 0;
+    *given = 1;
+    bool valid = corner[0] != OBJ_INVALID_INDEX;
+    if (!valid) corner[0] = 0;
+    for (size_t k = 1; k < 3 && scanner->Cursor < scanner->LineEnd && *scanner->Cursor == '/'; ++k) {
+        ++scanner->Cursor;
+        if (!IsIndexStart(scanner)) continue;
+        corner[k] = ScannerIndex(scanner, read[k], total[k]);
+        *given |= 1u << k;
+        if (corner[k] == OBJ_INVALID_INDEX) {
+            valid = false;
+            corner[k] = 0;
+        }
+    }
+    while (scanner->Cursor < scanner->LineEnd && !IsSpace(*scanner->Cursor)) ++scanner->Cursor;
+    return valid;
+}
+
+// Triangles a face is fan triangulated in to, counting the corners the same way as ExtractFace
+static size_t CountFaceTriangles(ObjScanner* scanner) {
+    size_t corners = 0;
+    const char* c = scanner->Cursor;
+    bool token = false;
+#ifdef SIMD_SSE2
+    // Runs for every face of the counting pass, so corners are counted 16 characters at a time as the starts of runs
+    // of non space characters. Lines with a comment take the scalar path, as do the last 16 bytes of the file.
+    __m128i blank = _mm_set1_epi8(' ');
+    __m128i tab = _mm_set1_epi8('\t');
+    __m128i cr = _mm_set1_epi8('\r');
+    __m128i hash = _mm_set1_epi8('#');
+    unsigned int carry = 0;
+    for (; c < scanner->LineEnd && scanner->End - c >= 16; c += 16) {
+        __m128i bytes = _mm_loadu_si128((const __m128i*)c);
+        __m128i space = _mm_or_si128(_mm_or_si128(_mm_cmpeq_epi8(bytes, blank), _mm_cmpeq_epi8(bytes, tab)), _mm_cmpeq_epi8(bytes, cr));
+        size_t left = scanner->LineEnd - c;
+        unsigned int line = left >= 16 ? 0xFFFF : (1u << left) - 1;
+        if (_mm_movemask_epi8(_mm_cmpeq_epi8(bytes, hash)) & line) {
+            c = scanner->Cursor;
+            corners = 0;
+            carry = 0;
+            break;
+        }
+        unsigned int word = ~(unsigned int)_mm_movemask_epi8(space) & line;
+        for (unsigned int starts = word & ~((word << 1) | carry); starts; starts &= starts - 1) ++corners;
+        carry = (word >> 15) & 1;
+    }
+    if (c > scanner->LineEnd) c = scanner->LineEnd;
+    token = carry != 0;
+#endif
+    for (; c < scanner->LineEnd; ++c) {
+        bool space = IsSpace(*c);
+        if (*c == '#' && !token) break;
+        if (!space && !token) ++corners;
+        token = !space;
+    }
+    scanner->Cursor = scanner->LineEnd;
+    return corners > 2 ? corners - 2 : 0;
+}
+
+// Fan triangulates a face of any number of corners in to the index arrays from i and returns the indices written, nothing for
+// faces of fewer than 3 corners. read is the positions, texcoords and normals read so far, which negative indices count back from.
+// valid is cleared unless every corner gives exactly the attributes the file has.
+static size_t ExtractFace(Buffers* buffers, size_t i, const size_t* read, ObjScanner* scanner, bool* valid) {
+    const size_t total[3] = { buffers->PositionCount, buffers->TexcoordCount, buffers->NormalCount };
+    const unsigned int required = 1u | (total[1] > 0 ? 2u : 0u) | (total[2] > 0 ? 4u : 0u);
+    unsigned int* const indices[3] = { buffers->PosIndices, buffers->TexIndices, buffers->NormIndices };
+    unsigned int first[3];
+    unsigned int previous[3];
+    unsigned int corner[3];
+    size_t corners = 0;
+    size_t written = 0;
+    while (true) {
+        ScannerSkipSpace(scanner);
+        if (scanner->Cursor >= scanner->LineEnd || *scanner->Cursor == '#') break;
+        unsigned int given;
+        if (!ExtractCorner(corner, &given, read, total, scanner) || given != required) *valid = false;
+        if (corners == 0) memcpy(first, corner, sizeof(corner));
+        if (corners >= 2) {
+            for (size_t k = 0; k < 3; ++k) {
+                indices[k][i + written] = first[k];
+                indices[k][i + written + 1] = previous[k];
+                indices[k][i + written + 2] = corner[k];
+            }
+            written += 3;
+        }
+        memcpy(previous, corner, sizeof(corner));
+        ++corners;
+    }
+    return written;
+}
+
+static bool CompareIndicator(const char* indicator, const ObjScanner* scanner) {
+    size_t indLen = strlen(indicator);
+    if (!scanner->Token || scanner->TokenLength != indLen) return false;
+    return memcmp(scanner->Token, indicator, indLen) == 0;
+}
+
+static ObjRecord ClassifyRecord(const ObjScanner* scanner) {
+    if (CompareIndicator(kIndexIndicator, scanner)) return RECORD_FACE;
+    if (CompareIndicator(kPositionIndicator, scanner)) return RECORD_POSITION;
+    if (CompareIndicator(kTexcoordIndicator, scanner)) return RECORD_TEXCOORD;
+    if (CompareIndicator(kNormalIndicator, scanner)) return RECORD_NORMAL;
+    if (CompareIndicator(kObjectIndicator, scanner) || CompareIndicator(kGroupIndicator, scanner) ||
+        CompareIndicator(kMaterialIndicator, scanner)) {
+        return RECORD_GROUP;
+    }
+    return RECORD_OTHER;
+}
+
+// Counts the records of a slice of a file, as if no mesh is open at its start. Mirrors the mesh splitting of ParseChunkTask,
+// whether or not v records end meshes, as that depends on the groups of the whole file.
+static void CountRecords(const char* data, size_t size, ObjCounts* counts) {
+    memset(counts, 0, sizeof(ObjCounts));
+    ObjScanner scanner;
+    ScannerInit(&scanner, data, size);
+    bool open = false; // Faces have been read since the last record that ends a mesh
+    bool boundary = false; // A record that ends a mesh has been read
+    bool objectOpen = false; // As open and boundary, with v records ending meshes too
+    bool objectBoundary = false;
+    while (ScannerNextRecord(&scanner)) {
+        counts->Lines++;
+        size_t triangles;
+        switch (ClassifyRecord(&scanner)) {
+        case RECORD_FACE:
+            triangles = CountFaceTriangles(&scanner);
+            if (triangles == 0) break;
+            counts->Faces += triangles;
+            if (triangles > counts->LargestFace) counts->LargestFace = triangles;
+            if (!open) {
+                counts->LeadingFaces |= !boundary;
+                counts->FaceRuns++;
+                open = true;
+            }
+            if (!objectOpen) {
+                counts->LeadingObjectFaces |= !objectBoundary;
+                counts->ObjectRuns++;
+                objectOpen = true;
+            }
+            break;
+        case RECORD_POSITION:
+            counts->Positions++;
+            objectOpen = false;
+            objectBoundary = true;
+            break;
+        case RECORD_TEXCOORD:
+            counts->Texcoords++;
+            break;
+        case RECORD_NORMAL:
+            counts->Normals++;
+            break;
+        case RECORD_GROUP:
+            counts->Groups++;
+            open = objectOpen = false;
+            boundary = objectBoundary = true;
+            break;
+        default:
+            break;
+        }
+    }
+    counts->TrailingFaces = open;
+    counts->TrailingObjectFaces = objectOpen;
+}
+
+// Adds the counts of the next slice of a file to total, with meshes ended by v records too if positionsEndMeshes is set.
+// Returns true if the slice's first mesh carries on the last mesh of the slices before it, which is then not counted again.
+static bool AddCounts(ObjCounts* total, ObjCounts* slice, bool positionsEndMeshes) {
+    if (positionsEndMeshes) {
+        slice->FaceRuns = slice->ObjectRuns;
+        slice->LeadingFaces = slice->LeadingObjectFaces;
+        slice->TrailingFaces = slice->TrailingObjectFaces;
+    }
+    bool continues = total->TrailingFaces && slice->LeadingFaces;
+    if (continues) slice->FaceRuns--;
+    total->Lines += slice->Lines;
+    total->Positions += slice->Positions;
+    total->Texcoords += slice->Texcoords;
+    total->Normals += slice->Normals;
+    total->Faces += slice->Faces;
+    total->Groups += slice->Groups;
+    total->FaceRuns += slice->FaceRuns;
+    if (slice->LargestFace > total->LargestFace) total->LargestFace = slice->LargestFace;
+    // A slice without faces or records that end a mesh leaves the last mesh open
+    if (slice->Faces || slice->Groups || (positionsEndMeshes && slice->Positions)) total->TrailingFaces = slice->TrailingFaces;
+    return continues;
+}
+
+static bool ThreadStart(Thread* thread, ThreadFunc func, void* arg) {
+#ifdef _WIN32
+    *thread = CreateThread(NULL, 0, func, arg, 0, NULL);
+    return *thread != NULL;
+#else
+    return pthread_create(thread, NULL, func, arg) == 0;
+#endif
+}
+
+static double GetTimeSeconds() {
+#ifdef _WIN32
+    LARGE_INTEGER counter, frequency;
+    QueryPerformanceCounter(&counter);
+    QueryPerformanceFrequency(&frequency);
+    return (double)counter.QuadPart / (double)frequency.QuadPart;
+#else
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec + (double)ts.tv_nsec * 1e-9;
+#endif
+}
+
+static void ThreadJoin(Thread thread) {
+#ifdef _WIN32
+    WaitForSingleObject(thread, INFINITE);
+    CloseHandle(thread);
+#else
+    pthread_join(thread, NULL);
+#endif
+}
+
+#ifndef OBJTOBIN_NO_MAIN
+static unsigned int GetCoreCount() {
+#ifdef _WIN32
+    SYSTEM_INFO info;
+    GetSystemInfo(&info);
+    return info.dwNumberOfProcessors;
+#else
+    long count = sysconf(_SC_NPROCESSORS_ONLN);
+    return count > 0 ? (unsigned int)count : 1;
+#endif
+}
+
+static void MutexInit(Mutex* mutex) {
+#ifdef _WIN32
+    InitializeCriticalSection(mutex);
+#else
+    pthread_mutex_init(mutex, NULL);
+#endif
+}
+
+static void MutexDestroy(Mutex* mutex) {
+#ifdef _WIN32
+    DeleteCriticalSection(mutex);
+#else
+    pthread_mutex_destroy(mutex);
+#endif
+}
+
+static void MutexLock(Mutex* mutex) {
+#ifdef _WIN32
+    EnterCriticalSection(mutex);
+#else
+    pthread_mutex_lock(mutex);
+#endif
+}
+
+static void MutexUnlock(Mutex* mutex) {
+#ifdef _WIN32
+    LeaveCriticalSection(mutex);
+#else
+    pthread_mutex_unlock(mutex);
+#endif
+}
+
+// Most memory the whole process has had resident, in bytes
+static uint64_t GetPeakResidentBytes() {
+#ifdef _WIN32
+    PROCESS_MEMORY_COUNTERS counters;
+    if (!GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters))) return 0;
+    return counters.PeakWorkingSetSize;
+#else
+    struct rusage usage;
+    if (getrusage(RUSAGE_SELF, &usage) != 0) return 0;
+#ifdef __APPLE__
+    return (uint64_t)usage.ru_maxrss;
+#else
+    return (uint64_t)usage.ru_maxrss * 1024;
+#endif
+#endif
+}
+#endif
+
+static THREAD_FUNC(ParallelWorker) {
+    ParallelJob* job = param;
+    size_t i;
+    while ((i = (size_t)AtomicFetchAdd(&job->Next, 1)) < job->Count) {
+        job->Task(job->Context, i);
+    }
+    return 0;
+}
+
+// Runs task for every index in [0, count) on up to threadCount threads including the caller
+static void ParallelFor(size_t count, unsigned int threadCount, ParallelTask task, void* context) {
+    ParallelJob job = { task, context, count, 0 };
+    Thread threads[256];
+    size_t started = 0;
+    if (threadCount > count) threadCount = (unsigned int)count;
+    if (threadCount > 256) threadCount = 256;
+    for (unsigned int t = 1; t < threadCount; ++t) {
+        if (ThreadStart(&threads[started], ParallelWorker, &job)) ++started;
+    }
+    ParallelWorker(&job);
+    for (size_t t = 0; t < started; ++t) {
+        ThreadJoin(threads[t]);
+    }
+}
+
+static void CountChunkTask(void* context, size_t index) {
+    ObjChunk* chunk = &((ObjChunk*)context)[index];
+    CountRecords(chunk->Data, chunk->Size, &chunk->Counts);
+}
+
+typedef struct ParseChunkContext {
+    ObjChunk* Chunks;
+    Buffers* Buffers;
+    unsigned int* RunStarts; // First index of every mesh, in file order
+    bool PositionsEndMeshes; // The file has no o, g or usemtl records
+} ParseChunkContext;
+
+// Reports the malformed record starting at record, numbering its line by counting back to the start of the file. Faces
+// are malformed by referring to an attribute the file does not have or leaving out one it has in any corner, v, vt
+// and vn records by a value that is not a decimal float.
+static void ReportInvalidRecord(const MappedFile* objFile, const char* record) {
+    size_t line = 1;
+    for (const char* c = objFile->Data; (c = memchr(c, '\n', record - c)) != NULL; ++c) ++line;
+    if (*record == 'f') {
+        ReportError(OBJTOBIN_ERROR_OBJ, "Error: The face on line %zu refers to a vertex attribute the obj does not have, or leaves out one it has "
+                    "in some of its corners! Aborting.", line);
+    }
+    else ReportError(OBJTOBIN_ERROR_OBJ, "Error: Line %zu has a value that is not a decimal float, or is too long! Aborting.", line);
+}
+
+// Parses records in any order. Attributes keep their file wide index spaces and a mesh is the faces between two o, g or usemtl
+// records. Files without any use v records instead, as positions following faces start the next object.
+static void ParseChunkTask(void* context, size_t index) {
+    ParseChunkContext* ctx = context;
+    ObjChunk* chunk = &ctx->Chunks[index];
+    Buffers* buffers = ctx->Buffers;
+    size_t read[3] = { chunk->PositionOffset, chunk->TexcoordOffset, chunk->NormalOffset };
+    size_t i = chunk->IndexOffset;
+    size_t run = chunk->RunOffset;
+    bool open = chunk->ContinuesRun;
+    bool valid = true;
+
+    ObjScanner scanner;
+    ScannerInit(&scanner, chunk->Data, chunk->Size);
+    while (ScannerNextRecord(&scanner)) {
+        size_t written;
+        switch (ClassifyRecord(&scanner)) {
+        case RECORD_FACE:
+            written = ExtractFace(buffers, i, read, &scanner, &valid);
+            if (written > 0 && !open) {
+                ctx->RunStarts[run++] = (unsigned int)i;
+                open = true;
+            }
+            i += written;
+            break;
+        case RECORD_POSITION:
+            ExtractFloats(buffers->Positions, 3, read[0]++, &scanner, &valid);
+            if (ctx->PositionsEndMeshes) open = false;
+            break;
+        case RECORD_TEXCOORD:
+            ExtractFloats(buffers->Texcoords, 2, read[1]++, &scanner, &valid);
+            break;
+        case RECORD_NORMAL:
+            ExtractFloats(buffers->Normals, 3, read[2]++, &scanner, &valid);
+            break;
+        case RECORD_GROUP:
+            open = false;
+            break;
+        default:
+            break;
+        }
+        if (!valid && !chunk->InvalidRecord) chunk->InvalidRecord = scanner.Token;
+    }
+}
+
+// Parses the file in newline aligned chunks on a pool of threads, or as a single chunk with one thread. Chunks are counted
+// in parallel, prefix sums of the counts give each chunk its write offsets in to the shared buffers and the state of the
+// mesh open at its start, then chunks are parsed in parallel. Meshes are the same however the file is split.
+static bool ReadObj(const MappedFile* objFile, Buffers* buffers, Arena* arena, const Options* options) {
+    unsigned int threadCount = options->ThreadCount;
+    size_t chunkSize = threadCount > 1 ? objFile->Size / ((size_t)threadCount * PARSE_CHUNKS_PER_THREAD) + 1 : objFile->Size;
+    if (chunkSize < PARSE_MIN_CHUNK) chunkSize = PARSE_MIN_CHUNK;
+    size_t maxChunks = objFile->Size / chunkSize + 1;
+    ObjChunk* chunks = malloc(maxChunks * sizeof(ObjChunk));
+    if (!chunks) {
+        ReportError(OBJTOBIN_ERROR_MEMORY, "Error: Failed to allocate required internal memory.");
+        return false;
+    }
+
+    size_t chunkCount = 0;
+    const char* end = objFile->Data + objFile->Size;
+    for (const char* start = objFile->Data; start < end;) {
+        const char* split = start + chunkSize < end ? start + chunkSize : end;
+        const char* newline = split < end ? memchr(split, '\n', end - split) : NULL;
+        split = newline ? newline + 1 : end;
+        memset(&chunks[chunkCount], 0, sizeof(ObjChunk));
+        chunks[chunkCount].Data = start;
+        chunks[chunkCount].Size = split - start;
+        chunkCount++;
+        start = split;
+    }
+
+    ParallelFor(chunkCount, threadCount, CountChunkTask, chunks);
+
+    size_t groups = 0;
+    for (size_t c = 0; c < chunkCount; ++c) {
+        groups += chunks[c].Counts.Groups;
+    }
+    ObjCounts total;
+    memset(&total, 0, sizeof(ObjCounts));
+    for (size_t c = 0; c < chunkCount; ++c) {
+        ObjChunk* chunk = &chunks[c];
+        chunk->PositionOffset = total.Positions;
+        chunk->TexcoordOffset = total.Texcoords;
+        chunk->NormalOffset = total.Normals;
+        chunk->IndexOffset = total.Faces * 3;
+        chunk->RunOffset = total.FaceRuns;
+        chunk->ContinuesRun = AddCounts(&total, &chunk->Counts, groups == 0);
+    }
+
+    ParseChunkContext context;
+    context.Chunks = chunks;
+    context.Buffers = buffers;
+    context.PositionsEndMeshes = groups == 0;
+    if (!AllocateBuffers(buffers, arena, &total, options) || !(context.RunStarts = ArenaAlloc(arena, (total.FaceRuns + 1) * sizeof(unsigned int)))) {
+        ReportError(OBJTOBIN_ERROR_MEMORY, "Error: Failed to allocate required internal memory.");
+        free(chunks);
+        return false;
+    }
+    buffers->Name = objFile->Name;
+    // Faces may refer to attributes anywhere in the file
+    buffers->PositionCount = total.Positions;
+    buffers->TexcoordCount = total.Texcoords;
+    buffers->NormalCount = total.Normals;
+    ParallelFor(chunkCount, threadCount, ParseChunkTask, &context);
+    const char* invalidRecord = NULL;
+    for (size_t c = 0; c < chunkCount && !invalidRecord; ++c) {
+        invalidRecord = chunks[c].InvalidRecord;
+    }
+    free(chunks);
+    if (invalidRecord) {
+        ReportInvalidRecord(objFile, invalidRecord);
+        return false;
+    }
+
+    buffers->Header.Components = OBJTOBIN_VERTEX_POSITION;
+    if (total.Texcoords) buffers->Header.Components |= OBJTOBIN_VERTEX_TEXCOORDS;
+    if (total.Normals) buffers->Header.Components |= OBJTOBIN_VERTEX_NORMALS;
+    buffers->Header.MeshCount = (unsigned int)total.FaceRuns;
+    context.RunStarts[total.FaceRuns] = (unsigned int)(total.Faces * 3);
+    for (size_t m = 0; m < total.FaceRuns; ++m) {
+        buffers->Meshes[m].IndexOffset = context.RunStarts[m];
+        buffers->Meshes[m].IndexCount = context.RunStarts[m + 1] - context.RunStarts[m];
+    }
+    return true;
+}
+
+// Per triangle tangent directions for a batch of triangles, laid out in SoA order so each lane is a triangle.
+// Follows MikkTSpace's InitTriInfo, the direction is normalized and flipped for triangles with mirrored uvs.
+typedef struct TangentBatch {
+    float Edge1[3][TANGENT_BATCH]; // p1 - p0
+    float Edge2[3][TANGENT_BATCH]; // p2 - p0
+    float Uv1[2][TANGENT_BATCH]; // uv1 - uv0
+    float Uv2[2][TANGENT_BATCH]; // uv2 - uv0
+    float Tangent[3][TANGENT_BATCH];
+    unsigned int Orient[TANGENT_BATCH];
+} TangentBatch;
+
+static void ComputeTangentBatch(TangentBatch* batch) {
+#ifdef SIMD_SSE2
+    __m128 tiny = _mm_set1_ps(FLT_MIN);
+    __m128 one = _mm_set1_ps(1.0f);
+    __m128 signMask = _mm_set1_ps(-0.0f);
+    __m128 area = _mm_sub_ps(_mm_mul_ps(_mm_loadu_ps(batch->Uv1[0]), _mm_loadu_ps(batch->Uv2[1])),
+                             _mm_mul_ps(_mm_loadu_ps(batch->Uv1[1]), _mm_loadu_ps(batch->Uv2[0])));
+    __m128 tangent[3];
+    __m128 lengthSq = _mm_setzero_ps();
+    for (int k = 0; k < 3; ++k) {
+        tangent[k] = _mm_sub_ps(_mm_mul_ps(_mm_loadu_ps(batch->Uv2[1]), _mm_loadu_ps(batch->Edge1[k])),
+                                _mm_mul_ps(_mm_loadu_ps(batch->Uv1[1]), _mm_loadu_ps(batch->Edge2[k])));
+        lengthSq = _mm_add_ps(lengthSq, _mm_mul_ps(tangent[k], tangent[k]));
+    }
+    __m128 length = _mm_sqrt_ps(lengthSq);
+    __m128 preserving = _mm_cmpgt_ps(area, _mm_setzero_ps());
+    __m128 valid = _mm_and_ps(_mm_cmpgt_ps(_mm_andnot_ps(signMask, area), tiny), _mm_cmpgt_ps(length, tiny));
+    __m128 sign = _mm_or_ps(one, _mm_andnot_ps(preserving, signMask));
+    __m128 scale = _mm_div_ps(sign, _mm_max_ps(length, tiny));
+    scale = _mm_or_ps(_mm_and_ps(valid, scale), _mm_andnot_ps(valid, one));
+    for (int k = 0; k < 3; ++k) {
+        _mm_storeu_ps(batch->Tangent[k], _mm_mul_ps(tangent[k], scale));
+    }
+    int preservingBits = _mm_movemask_ps(preserving);
+    int nonZeroBits = _mm_movemask_ps(_mm_cmpgt_ps(_mm_andnot_ps(signMask, area), tiny));
+    for (int lane = 0; lane < TANGENT_BATCH; ++lane) {
+        batch->Orient[lane] = !(nonZeroBits >> lane & 1) ? TANGENT_ORIENT_ANY : preservingBits >> lane & 1 ? TANGENT_ORIENT_PRESERVING : TANGENT_ORIENT_MIRRORED;
+    }
+#else
+    for (int lane = 0; lane < TANGENT_BATCH; ++lane) {
+        float area = batch->Uv1[0][lane] * batch->Uv2[1][lane] - batch->Uv1[1][lane] * batch->Uv2[0][lane];
+        float tangent[3];
+        for (int k = 0; k < 3; ++k) {
+            tangent[k] = batch->Uv2[1][lane] * batch->Edge1[k][lane] - batch->Uv1[1][lane] * batch->Edge2[k][lane];
+        }
+        float length = sqrtf(tangent[0] * tangent[0] + tangent[1] * tangent[1] + tangent[2] * tangent[2]);
+        float scale = fabsf(area) > FLT_MIN && length > FLT_MIN ? (area > 0.0f ? 1.0f : -1.0f) / length : 1.0f;
+        for (int k = 0; k < 3; ++k) {
+            batch->Tangent[k][lane] = tangent[k] * scale;
+        }
+        batch->Orient[lane] = !(fabsf(area) > FLT_MIN) ? TANGENT_ORIENT_ANY : area > 0.0f ? TANGENT_ORIENT_PRESERVING : TANGENT_ORIENT_MIRRORED;
+    }
+#endif
+}
+
+static void ProjectNormalize(float* v, const float* n) {
+    float d = v[0] * n[0] + v[1] * n[1] + v[2] * n[2];
+    for (int k = 0; k < 3; ++k) v[k] -= n[k] * d;
+    float length = sqrtf(v[0] * v[0] + v[1] * v[1] + v[2] * v[2]);
+    if (length > FLT_MIN) {
+        for (int k = 0; k < 3; ++k) v[k] /= length;
+    }
+}
+
+// Generates MikkTSpace compatible tangents for a welded mesh. Corners take their face tangent, projected on to the
+// vertex normal's plane and weighted by the corner angle. A vertex's corners are then gathered in to groups of one
+// handedness whose tangents are within TANGENT_SPLIT_COSINE of each other, and every group but the first is split
+// off in to a vertex appended to the end of the mesh. Corners of faces without uv area join the first group.
+// The mesh must be the last welded so far, and the working vertex must be position, texcoord, normal, tangent.
+static bool GenerateTangents(Buffers* buffers, unsigned int m) {
+    Mesh* mesh = &buffers->Meshes[m];
+    size_t vertexSize = buffers->VertexFloats;
+    size_t triCount = mesh->IndexCount / 3;
+    unsigned int* indices = &buffers->Indices[mesh->IndexOffset];
+    float* vertices = &buffers->Vertices[(size_t)mesh->VertexOffset * vertexSize];
+    ArenaMark mark = ArenaGetMark(buffers->Arena);
+    float* faceTangents = ArenaAlloc(buffers->Arena, triCount * 3 * sizeof(float));
+    unsigned char* faceOrient = ArenaAlloc(buffers->Arena, triCount);
+    float* cornerTangents = ArenaAlloc(buffers->Arena, mesh->IndexCount * 3 * sizeof(float));
+    unsigned int* offsets = ArenaAlloc(buffers->Arena, ((size_t)mesh->VertexCount + 1) * sizeof(unsigned int));
+    unsigned int* corners = ArenaAlloc(buffers->Arena, mesh->IndexCount * sizeof(unsigned int));
+    if ((triCount && (!faceTangents || !faceOrient || !cornerTangents || !corners)) || !offsets) {
+        ArenaRelease(buffers->Arena, mark);
+        return false;
+    }
+
+    TangentBatch batch;
+    for (size_t first = 0; first < triCount; first += TANGENT_BATCH) {
+        memset(&batch, 0, sizeof(batch));
+        size_t count = triCount - first < TANGENT_BATCH ? triCount - first : TANGENT_BATCH;
+        for (size_t lane = 0; lane < count; ++lane) {
+            const unsigned int* tri = &indices[(first + lane) * 3];
+            const float* v0 = &vertices[(size_t)(tri[0] - mesh->VertexOffset) * vertexSize];
+            const float* v1 = &vertices[(size_t)(tri[1] - mesh->VertexOffset) * vertexSize];
+            const float* v2 = &vertices[(size_t)(tri[2] - mesh->VertexOffset) * vertexSize];
+            for (int k = 0; k < 3; ++k) {
+                batch.Edge1[k][lane] = v1[k] - v0[k];
+                batch.Edge2[k][lane] = v2[k] - v0[k];
+            }
+            for (int k = 0; k < 2; ++k) {
+                batch.Uv1[k][lane] = v1[3 + k] - v0[3 + k];
+                batch.Uv2[k][lane] = v2[3 + k] - v0[3 + k];
+            }
+        }
+        ComputeTangentBatch(&batch);
+        for (size_t lane = 0; lane < count; ++lane) {
+            for (int k = 0; k < 3; ++k) faceTangents[(first + lane) * 3 + k] = batch.Tangent[k][lane];
+            faceOrient[first + lane] = (unsigned char)batch.Orient[lane];
+        }
+    }
+
+    // Corners are listed by vertex, in face order
+    unsigned int maxValence = 0;
+    memset(offsets, 0, ((size_t)mesh->VertexCount + 1) * sizeof(unsigned int));
+    for (size_t i = 0; i < mesh->IndexCount; ++i) offsets[indices[i] - mesh->VertexOffset + 1]++;
+    for (unsigned int v = 0; v < mesh->VertexCount; ++v) {
+        if (offsets[v + 1] > maxValence) maxValence = offsets[v + 1];
+        offsets[v + 1] += offsets[v];
+    }
+    for (size_t i = 0; i < mesh->IndexCount; ++i) {
+        corners[offsets[indices[i] - mesh->VertexOffset]++] = (unsigned int)i;
+    }
+    for (unsigned int v = mesh->VertexCount; v > 0; --v) offsets[v] = offsets[v - 1];
+    offsets[0] = 0;
+
+    for (size_t t = 0; t < triCount; ++t) {
+        for (size_t c = 0; c < 3; ++c) {
+            size_t i = t * 3 + c;
+            const float* p0 = &vertices[(size_t)(indices[t * 3 + (c + 2) % 3] - mesh->VertexOffset) * vertexSize];
+            const float* p1 = &vertices[(size_t)(indices[i] - mesh->VertexOffset) * vertexSize];
+            const float* p2 = &vertices[(size_t)(indices[t * 3 + (c + 1) % 3] - mesh->VertexOffset) * vertexSize];
+            const float* n = &p1[5];
+            float* tangent = &cornerTangents[i * 3];
+            float edge1[3] = { p0[0] - p1[0], p0[1] - p1[1], p0[2] - p1[2] };
+            float edge2[3] = { p2[0] - p1[0], p2[1] - p1[1], p2[2] - p1[2] };
+            memcpy(tangent, &faceTangents[t * 3], 3 * sizeof(float));
+            ProjectNormalize(tangent, n);
+            ProjectNormalize(edge1, n);
+            ProjectNormalize(edge2, n);
+            float cosine = edge1[0] * edge2[0] + edge1[1] * edge2[1] + edge1[2] * edge2[2];
+            float angle = acosf(cosine < -1.0f ? -1.0f : cosine > 1.0f ? 1.0f : cosine);
+            for (int k = 0; k < 3; ++k) tangent[k] *= angle;
+        }
+    }
+
+    // Groups of the vertex being resolved, a vertex has at most one per corner
+    float* groupTangents = ArenaAlloc(buffers->Arena, ((size_t)maxValence + 1) * 3 * sizeof(float));
+    unsigned char* groupMirrored = ArenaAlloc(buffers->Arena, (size_t)maxValence + 1);
+    unsigned int* cornerGroup = ArenaAlloc(buffers->Arena, ((size_t)maxValence + 1) * sizeof(unsigned int));
+    if (!groupTangents || !groupMirrored || !cornerGroup) {
+        ArenaRelease(buffers->Arena, mark);
+        return false;
+    }
+    unsigned int vertexCount = mesh->VertexCount;
+    for (unsigned int v = 0; v < vertexCount; ++v) {
+        const unsigned int* list = &corners[offsets[v]];
+        unsigned int valence = offsets[v + 1] - offsets[v];
+        unsigned int groupCount = 0;
+        // Preserving corners go first so the first group keeps the vertex's handedness where it can, then mirrored
+        // ones, then faces without uv area join the first group
+        for (int pass = 0; pass < 3; ++pass) {
+            for (unsigned int c = 0; c < valence; ++c) {
+                unsigned int i = list[c];
+                if (faceOrient[i / 3] != (unsigned char)(pass == 0 ? TANGENT_ORIENT_PRESERVING : pass == 1 ? TANGENT_ORIENT_MIRRORED : TANGENT_ORIENT_ANY)) continue;
+                const float* tangent = &cornerTangents[(size_t)i * 3];
+                unsigned int group = groupCount;
+                if (pass == 2 && groupCount > 0) group = 0;
+                else {
+                    float length = sqrtf(tangent[0] * tangent[0] + tangent[1] * tangent[1] + tangent[2] * tangent[2]);
+                    float bestCosine = TANGENT_SPLIT_COSINE;
+                    for (unsigned int g = 0; g < groupCount; ++g) {
+                        if (groupMirrored[g] != (pass == 1)) continue;
+                        const float* sum = &groupTangents[(size_t)g * 3];
+                        float sumLength = sqrtf(sum[0] * sum[0] + sum[1] * sum[1] + sum[2] * sum[2]);
+                        // A direction that is not known yet matches anything
+                        float cosine = length > FLT_MIN && sumLength > FLT_MIN ?
+                                       (tangent[0] * sum[0] + tangent[1] * sum[1] + tangent[2] * sum[2]) / (length * sumLength) : 1.0f;
+                        if (cosine >= bestCosine) {
+                            bestCosine = cosine;
+                            group = g;
+                        }
+                    }
+                }
+                if (group == groupCount) {
+                    memset(&groupTangents[(size_t)group * 3], 0, 3 * sizeof(float));
+                    groupMirrored[group] = pass == 1;
+                    groupCount++;
+                }
+                for (int k = 0; k < 3; ++k) groupTangents[(size_t)group * 3 + k] += tangent[k];
+                cornerGroup[c] = group;
+            }
+        }
+
+        if (groupCount == 0) {
+            // Unused by any face, it still gets a tangent
+            memset(groupTangents, 0, 3 * sizeof(float));
+            groupMirrored[0] = 0;
+            groupCount = 1;
+        }
+        float* vertex = &vertices[(size_t)v * vertexSize];
+        for (unsigned int g = 0; g < groupCount; ++g) {
+            float* target = vertex;
+            unsigned int index = mesh->VertexOffset + v;
+            if (g > 0) {
+                index = mesh->VertexOffset + mesh->VertexCount;
+                target = &vertices[(size_t)mesh->VertexCount++ * vertexSize];
+                memcpy(target, vertex, vertexSize * sizeof(float));
+                for (unsigned int c = 0; c < valence; ++c) {
+                    if (cornerGroup[c] == g) indices[list[c]] = index;
+                }
+            }
+            const float* t = &groupTangents[(size_t)g * 3];
+            float length = sqrtf(t[0] * t[0] + t[1] * t[1] + t[2] * t[2]);
+            if (length > FLT_MIN) {
+                for (int k = 0; k < 3; ++k) target[8 + k] = t[k] / length;
+            }
+            else {
+                // No usable uv direction, pick any vector perpendicular to the normal
+                float axis[3] = { fabsf(vertex[5]) < 0.9f ? 1.0f : 0.0f, fabsf(vertex[5]) < 0.9f ? 0.0f : 1.0f, 0.0f };
+                ProjectNormalize(axis, &vertex[5]);
+                memcpy(&target[8], axis, sizeof(axis));
+            }
+            target[11] = groupMirrored[g] ? -1.0f : 1.0f;
+        }
+    }
+    ArenaRelease(buffers->Arena, mark);
+    return true;
+}
+
+// Counts the misses of a FIFO post transform cache, giving ACMR (misses per triangle) and ATVR (misses per vertex)
+static void MeasureVertexCache(const unsigned int* indices, size_t indexCount, size_t vertexCount, unsigned int* timestamps, float* acmr, float* atvr) {
+    unsigned int time = CACHE_SIM_SIZE + 1;
+    size_t misses = 0;
+    memset(timestamps, 0, vertexCount * sizeof(unsigned int));
+    for (size_t i = 0; i < indexCount; ++i) {
+        if (time - timestamps[indices[i]] > CACHE_SIM_SIZE) {
+            timestamps[indices[i]] = time++;
+            misses++;
+        }
+    }
+    *acmr = indexCount ? (float)misses / (float)(indexCount / 3) : 0.0f;
+    *atvr = vertexCount ? (float)misses / (float)vertexCount : 0.0f;
+}
+
+// Vertex scores are rescored for every cache entry after every emitted triangle, so both terms are looked up
+typedef struct ForsythScores {
+    float Cache[FORSYTH_CACHE_SIZE + 1]; // By cache position + 1, so a vertex outside the cache scores Cache[0]
+    float Valence[FORSYTH_MAX_VALENCE]; // By remaining triangles
+} ForsythScores;
+
+static float ForsythValenceScore(unsigned int remaining) {
+    return FORSYTH_VALENCE_BOOST_SCALE * powf((float)remaining, -FORSYTH_VALENCE_BOOST_POWER);
+}
+
+static void InitForsythScores(ForsythScores* scores) {
+    scores->Cache[0] = 0.0f;
+    for (int c = 0; c < FORSYTH_CACHE_SIZE; ++c) {
+        if (c < 3) scores->Cache[c + 1] = FORSYTH_LAST_TRI_SCORE;
+        else scores->Cache[c + 1] = powf(1.0f - (float)(c - 3) / (FORSYTH_CACHE_SIZE - 3), FORSYTH_CACHE_DECAY_POWER);
+    }
+    scores->Valence[0] = 0.0f;
+    for (unsigned int r = 1; r < FORSYTH_MAX_VALENCE; ++r) {
+        scores->Valence[r] = ForsythValenceScore(r);
+    }
+}
+
+static float ForsythVertexScore(const ForsythScores* scores, int cachePosition, unsigned int remaining) {
+    if (remaining == 0) return -1.0f;
+    float valence = remaining < FORSYTH_MAX_VALENCE ? scores->Valence[remaining] : ForsythValenceScore(remaining);
+    return scores->Cache[cachePosition + 1] + valence;
+}
+
+// Tom Forsyth's linear-speed vertex cache optimisation, greedily emits the triangle whose vertices score highest
+// in a simulated LRU cache, favouring vertices with few remaining triangles so fans are finished off.
+static void OptimizeVertexCache(unsigned int* dst, const unsigned int* indices, size_t indexCount, size_t vertexCount, Arena* arena) {
+    size_t triCount = indexCount / 3;
+    unsigned int* valence = ArenaAlloc(arena, vertexCount * sizeof(unsigned int));
+    unsigned int* offsets = ArenaAlloc(arena, (vertexCount + 1) * sizeof(unsigned int));
+    unsigned int* adjacency = ArenaAlloc(arena, indexCount * sizeof(unsigned int));
+    int* cachePosition = ArenaAlloc(arena, vertexCount * sizeof(int));
+    float* vertexScore = ArenaAlloc(arena, vertexCount * sizeof(float));
+    float* triScore = ArenaAlloc(arena, triCount * sizeof(float));
+    char* emitted = ArenaAlloc(arena, triCount);
+    if (!valence || !offsets || !adjacency || !cachePosition || !vertexScore || !triScore || !emitted) {
+        memcpy(dst, indices, indexCount * sizeof(unsigned int));
+        return;
+    }
+
+    ForsythScores scores;
+    InitForsythScores(&scores);
+    memset(valence, 0, vertexCount * sizeof(unsigned int));
+    for (size_t i = 0; i < indexCount; ++i) valence[indices[i]]++;
+    offsets[0] = 0;
+    for (size_t v = 0; v < vertexCount; ++v) {
+        offsets[v + 1] = offsets[v] + valence[v];
+        valence[v] = 0;
+    }
+    // valence becomes the number of triangles still to be emitted, which sit at the front of each adjacency list
+    for (size_t t = 0; t < triCount; ++t) {
+        for (size_t k = 0; k < 3; ++k) {
+            unsigned int v = indices[t * 3 + k];
+            adjacency[offsets[v] + valence[v]++] = (unsigned int)t;
+        }
+    }
+    for (size_t v = 0; v < vertexCount; ++v) {
+        cachePosition[v] = -1;
+        vertexScore[v] = ForsythVertexScore(&scores, -1, valence[v]);
+    }
+    unsigned int best = FORSYTH_NO_TRIANGLE;
+    float bestScore = -1.0f;
+    for (size_t t = 0; t < triCount; ++t) {
+        triScore[t] = vertexScore[indices[t * 3]] + vertexScore[indices[t * 3 + 1]] + vertexScore[indices[t * 3 + 2]];
+        emitted[t] = 0;
+        if (triScore[t] > bestScore) {
+            bestScore = triScore[t];
+            best = (unsigned int)t;
+        }
+    }
+
+    unsigned int cache[FORSYTH_CACHE_SIZE + 3];
+    unsigned int newCache[FORSYTH_CACHE_SIZE + 3];
+    size_t cacheCount = 0;
+    size_t scan = 0;
+    for (size_t out = 0; out < triCount; ++out) {
+        if (best == FORSYTH_NO_TRIANGLE) {
+            // Nothing in the cache is adjacent to a remaining triangle, restart from the next unemitted one
+            while (emitted[scan]) scan++;
+            best = (unsigned int)scan;
+        }
+        const unsigned int* tri = &indices[best * 3];
+        memcpy(&dst[out * 3], tri, 3 * sizeof(unsigned int));
+        emitted[best] = 1;
+
+        for (size_t k = 0; k < 3; ++k) {
+            unsigned int v = tri[k];
+            unsigned int* list = &adjacency[offsets[v]];
+            for (unsigned int a = 0; a < valence[v]; ++a) {
+                if (list[a] == best) {
+                    list[a] = list[--valence[v]];
+                    list[valence[v]] = best;
+                    break;
+                }
+            }
+        }
+
+        size_t newCount = 0;
+        for (size_t k = 0; k < 3; ++k) newCache[newCount++] = tri[k];
+        for (size_t c = 0; c < cacheCount; ++c) {
+            unsigned int v = cache[c];
+            if (v != tri[0] && v != tri[1] && v != tri[2]) newCache[newCount++] = v;
+        }
+        for (size_t c = FORSYTH_CACHE_SIZE; c < newCount; ++c) {
+            cachePosition[newCache[c]] = -1;
+        }
+        cacheCount = newCount < FORSYTH_CACHE_SIZE ? newCount : FORSYTH_CACHE_SIZE;
+        memcpy(cache, newCache, newCount * sizeof(unsigned int));
+
+        for (size_t c = 0; c < newCount; ++c) {
+            unsigned int v = newCache[c];
+            if (c < FORSYTH_CACHE_SIZE) cachePosition[v] = (int)c;
+            float score = ForsythVertexScore(&scores, cachePosition[v], valence[v]);
+            float delta = score - vertexScore[v];
+            vertexScore[v] = score;
+            for (unsigned int a = 0; a < valence[v]; ++a) {
+                triScore[adjacency[offsets[v] + a]] += delta;
+            }
+        }
+
+        best = FORSYTH_NO_TRIANGLE;
+        bestScore = -1.0f;
+        for (size_t c = 0; c < cacheCount; ++c) {
+            unsigned int v = cache[c];
+            for (unsigned int a = 0; a < valence[v]; ++a) {
+                unsigned int t = adjacency[offsets[v] + a];
+                if (triScore[t] > bestScore) {
+                    bestScore = triScore[t];
+                    best = t;
+                }
+            }
+        }
+    }
+}
+
+typedef struct Cluster {
+    unsigned int Start; // First triangle
+    unsigned int Count;
+    float Sort;
+} Cluster;
+
+static int CompareClusterSort(const void* a, const void* b) {
+    const Cluster* clusterA = a;
+    const Cluster* clusterB = b;
+    return clusterA->Sort < clusterB->Sort ? 1 : clusterA->Sort > clusterB->Sort ? -1 : 0;
+}
+
+// Splits the cache optimized triangles in to clusters wherever a triangle misses the cache on every vertex,
+// so reordering clusters barely changes ACMR, then draws the clusters facing furthest out from the centre first.
+// Outward facing clusters tend to occlude the rest of the mesh, reducing overdraw.
+static void OptimizeOverdraw(unsigned int* indices, size_t indexCount, const float* vertices, size_t vertexCount, size_t vertexSize, Arena* arena) {
+    size_t triCount = indexCount / 3;
+    unsigned int* timestamps = ArenaAlloc(arena, vertexCount * sizeof(unsigned int));
+    Cluster* clusters = ArenaAlloc(arena, triCount * sizeof(Cluster));
+    unsigned int* sorted = ArenaAlloc(arena, indexCount * sizeof(unsigned int));
+    if (!timestamps || !clusters || !sorted || triCount == 0) return;
+
+    float centre[3] = { 0.0f, 0.0f, 0.0f };
+    for (size_t v = 0; v < vertexCount; ++v) {
+        for (size_t k = 0; k < 3; ++k) centre[k] += vertices[v * vertexSize + k];
+    }
+    for (size_t k = 0; k < 3; ++k) centre[k] /= (float)(vertexCount ? vertexCount : 1);
+
+    size_t clusterCount = 0;
+    unsigned int time = CACHE_SIM_SIZE + 1;
+    memset(timestamps, 0, vertexCount * sizeof(unsigned int));
+    for (size_t t = 0; t < triCount; ++t) {
+        size_t misses = 0;
+        for (size_t k = 0; k < 3; ++k) {
+            unsigned int v = indices[t * 3 + k];
+            if (time - timestamps[v] > CACHE_SIM_SIZE) {
+                timestamps[v] = time++;
+                misses++;
+            }
+        }
+        if (t == 0 || misses == 3) {
+            clusters[clusterCount].Start = (unsigned int)t;
+            clusters[clusterCount].Count = 0;
+            clusterCount++;
+        }
+        clusters[clusterCount - 1].Count++;
+    }
+
+    for (size_t c = 0; c < clusterCount; ++c) {
+        float centroid[3] = { 0.0f, 0.0f, 0.0f };
+        float normal[3] = { 0.0f, 0.0f, 0.0f };
+        float area = 0.0f;
+        for (size_t t = clusters[c].Start; t < clusters[c].Start + clusters[c].Count; ++t) {
+            const float* p0 = &vertices[indices[t * 3] * vertexSize];
+            const float* p1 = &vertices[indices[t * 3 + 1] * vertexSize];
+            const float* p2 = &vertices[indices[t * 3 + 2] * vertexSize];
+            float e0[3] = { p1[0] - p0[0], p1[1] - p0[1], p1[2] - p0[2] };
+            float e1[3] = { p2[0] - p0[0], p2[1] - p0[1], p2[2] - p0[2] };
+            float n[3] = { e0[1] * e1[2] - e0[2] * e1[1], e0[2] * e1[0] - e0[0] * e1[2], e0[0] * e1[1] - e0[1] * e1[0] };
+            float triArea = sqrtf(n[0] * n[0] + n[1] * n[1] + n[2] * n[2]);
+            for (size_t k = 0; k < 3; ++k) {
+                centroid[k] += (p0[k] + p1[k] + p2[k]) * triArea;
+                normal[k] += n[k];
+            }
+            area += triArea;
+        }
+        float normalLength = sqrtf(normal[0] * normal[0] + normal[1] * normal[1] + normal[2] * normal[2]);
+        clusters[c].Sort = 0.0f;
+        if (area > 0.0f && normalLength > 0.0f) {
+            for (size_t k = 0; k < 3; ++k) {
+                clusters[c].Sort += (centroid[k] / (area * 3.0f) - centre[k]) * normal[k] / normalLength;
+            }
+        }
+    }
+
+    qsort(clusters, clusterCount, sizeof(Cluster), CompareClusterSort);
+    size_t out = 0;
+    for (size_t c = 0; c < clusterCount; ++c) {
+        memcpy(&sorted[out], &indices[clusters[c].Start * 3], clusters[c].Count * 3 * sizeof(unsigned int));
+        out += clusters[c].Count * 3;
+    }
+    memcpy(indices, sorted, indexCount * sizeof(unsigned int));
+}
+
+// Renumbers vertices in the order the index buffer first uses them so vertex fetch walks memory sequentially
+static void OptimizeVertexFetch(unsigned int* indices, size_t indexCount, float* vertices, size_t vertexCount, size_t vertexSize, Arena* arena) {
+    unsigned int* remap = ArenaAlloc(arena, vertexCount * sizeof(unsigned int));
+    float* reordered = ArenaAlloc(arena, vertexCount * vertexSize * sizeof(float));
+    if (!remap || !reordered) return;
+
+    memset(remap, 0xFF, vertexCount * sizeof(unsigned int));
+    unsigned int next = 0;
+    for (size_t i = 0; i < indexCount; ++i) {
+        unsigned int v = indices[i];
+        if (remap[v] == WELD_EMPTY) {
+            remap[v] = next;
+            memcpy(&reordered[next * vertexSize], &vertices[v * vertexSize], vertexSize * sizeof(float));
+            next++;
+        }
+        indices[i] = remap[v];
+    }
+    // Vertices no triangle uses keep their data at the end
+    for (size_t v = 0; v < vertexCount; ++v) {
+        if (remap[v] == WELD_EMPTY) memcpy(&reordered[next++ * vertexSize], &vertices[v * vertexSize], vertexSize * sizeof(float));
+    }
+    memcpy(vertices, reordered, vertexCount * vertexSize * sizeof(float));
+}
+
+// Reorders a welded mesh for the post transform cache, overdraw, then vertex fetch if fetch is set, reporting the
+// cache efficiency when verbose
+static bool OptimizeMesh(Buffers* buffers, unsigned int m, unsigned int id, bool fetch) {
+    Mesh* mesh = &buffers->Meshes[m];
+    size_t vertexSize = buffers->VertexFloats;
+    unsigned int* indices = &buffers->Indices[mesh->IndexOffset];
+    float* vertices = &buffers->Vertices[(size_t)mesh->VertexOffset * vertexSize];
+    ArenaMark mark = ArenaGetMark(buffers->Arena);
+    unsigned int* local = ArenaAlloc(buffers->Arena, mesh->IndexCount * sizeof(unsigned int));
+    unsigned int* timestamps = ArenaAlloc(buffers->Arena, mesh->VertexCount * sizeof(unsigned int));
+    if (!local || !timestamps) {
+        ArenaRelease(buffers->Arena, mark);
+        return false;
+    }
+
+    for (size_t i = 0; i < mesh->IndexCount; ++i) {
+        local[i] = indices[i] - mesh->VertexOffset;
+    }
+    // The cache is only measured to be reported
+    bool verbose = (buffers->Options->Flags & OBJTOBIN_FLAG_VERBOSE) != 0;
+    float acmrBefore, atvrBefore, acmrAfter, atvrAfter;
+    if (verbose) MeasureVertexCache(local, mesh->IndexCount, mesh->VertexCount, timestamps, &acmrBefore, &atvrBefore);
+
+    OptimizeVertexCache(indices, local, mesh->IndexCount, mesh->VertexCount, buffers->Arena);
+    OptimizeOverdraw(indices, mesh->IndexCount, vertices, mesh->VertexCount, vertexSize, buffers->Arena);
+    if (fetch) OptimizeVertexFetch(indices, mesh->IndexCount, vertices, mesh->VertexCount, vertexSize, buffers->Arena);
+
+    if (verbose) {
+        MeasureVertexCache(indices, mesh->IndexCount, mesh->VertexCount, timestamps, &acmrAfter, &atvrAfter);
+        Report("%s mesh %u: ACMR %.3f -> %.3f, ATVR %.3f -> %.3f\n", buffers->Name, id, acmrBefore, acmrAfter, atvrBefore, atvrAfter);
+    }
+    for (size_t i = 0; i < mesh->IndexCount; ++i) {
+        indices[i] += mesh->VertexOffset;
+    }
+    ArenaRelease(buffers->Arena, mark);
+    return true;
+}
+
+// Garland and Heckbert error quadric, the sum of squared distances to a set of area weighted planes
+typedef struct Quadric {
+    double A[6]; // Symmetric 3x3 of the plane normals, xx xy xz yy yz zz
+    double B[3];
+    double C;
+    double Weight; // Area of the planes, so the error divided by it is a squared distance
+} Quadric;
+
+typedef struct Collapse {
+    unsigned int Vertex;
+    unsigned int Target;
+    float Cost;
+} Collapse;
+
+// Working state of simplifying one mesh, vertices are local to the mesh
+typedef struct Simplifier {
+    const float* Vertices;
+    unsigned int VertexFloats;
+    size_t VertexCount;
+    unsigned int* Indices; // Triangles left at the current level
+    size_t IndexCount;
+    unsigned int* Positions; // Lowest vertex at the same position, vertices split by uv or normal seams share one
+    unsigned char* Locked; // Seam, border and non-manifold vertices, which never move
+    unsigned char* Touched; // Vertices around a collapse of the current pass
+    Quadric* Quadrics; // Indexed by position
+    Collapse* Collapses;
+    unsigned int* Remap;
+    unsigned int* Offsets; // Triangles around each vertex
+    unsigned int* Adjacency;
+    unsigned int* Marks; // Positions around a collapse, stamped with Mark
+    unsigned int Mark;
+    double Error; // Largest squared error of any collapse so far
+    double MaxError; // Largest squared error a collapse may have
+} Simplifier;
+
+static void QuadricAddPlane(Quadric* q, const float* p0, const float* p1, const float* p2) {
+    double e0[3], e1[3], n[3];
+    for (int k = 0; k < 3; ++k) {
+        e0[k] = (double)p1[k] - p0[k];
+        e1[k] = (double)p2[k] - p0[k];
+    }
+    n[0] = e0[1] * e1[2] - e0[2] * e1[1];
+    n[1] = e0[2] * e1[0] - e0[0] * e1[2];
+    n[2] = e0[0] * e1[1] - e0[1] * e1[0];
+    double length = sqrt(n[0] * n[0] + n[1] * n[1] + n[2] * n[2]);
+    if (length <= 0.0) return;
+    double area = length * 0.5;
+    for (int k = 0; k < 3; ++k) n[k] /= length;
+    double d = -(n[0] * p0[0] + n[1] * p0[1] + n[2] * p0[2]);
+    q->A[0] += area * n[0] * n[0];
+    q->A[1] += area * n[0] * n[1];
+    q->A[2] += area * n[0] * n[2];
+    q->A[3] += area * n[1] * n[1];
+    q->A[4] += area * n[1] * n[2];
+    q->A[5] += area * n[2] * n[2];
+    for (int k = 0; k < 3; ++k) q->B[k] += area * d * n[k];
+    q->C += area * d * d;
+    q->Weight += area;
+}
+
+// Squared distance of p from the planes of both quadrics, averaged by area
+static double QuadricError(const Quadric* q0, const Quadric* q1, const float* p) {
+    double a[6], b[3];
+    for (int k = 0; k < 6; ++k) a[k] = q0->A[k] + q1->A[k];
+    for (int k = 0; k < 3; ++k) b[k] = q0->B[k] + q1->B[k];
+    double x = p[0], y = p[1], z = p[2];
+    double error = a[0] * x * x + 2.0 * a[1] * x * y + 2.0 * a[2] * x * z + a[3] * y * y + 2.0 * a[4] * y * z + a[5] * z * z +
+                   2.0 * (b[0] * x + b[1] * y + b[2] * z) + q0->C + q1->C;
+    double weight = q0->Weight + q1->Weight;
+    return weight > 0.0 && error > 0.0 ? error / weight : 0.0;
+}
+
+static int CompareCollapseCost(const void* a, const void* b) {
+    const Collapse* collapseA = a;
+    const Collapse* collapseB = b;
+    return collapseA->Cost < collapseB->Cost ? -1 : collapseA->Cost > collapseB->Cost ? 1 : 0;
+}
+
+// Finds the vertex at each position, then locks vertices that are on a seam, or on an edge that does not
+// have exactly two triangles once seams are joined, so borders and seams keep their shape at every level.
+static void ClassifyVertices(Simplifier* simplifier, unsigned int* table, size_t tableMask, uint64_t* edges, unsigned int* edgeCounts, size_t edgeMask) {
+    const float* vertices = simplifier->Vertices;
+    memset(table, 0xFF, (tableMask + 1) * sizeof(unsigned int));
+    memset(simplifier->Locked, 0, simplifier->VertexCount);
+    for (size_t v = 0; v < simplifier->VertexCount; ++v) {
+        const float* p = &vertices[v * simplifier->VertexFloats];
+        uint32_t bits[3];
+        memcpy(bits, p, sizeof(bits));
+        size_t slot = HashMix(((uint64_t)bits[0] << 32 | bits[1]) ^ HashMix(bits[2])) & tableMask;
+        while (table[slot] != WELD_EMPTY && memcmp(&vertices[table[slot] * simplifier->VertexFloats], p, 3 * sizeof(float)) != 0) {
+            slot = (slot + 1) & tableMask;
+        }
+        if (table[slot] == WELD_EMPTY) {
+            table[slot] = (unsigned int)v;
+            simplifier->Positions[v] = (unsigned int)v;
+        }
+        else {
+            simplifier->Positions[v] = table[slot];
+            simplifier->Locked[v] = 1;
+            simplifier->Locked[table[slot]] = 1;
+        }
+    }
+
+    memset(edges, 0xFF, (edgeMask + 1) * sizeof(uint64_t));
+    for (size_t i = 0; i < simplifier->IndexCount; ++i) {
+        unsigned int a = simplifier->Positions[simplifier->Indices[i]];
+        unsigned int b = simplifier->Positions[simplifier->Indices[i % 3 == 2 ? i - 2 : i + 1]];
+        uint64_t key = a < b ? (uint64_t)a << 32 | b : (uint64_t)b << 32 | a;
+        size_t slot = HashMix(key) & edgeMask;
+        while (edges[slot] != UINT64_MAX && edges[slot] != key) slot = (slot + 1) & edgeMask;
+        if (edges[slot] == UINT64_MAX) {
+            edges[slot] = key;
+            edgeCounts[slot] = 0;
+        }
+        edgeCounts[slot]++;
+    }
+    for (size_t slot = 0; slot <= edgeMask; ++slot) {
+        if (edges[slot] == UINT64_MAX || edgeCounts[slot] == 2) continue;
+        simplifier->Locked[edges[slot] >> 32] = 1;
+        simplifier->Locked[edges[slot] & 0xFFFFFFFF] = 1;
+    }
+    // Seam vertices were locked through their position, so only those remaining at a position can be collapsed
+    for (size_t v = 0; v < simplifier->VertexCount; ++v) {
+        if (simplifier->Locked[simplifier->Positions[v]]) simplifier->Locked[v] = 1;
+    }
+}
+
+// Returns the number of triangles collapsing vertex on to target removes, or -1 if it would flip a triangle or break
+// the link condition. Past the triangles they share, the two ends of the edge may only have the vertices opposite the
+// edge as common neighbours, otherwise the collapse pinches the surface in to non-manifold edges or folds it through itself.
+static int CheckCollapse(Simplifier* simplifier, unsigned int vertex, unsigned int target) {
+    const float* vertices = simplifier->Vertices;
+    unsigned int floats = simplifier->VertexFloats;
+    const unsigned int* positions = simplifier->Positions;
+    if (simplifier->Mark > UINT32_MAX - 2) {
+        memset(simplifier->Marks, 0, simplifier->VertexCount * sizeof(unsigned int));
+        simplifier->Mark = 0;
+    }
+    simplifier->Mark += 2;
+    unsigned int neighbour = simplifier->Mark - 1;
+    unsigned int opposite = simplifier->Mark;
+    for (unsigned int a = simplifier->Offsets[vertex]; a < simplifier->Offsets[vertex + 1]; ++a) {
+        const unsigned int* tri = &simplifier->Indices[simplifier->Adjacency[a] * 3];
+        bool shared = tri[0] == target || tri[1] == target || tri[2] == target;
+        for (int k = 0; k < 3; ++k) {
+            unsigned int* mark = &simplifier->Marks[positions[tri[k]]];
+            if (shared) *mark = opposite;
+            else if (*mark != opposite) *mark = neighbour;
+        }
+    }
+    for (unsigned int a = simplifier->Offsets[target]; a < simplifier->Offsets[target + 1]; ++a) {
+        const unsigned int* tri = &simplifier->Indices[simplifier->Adjacency[a] * 3];
+        for (int k = 0; k < 3; ++k) {
+            if (simplifier->Marks[positions[tri[k]]] == neighbour) return -1;
+        }
+    }
+
+    int removed = 0;
+    for (unsigned int a = simplifier->Offsets[vertex]; a < simplifier->Offsets[vertex + 1]; ++a) {
+        const unsigned int* tri = &simplifier->Indices[simplifier->Adjacency[a] * 3];
+        if (tri[0] == target || tri[1] == target || tri[2] == target) {
+            removed++;
+            continue;
+        }
+        double before[3], after[3];
+        for (int pass = 0; pass < 2; ++pass) {
+            const float* p[3];
+            for (int k = 0; k < 3; ++k) p[k] = &vertices[(size_t)(tri[k] == vertex && pass ? target : tri[k]) * floats];
+            double e0[3], e1[3];
+            for (int k = 0; k < 3; ++k) {
+                e0[k] = (double)p[1][k] - p[0][k];
+                e1[k] = (double)p[2][k] - p[0][k];
+            }
+            double* n = pass ? after : before;
+            n[0] = e0[1] * e1[2] - e0[2] * e1[1];
+            n[1] = e0[2] * e1[0] - e0[0] * e1[2];
+            n[2] = e0[0] * e1[1] - e0[1] * e1[0];
+        }
+        double dot = before[0] * after[0] + before[1] * after[1] + before[2] * after[2];
+        double lengths = sqrt((before[0] * before[0] + before[1] * before[1] + before[2] * before[2]) *
+                              (after[0] * after[0] + after[1] * after[1] + after[2] * after[2]));
+        if (dot < LOD_FLIP_COSINE * lengths) return -1;
+    }
+    return removed;
+}
+
+// Collapses the cheapest edges of the current level that do not share a triangle, until about targetTriangles
+// remain. Each unlocked vertex moves on to the neighbour with the least error. Returns the collapses made.
+static size_t CollapseEdges(Simplifier* simplifier, size_t targetTriangles) {
+    size_t triCount = simplifier->IndexCount / 3;
+    const unsigned int* indices = simplifier->Indices;
+    memset(simplifier->Offsets, 0, (simplifier->VertexCount + 1) * sizeof(unsigned int));
+    for (size_t i = 0; i < simplifier->IndexCount; ++i) simplifier->Offsets[indices[i] + 1]++;
+    for (size_t v = 0; v < simplifier->VertexCount; ++v) simplifier->Offsets[v + 1] += simplifier->Offsets[v];
+    for (size_t i = 0; i < simplifier->IndexCount; ++i) simplifier->Adjacency[simplifier->Offsets[indices[i]]++] = (unsigned int)(i / 3);
+    for (size_t v = simplifier->VertexCount; v > 0; --v) simplifier->Offsets[v] = simplifier->Offsets[v - 1];
+    simplifier->Offsets[0] = 0;
+
+    // Cheapest target of each vertex, Remap doubles as the target until the collapses are chosen
+    Collapse* best = simplifier->Collapses;
+    for (size_t v = 0; v < simplifier->VertexCount; ++v) best[v].Cost = INFINITY;
+    for (size_t i = 0; i < simplifier->IndexCount; ++i) {
+        unsigned int edge[2] = { indices[i], indices[i % 3 == 2 ? i - 2 : i + 1] };
+        for (int k = 0; k < 2; ++k) {
+            unsigned int vertex = edge[k];
+            unsigned int target = edge[1 - k];
+            if (simplifier->Locked[vertex]) continue;
+            float cost = (float)QuadricError(&simplifier->Quadrics[vertex], &simplifier->Quadrics[simplifier->Positions[target]],
+                                             &simplifier->Vertices[(size_t)target * simplifier->VertexFloats]);
+            if (cost < best[vertex].Cost) {
+                best[vertex].Cost = cost;
+                best[vertex].Target = target;
+            }
+        }
+    }
+    size_t candidateCount = 0;
+    for (size_t v = 0; v < simplifier->VertexCount; ++v) {
+        if (best[v].Cost == INFINITY) continue;
+        Collapse candidate = { (unsigned int)v, best[v].Target, best[v].Cost };
+        best[candidateCount++] = candidate;
+    }
+    qsort(best, candidateCount, sizeof(Collapse), CompareCollapseCost);
+
+    for (size_t v = 0; v < simplifier->VertexCount; ++v) simplifier->Remap[v] = (unsigned int)v;
+    memset(simplifier->Touched, 0, simplifier->VertexCount);
+    size_t collapsed = 0;
+    size_t removed = 0;
+    for (size_t c = 0; c < candidateCount && triCount - removed > targetTriangles && best[c].Cost <= simplifier->MaxError; ++c) {
+        unsigned int vertex = best[c].Vertex;
+        unsigned int target = best[c].Target;
+        if (simplifier->Touched[vertex] || simplifier->Touched[target]) continue;
+        int triangles = CheckCollapse(simplifier, vertex, target);
+        if (triangles < 0) continue;
+        // Every vertex sharing a triangle with the collapse stays put for the rest of the pass, so the flip checks hold
+        for (unsigned int a = simplifier->Offsets[vertex]; a < simplifier->Offsets[vertex + 1]; ++a) {
+            const unsigned int* tri = &indices[simplifier->Adjacency[a] * 3];
+            for (int k = 0; k < 3; ++k) simplifier->Touched[tri[k]] = 1;
+        }
+        simplifier->Remap[vertex] = target;
+        Quadric* into = &simplifier->Quadrics[simplifier->Positions[target]];
+        const Quadric* from = &simplifier->Quadrics[vertex];
+        for (int k = 0; k < 6; ++k) into->A[k] += from->A[k];
+        for (int k = 0; k < 3; ++k) into->B[k] += from->B[k];
+        into->C += from->C;
+        into->Weight += from->Weight;
+        if (best[c].Cost > simplifier->Error) simplifier->Error = best[c].Cost;
+        removed += triangles;
+        collapsed++;
+    }
+
+    size_t count = 0;
+    for (size_t i = 0; i < simplifier->IndexCount; i += 3) {
+        unsigned int a = simplifier->Remap[indices[i]];
+        unsigned int b = simplifier->Remap[indices[i + 1]];
+        unsigned int c = simplifier->Remap[indices[i + 2]];
+        if (a == b || b == c || c == a) continue;
+        simplifier->Indices[count++] = a;
+        simplifier->Indices[count++] = b;
+        simplifier->Indices[count++] = c;
+    }
+    simplifier->IndexCount = count;
+    return collapsed;
+}
+
+// Builds up to LodLevels levels of detail of a welded mesh by quadric edge collapse, each about LOD_TARGET_RATIO of
+// the last. Levels only drop triangles, so they index the mesh's own vertices and are appended to the LOD buffers.
+// id is only used to report on the mesh.
+static bool SimplifyMesh(Buffers* buffers, unsigned int m, unsigned int id) {
+    Mesh* mesh = &buffers->Meshes[m];
+    mesh->LodFirst = (uint32_t)buffers->LodCount;
+    mesh->LodCount = 0;
+    if (mesh->IndexCount / 3 < LOD_MIN_TRIANGLES) return true;
+
+    ArenaMark mark = ArenaGetMark(buffers->Arena);
+    Simplifier simplifier;
+    memset(&simplifier, 0, sizeof(Simplifier));
+    size_t vertexCount = mesh->VertexCount;
+    size_t tableMask = NextPowerOf2(vertexCount * 2) - 1;
+    size_t edgeMask = NextPowerOf2(mesh->IndexCount * 2) - 1;
+    simplifier.Vertices = &buffers->Vertices[(size_t)mesh->VertexOffset * buffers->VertexFloats];
+    simplifier.VertexFloats = buffers->VertexFloats;
+    simplifier.VertexCount = vertexCount;
+    simplifier.Indices = ArenaAlloc(buffers->Arena, mesh->IndexCount * sizeof(unsigned int));
+    simplifier.IndexCount = mesh->IndexCount;
+    simplifier.Positions = ArenaAlloc(buffers->Arena, vertexCount * sizeof(unsigned int));
+    simplifier.Locked = ArenaAlloc(buffers->Arena, vertexCount);
+    simplifier.Touched = ArenaAlloc(buffers->Arena, vertexCount);
+    simplifier.Quadrics = ArenaAlloc(buffers->Arena, vertexCount * sizeof(Quadric));
+    simplifier.Collapses = ArenaAlloc(buffers->Arena, vertexCount * sizeof(Collapse));
+    simplifier.Remap = ArenaAlloc(buffers->Arena, vertexCount * sizeof(unsigned int));
+    simplifier.Offsets = ArenaAlloc(buffers->Arena, (vertexCount + 1) * sizeof(unsigned int));
+    simplifier.Adjacency = ArenaAlloc(buffers->Arena, mesh->IndexCount * sizeof(unsigned int));
+    simplifier.Marks = ArenaAlloc(buffers->Arena, vertexCount * sizeof(unsigned int));
+    unsigned int* table = ArenaAlloc(buffers->Arena, (tableMask + 1) * sizeof(unsigned int));
+    uint64_t* edges = ArenaAlloc(buffers->Arena, (edgeMask + 1) * sizeof(uint64_t));
+    unsigned int* edgeCounts = ArenaAlloc(buffers->Arena, (edgeMask + 1) * sizeof(unsigned int));
+    if (!simplifier.Indices || !simplifier.Positions || !simplifier.Locked || !simplifier.Touched || !simplifier.Quadrics ||
+        !simplifier.Collapses || !simplifier.Remap || !simplifier.Offsets || !simplifier.Adjacency || !simplifier.Marks || !table || !edges ||
+        !edgeCounts) {
+        ArenaRelease(buffers->Arena, mark);
+        return false;
+    }
+    for (size_t i = 0; i < mesh->IndexCount; ++i) {
+        simplifier.Indices[i] = buffers->Indices[mesh->IndexOffset + i] - (unsigned int)mesh->VertexOffset;
+    }
+    ClassifyVertices(&simplifier, table, tableMask, edges, edgeCounts, edgeMask);
+    memset(simplifier.Marks, 0, vertexCount * sizeof(unsigned int));
+    memset(simplifier.Quadrics, 0, vertexCount * sizeof(Quadric));
+    // Levels stop getting coarser once a collapse would move the surface too far for the size of the mesh
+    float min[3] = { INFINITY, INFINITY, INFINITY };
+    float max[3] = { -INFINITY, -INFINITY, -INFINITY };
+    for (size_t v = 0; v < vertexCount; ++v) {
+        const float* p = &simplifier.Vertices[v * simplifier.VertexFloats];
+        for (int k = 0; k < 3; ++k) {
+            if (p[k] < min[k]) min[k] = p[k];
+            if (p[k] > max[k]) max[k] = p[k];
+        }
+    }
+    double radiusSquared = 0.0;
+    for (size_t v = 0; v < vertexCount; ++v) {
+        const float* p = &simplifier.Vertices[v * simplifier.VertexFloats];
+        double distance = 0.0;
+        for (int k = 0; k < 3; ++k) distance += (p[k] - (min[k] + max[k]) * 0.5) * (p[k] - (min[k] + max[k]) * 0.5);
+        if (distance > radiusSquared) radiusSquared = distance;
+    }
+    simplifier.MaxError = radiusSquared * LOD_MAX_ERROR * LOD_MAX_ERROR;
+    for (size_t i = 0; i < simplifier.IndexCount; i += 3) {
+        const float* p[3];
+        for (int k = 0; k < 3; ++k) p[k] = &simplifier.Vertices[(size_t)simplifier.Indices[i + k] * simplifier.VertexFloats];
+        for (int k = 0; k < 3; ++k) QuadricAddPlane(&simplifier.Quadrics[simplifier.Positions[simplifier.Indices[i + k]]], p[0], p[1], p[2]);
+    }
+
+    // Each mesh may use as many level of detail indices as it has indices
+    size_t budget = mesh->IndexCount;
+    for (unsigned int level = 0; level < buffers->Options->LodLevels; ++level) {
+        size_t previous = simplifier.IndexCount / 3;
+        size_t target = (size_t)(previous * LOD_TARGET_RATIO);
+        if (previous < LOD_MIN_TRIANGLES) break;
+        while (simplifier.IndexCount / 3 > target && CollapseEdges(&simplifier, target) > 0) {}
+        size_t count = simplifier.IndexCount;
+        if (count == 0 || count / 3 > previous * LOD_MIN_REDUCTION || count > budget) break;
+
+        unsigned int* dst = &buffers->LodIndices[buffers->LodIndexCount];
+        if (buffers->Options->Flags & OBJTOBIN_FLAG_OPTIMIZE) {
+            ArenaMark levelMark = ArenaGetMark(buffers->Arena);
+            OptimizeVertexCache(dst, simplifier.Indices, count, vertexCount, buffers->Arena);
+            ArenaRelease(buffers->Arena, levelMark);
+        }
+        else memcpy(dst, simplifier.Indices, count * sizeof(unsigned int));
+        for (size_t i = 0; i < count; ++i) dst[i] += (unsigned int)mesh->VertexOffset;
+        ObjToBinLod* lod = &buffers->Lods[buffers->LodCount++];
+        lod->IndexOffset = buffers->LodIndexCount;
+        lod->IndexCount = (uint32_t)count;
+        lod->Error = (float)sqrt(simplifier.Error);
+        buffers->LodIndexCount += count;
+        budget -= count;
+        mesh->LodCount++;
+    }
+    if (buffers->Options->Flags & OBJTOBIN_FLAG_VERBOSE) {
+        char levels[LOD_MAX_LEVELS * 48] = "";
+        size_t length = 0;
+        for (unsigned int l = 0; l < mesh->LodCount; ++l) {
+            const ObjToBinLod* lod = &buffers->Lods[mesh->LodFirst + l];
+            length += snprintf(&levels[length], sizeof(levels) - length, ", %u triangles (error %g)", lod->IndexCount / 3, lod->Error);
+        }
+        Report("%s mesh %u: %u levels of detail%s\n", buffers->Name, id, mesh->LodCount, levels);
+    }
+    ArenaRelease(buffers->Arena, mark);
+    return true;
+}
+
+// Meshlet being filled by BuildMeshlets
+typedef struct MeshletBuilder {
+    unsigned int Vertices[MESHLET_MAX_VERTICES];
+    unsigned char Triangles[MESHLET_MAX_TRIANGLES * 3];
+    unsigned int VertexCount;
+    unsigned int TriangleCount;
+    unsigned char* Local; // Index of each mesh vertex in the meshlet, 0xFF if it is not in it
+} MeshletBuilder;
+
+// Computes the bounding sphere and normal cone of the filled meshlet and appends it to the buffers' meshlets
+static void FlushMeshlet(Buffers* buffers, const Mesh* mesh, MeshletBuilder* builder) {
+    if (builder->TriangleCount == 0) return;
+    const float* vertices = &buffers->Vertices[(size_t)mesh->VertexOffset * buffers->VertexFloats];
+    ObjToBinMeshlet* meshlet = &buffers->Meshlets[buffers->MeshletCount++];
+    memset(meshlet, 0, sizeof(ObjToBinMeshlet));
+    meshlet->DataOffset = buffers->MeshletDataBytes;
+    meshlet->VertexCount = builder->VertexCount;
+    meshlet->TriangleCount = builder->TriangleCount;
+
+    float min[3] = { INFINITY, INFINITY, INFINITY };
+    float max[3] = { -INFINITY, -INFINITY, -INFINITY };
+    for (unsigned int i = 0; i < builder->VertexCount; ++i) {
+        const float* p = &vertices[(size_t)builder->Vertices[i] * buffers->VertexFloats];
+        for (int k = 0; k < 3; ++k) {
+            if (p[k] < min[k]) min[k] = p[k];
+            if (p[k] > max[k]) max[k] = p[k];
+        }
+    }
+    double radius = 0.0;
+    for (int k = 0; k < 3; ++k) meshlet->Center[k] = (min[k] + max[k]) * 0.5f;
+    for (unsigned int i = 0; i < builder->VertexCount; ++i) {
+        const float* p = &vertices[(size_t)builder->Vertices[i] * buffers->VertexFloats];
+        double dx = p[0] - meshlet->Center[0], dy = p[1] - meshlet->Center[1], dz = p[2] - meshlet->Center[2];
+        double distance = sqrt(dx * dx + dy * dy + dz * dz);
+        if (distance > radius) radius = distance;
+    }
+    meshlet->Radius = (float)radius;
+
+    // The cone axis is the average triangle normal, the apex is pulled back along it until every triangle's plane is in front
+    double normals[MESHLET_MAX_TRIANGLES][3];
+    double axis[3] = { 0.0, 0.0, 0.0 };
+    for (unsigned int t = 0; t < builder->TriangleCount; ++t) {
+        const float* p[3];
+        for (int k = 0; k < 3; ++k) p[k] = &vertices[(size_t)builder->Vertices[builder->Triangles[t * 3 + k]] * buffers->VertexFloats];
+        double e0[3], e1[3];
+        for (int k = 0; k < 3; ++k) {
+            e0[k] = (double)p[1][k] - p[0][k];
+            e1[k] = (double)p[2][k] - p[0][k];
+        }
+        double* n = normals[t];
+        n[0] = e0[1] * e1[2] - e0[2] * e1[1];
+        n[1] = e0[2] * e1[0] - e0[0] * e1[2];
+        n[2] = e0[0] * e1[1] - e0[1] * e1[0];
+        double length = sqrt(n[0] * n[0] + n[1] * n[1] + n[2] * n[2]);
+        for (int k = 0; k < 3; ++k) {
+            n[k] = length > 0.0 ? n[k] / length : 0.0;
+            axis[k] += n[k];
+        }
+    }
+    double axisLength = sqrt(axis[0] * axis[0] + axis[1] * axis[1] + axis[2] * axis[2]);
+    double minDot = axisLength > 0.0 ? 1.0 : -1.0;
+    for (int k = 0; k < 3; ++k) axis[k] = axisLength > 0.0 ? axis[k] / axisLength : 0.0;
+    for (unsigned int t = 0; t < builder->TriangleCount; ++t) {
+        const double* n = normals[t];
+        double dot = n[0] * axis[0] + n[1] * axis[1] + n[2] * axis[2];
+        if ((n[0] != 0.0 || n[1] != 0.0 || n[2] != 0.0) && dot < minDot) minDot = dot;
+    }
+    for (int k = 0; k < 3; ++k) meshlet->ConeAxis[k] = (float)axis[k];
+    if (minDot <= MESHLET_CONE_MIN_DOT) {
+        meshlet->ConeCutoff = 1.0f;
+        memcpy(meshlet->ConeApex, meshlet->Center, sizeof(meshlet->ConeApex));
+    }
+    else {
+        double apex = 0.0;
+        for (unsigned int t = 0; t < builder->TriangleCount; ++t) {
+            const double* n = normals[t];
+            const float* p = &vertices[(size_t)builder->Vertices[builder->Triangles[t * 3]] * buffers->VertexFloats];
+            double dn = n[0] * axis[0] + n[1] * axis[1] + n[2] * axis[2];
+            if (dn <= 0.0) continue;
+            double dc = (meshlet->Center[0] - p[0]) * n[0] + (meshlet->Center[1] - p[1]) * n[1] + (meshlet->Center[2] - p[2]) * n[2];
+            if (dc / dn > apex) apex = dc / dn;
+        }
+        for (int k = 0; k < 3; ++k) meshlet->ConeApex[k] = (float)(meshlet->Center[k] - axis[k] * apex);
+        meshlet->ConeCutoff = (float)sqrt(1.0 - minDot * minDot);
+    }
+
+    unsigned char* data = &buffers->MeshletData[buffers->MeshletDataBytes];
+    size_t triangleBytes = ((size_t)builder->TriangleCount * 3 + 3) & ~(size_t)3;
+    memcpy(data, builder->Vertices, builder->VertexCount * sizeof(unsigned int));
+    memset(data + builder->VertexCount * sizeof(unsigned int), 0, triangleBytes);
+    memcpy(data + builder->VertexCount * sizeof(unsigned int), builder->Triangles, (size_t)builder->TriangleCount * 3);
+    buffers->MeshletDataBytes += builder->VertexCount * sizeof(unsigned int) + triangleBytes;
+    for (unsigned int i = 0; i < builder->VertexCount; ++i) builder->Local[builder->Vertices[i]] = 0xFF;
+    builder->VertexCount = 0;
+    builder->TriangleCount = 0;
+}
+
+// Splits a welded mesh in to meshlets of up to MESHLET_MAX_VERTICES vertices and MESHLET_MAX_TRIANGLES triangles.
+// Meshlets grow greedily through the triangles sharing their vertices, taking the one adding the fewest new vertices,
+// and carry on from the next triangle in index order when none are left, so optimized meshes give compact meshlets.
+static bool BuildMeshlets(Buffers* buffers, unsigned int m) {
+    Mesh* mesh = &buffers->Meshes[m];
+    mesh->MeshletFirst = (uint32_t)buffers->MeshletCount;
+    size_t vertexCount = mesh->VertexCount;
+    size_t triCount = mesh->IndexCount / 3;
+    ArenaMark mark = ArenaGetMark(buffers->Arena);
+    unsigned int* indices = ArenaAlloc(buffers->Arena, mesh->IndexCount * sizeof(unsigned int));
+    unsigned int* live = ArenaAlloc(buffers->Arena, vertexCount * sizeof(unsigned int));
+    unsigned int* offsets = ArenaAlloc(buffers->Arena, (vertexCount + 1) * sizeof(unsigned int));
+    unsigned int* adjacency = ArenaAlloc(buffers->Arena, mesh->IndexCount * sizeof(unsigned int));
+    unsigned char* emitted = ArenaAlloc(buffers->Arena, triCount);
+    MeshletBuilder* builder = ArenaAlloc(buffers->Arena, sizeof(MeshletBuilder));
+    unsigned char* local = ArenaAlloc(buffers->Arena, vertexCount);
+    if (!indices || !live || !offsets || !adjacency || !emitted || !builder || !local) {
+        ArenaRelease(buffers->Arena, mark);
+        return false;
+    }
+
+    // Triangles around each vertex, the first live of them are the ones not yet in a meshlet
+    memset(live, 0, vertexCount * sizeof(unsigned int));
+    for (size_t i = 0; i < mesh->IndexCount; ++i) {
+        indices[i] = buffers->Indices[mesh->IndexOffset + i] - (unsigned int)mesh->VertexOffset;
+        live[indices[i]]++;
+    }
+    offsets[0] = 0;
+    for (size_t v = 0; v < vertexCount; ++v) {
+        offsets[v + 1] = offsets[v] + live[v];
+        live[v] = 0;
+    }
+    for (size_t i = 0; i < mesh->IndexCount; ++i) adjacency[offsets[indices[i]] + live[indices[i]]++] = (unsigned int)(i / 3);
+    memset(emitted, 0, triCount);
+    memset(local, 0xFF, vertexCount);
+    builder->VertexCount = 0;
+    builder->TriangleCount = 0;
+    builder->Local = local;
+
+    size_t scan = 0;
+    for (size_t done = 0; done < triCount; ++done) {
+        unsigned int best = FORSYTH_NO_TRIANGLE;
+        unsigned int bestNew = 4;
+        for (unsigned int i = 0; i < builder->VertexCount && bestNew > 0; ++i) {
+            unsigned int v = builder->Vertices[i];
+            for (unsigned int a = 0; a < live[v]; ++a) {
+                unsigned int t = adjacency[offsets[v] + a];
+                unsigned int added = (local[indices[t * 3]] == 0xFF) + (local[indices[t * 3 + 1]] == 0xFF) + (local[indices[t * 3 + 2]] == 0xFF);
+                if (added < bestNew) {
+                    best = t;
+                    bestNew = added;
+                }
+            }
+        }
+        if (best == FORSYTH_NO_TRIANGLE) {
+            while (emitted[scan]) scan++;
+            best = (unsigned int)scan;
+            bestNew = 3;
+        }
+        if (builder->VertexCount + bestNew > MESHLET_MAX_VERTICES || builder->TriangleCount == MESHLET_MAX_TRIANGLES) {
+            FlushMeshlet(buffers, mesh, builder);
+        }
+
+        const unsigned int* tri = &indices[best * 3];
+        for (int k = 0; k < 3; ++k) {
+            unsigned int v = tri[k];
+            if (local[v] == 0xFF) {
+                local[v] = (unsigned char)builder->VertexCount;
+                builder->Vertices[builder->VertexCount++] = v;
+            }
+            builder->Triangles[builder->TriangleCount * 3 + k] = local[v];
+            unsigned int* list = &adjacency[offsets[v]];
+            for (unsigned int a = 0; a < live[v]; ++a) {
+                if (list[a] == best) {
+                    list[a] = list[--live[v]];
+                    list[live[v]] = best;
+                    break;
+                }
+            }
+        }
+        builder->TriangleCount++;
+        emitted[best] = 1;
+    }
+    FlushMeshlet(buffers, mesh, builder);
+    mesh->MeshletCount = (uint32_t)(buffers->MeshletCount - mesh->MeshletFirst);
+    ArenaRelease(buffers->Arena, mark);
+    return true;
+}
+
+// Sets the box and bounding sphere of mesh to those of the positions its count indices use, each stride floats apart
+static void ComputeBounds(Mesh* mesh, const float* positions, size_t stride, const unsigned int* indices, size_t count) {
+    float min[3] = { INFINITY, INFINITY, INFINITY };
+    float max[3] = { -INFINITY, -INFINITY, -INFINITY };
+    for (size_t i = 0; i < count; ++i) {
+        const float* p = &positions[(size_t)indices[i] * stride];
+        for (int k = 0; k < 3; ++k) {
+            if (p[k] < min[k]) min[k] = p[k];
+            if (p[k] > max[k]) max[k] = p[k];
+        }
+    }
+    for (int k = 0; k < 3; ++k) {
+        mesh->BoundsMin[k] = count > 0 ? min[k] : 0.0f;
+        mesh->BoundsMax[k] = count > 0 ? max[k] : 0.0f;
+        mesh->Center[k] = (mesh->BoundsMin[k] + mesh->BoundsMax[k]) * 0.5f;
+    }
+    double radius = 0.0;
+    for (size_t i = 0; i < count; ++i) {
+        const float* p = &positions[(size_t)indices[i] * stride];
+        double dx = p[0] - mesh->Center[0], dy = p[1] - mesh->Center[1], dz = p[2] - mesh->Center[2];
+        double distance = sqrt(dx * dx + dy * dy + dz * dz);
+        if (distance > radius) radius = distance;
+    }
+    // Rounded up so the float radius still holds every vertex
+    mesh->Radius = (float)radius;
+    if ((double)mesh->Radius < radius) mesh->Radius = nextafterf(mesh->Radius, INFINITY);
+}
+
+// Triangles of a BVH node falling in one bin along the split axis
+typedef struct BvhBin {
+    float Min[3];
+    float Max[3];
+    unsigned int Count;
+} BvhBin;
+
+static void GrowBox(float* min, float* max, const float* boxMin, const float* boxMax) {
+    for (int k = 0; k < 3; ++k) {
+        if (boxMin[k] < min[k]) min[k] = boxMin[k];
+        if (boxMax[k] > max[k]) max[k] = boxMax[k];
+    }
+}
+
+// Half the surface area of a box, empty boxes have none
+static float GetBoxArea(const float* min, const float* max) {
+    float dx = max[0] - min[0], dy = max[1] - min[1], dz = max[2] - min[2];
+    return dx >= 0.0f && dy >= 0.0f && dz >= 0.0f ? dx * dy + dy * dz + dz * dx : 0.0f;
+}
+
+// Bin of a centroid along an axis of a node whose centroids start at low, scale being BVH_BINS over their extent
+static unsigned int GetBvhBin(float centroid, float low, float scale) {
+    float bin = (centroid - low) * scale;
+    return bin > 0.0f ? (bin < BVH_BINS ? (unsigned int)bin : BVH_BINS - 1) : 0;
+}
+
+// Builds a BVH over the triangles of mesh m, top down with binned SAH, and appends its nodes and triangle list to the
+// buffers' BVH data. Each node is split at the best of BVH_BINS - 1 planes along each axis, the plane that least
+// raises the expected cost of a ray through it, or left a leaf when splitting would cost more. Nodes are written
+// in the order they are split with the children of each node together. Node 1 is left empty so every pair of
+// children shares a 64 byte cache line, and both are tested after a single fetch.
+static bool BuildBvh(Buffers* buffers, unsigned int m) {
+    Mesh* mesh = &buffers->Meshes[m];
+    size_t triCount = mesh->IndexCount / 3;
+    mesh->BvhOffset = buffers->BvhBytes;
+    mesh->BvhNodeCount = 0;
+    mesh->BvhDepth = 0;
+    if (triCount == 0) return true;
+    ArenaMark mark = ArenaGetMark(buffers->Arena);
+    float* boxes = ArenaAlloc(buffers->Arena, triCount * 6 * sizeof(float));
+    float* centroids = ArenaAlloc(buffers->Arena, triCount * 3 * sizeof(float));
+    uint32_t* order = ArenaAlloc(buffers->Arena, triCount * sizeof(uint32_t));
+    unsigned int* stack = ArenaAlloc(buffers->Arena, triCount * 2 * sizeof(unsigned int));
+    if (!boxes || !centroids || !order || !stack) {
+        ArenaRelease(buffers->Arena, mark);
+        return false;
+    }
+    const unsigned int* indices = &buffers->Indices[mesh->IndexOffset];
+    for (size_t t = 0; t < triCount; ++t) {
+        float* box = &boxes[t * 6];
+        for (int k = 0; k < 3; ++k) {
+            box[k] = INFINITY;
+            box[k + 3] = -INFINITY;
+        }
+        for (int c = 0; c < 3; ++c) {
+            const float* p = &buffers->Vertices[(size_t)indices[t * 3 + c] * buffers->VertexFloats];
+            GrowBox(box, box + 3, p, p);
+        }
+        for (int k = 0; k < 3; ++k) centroids[t * 3 + k] = (box[k] + box[k + 3]) * 0.5f;
+        order[t] = (uint32_t)t;
+    }
+
+    // Nodes are written straight in to the BVH data, a stack entry is a node still to split and its depth
+    ObjToBinBvhNode* nodes = (ObjToBinBvhNode*)&buffers->BvhData[buffers->BvhBytes];
+    memset(nodes, 0, 2 * sizeof(ObjToBinBvhNode));
+    nodes[0].Count = (uint32_t)triCount;
+    size_t nodeCount = 2;
+    size_t stackSize = 0;
+    stack[stackSize++] = 0;
+    stack[stackSize++] = 1;
+    while (stackSize > 0) {
+        unsigned int depth = stack[--stackSize];
+        ObjToBinBvhNode* node = &nodes[stack[--stackSize]];
+        if (depth > mesh->BvhDepth) mesh->BvhDepth = depth;
+        uint32_t first = node->First;
+        uint32_t count = node->Count;
+        float centroidMin[3] = { INFINITY, INFINITY, INFINITY };
+        float centroidMax[3] = { -INFINITY, -INFINITY, -INFINITY };
+        for (int k = 0; k < 3; ++k) {
+            node->Min[k] = INFINITY;
+            node->Max[k] = -INFINITY;
+        }
+        for (uint32_t i = first; i < first + count; ++i) {
+            GrowBox(node->Min, node->Max, &boxes[order[i] * 6], &boxes[order[i] * 6 + 3]);
+            GrowBox(centroidMin, centroidMax, &centroids[order[i] * 3], &centroids[order[i] * 3]);
+        }
+        if (count == 1) continue;
+
+        // Bins every axis in one pass, then sweeps the bins of each from both ends to cost every plane between them
+        BvhBin bins[3][BVH_BINS];
+        float scales[3];
+        for (int axis = 0; axis < 3; ++axis) {
+            float extent = centroidMax[axis] - centroidMin[axis];
+            scales[axis] = extent > 0.0f ? BVH_BINS / extent : 0.0f;
+            for (unsigned int b = 0; b < BVH_BINS; ++b) {
+                for (int k = 0; k < 3; ++k) {
+                    bins[axis][b].Min[k] = INFINITY;
+                    bins[axis][b].Max[k] = -INFINITY;
+                }
+                bins[axis][b].Count = 0;
+            }
+        }
+        for (uint32_t i = first; i < first + count; ++i) {
+            const float* box = &boxes[order[i] * 6];
+            for (int axis = 0; axis < 3; ++axis) {
+                BvhBin* bin = &bins[axis][GetBvhBin(centroids[order[i] * 3 + axis], centroidMin[axis], scales[axis])];
+                GrowBox(bin->Min, bin->Max, box, box + 3);
+                bin->Count++;
+            }
+        }
+        float area = GetBoxArea(node->Min, node->Max);
+        float bestCost = INFINITY;
+        int bestAxis = -1;
+        unsigned int bestBin = 0;
+        for (int axis = 0; axis < 3; ++axis) {
+            if (!(scales[axis] > 0.0f)) continue;
+            float rightCost[BVH_BINS];
+            float min[3] = { INFINITY, INFINITY, INFINITY };
+            float max[3] = { -INFINITY, -INFINITY, -INFINITY };
+            unsigned int rightCount = 0;
+            for (unsigned int b = BVH_BINS - 1; b > 0; --b) {
+                GrowBox(min, max, bins[axis][b].Min, bins[axis][b].Max);
+                rightCount += bins[axis][b].Count;
+                rightCost[b] = GetBoxArea(min, max) * rightCount;
+            }
+            for (int k = 0; k < 3; ++k) {
+                min[k] = INFINITY;
+                max[k] = -INFINITY;
+            }
+            unsigned int leftCount = 0;
+            for (unsigned int b = 0; b < BVH_BINS - 1; ++b) {
+                GrowBox(min, max, bins[axis][b].Min, bins[axis][b].Max);
+                leftCount += bins[axis][b].Count;
+                if (leftCount == 0 || leftCount == count) continue;
+                float cost = BVH_TRAVERSAL_COST + (GetBoxArea(min, max) * leftCount + rightCost[b + 1]) / (area > 0.0f ? area : 1.0f);
+                if (cost < bestCost) {
+                    bestCost = cost;
+                    bestAxis = axis;
+                    bestBin = b;
+                }
+            }
+        }
+        if (count <= BVH_MAX_LEAF_TRIANGLES && !(bestCost < (float)count)) continue;
+
+        // Triangles left of the plane are moved to the front. Triangles whose centroids all match are halved instead.
+        uint32_t split = first + count / 2;
+        if (bestAxis >= 0) {
+            split = first;
+            for (uint32_t i = first; i < first + count; ++i) {
+                if (GetBvhBin(centroids[order[i] * 3 + bestAxis], centroidMin[bestAxis], scales[bestAxis]) > bestBin) continue;
+                uint32_t swap = order[i];
+                order[i] = order[split];
+                order[split++] = swap;
+            }
+        }
+        size_t left = nodeCount;
+        nodeCount += 2;
+        nodes[left].First = first;
+        nodes[left].Count = split - first;
+        nodes[left + 1].First = split;
+        nodes[left + 1].Count = first + count - split;
+        node->First = (uint32_t)left;
+        node->Count = 0;
+        // The left child is split next
+        stack[stackSize++] = (unsigned int)left + 1;
+        stack[stackSize++] = depth + 1;
+        stack[stackSize++] = (unsigned int)left;
+        stack[stackSize++] = depth + 1;
+    }
+
+    // The triangle list follows the nodes, then padding to the next pair of nodes. A single leaf needs no node 1.
+    if (nodeCount == 2) nodeCount = 1;
+    size_t listBytes = triCount * sizeof(uint32_t);
+    size_t size = (nodeCount * sizeof(ObjToBinBvhNode) + listBytes + 2 * sizeof(ObjToBinBvhNode) - 1) & ~(2 * sizeof(ObjToBinBvhNode) - 1);
+    unsigned char* list = (unsigned char*)&nodes[nodeCount];
+    memcpy(list, order, listBytes);
+    memset(list + listBytes, 0, size - nodeCount * sizeof(ObjToBinBvhNode) - listBytes);
+    mesh->BvhNodeCount = (uint32_t)nodeCount;
+    buffers->BvhBytes += size;
+    ArenaRelease(buffers->Arena, mark);
+    return true;
+}
+
+static unsigned short FloatToHalf(float value) {
+    uint32_t bits;
+    memcpy(&bits, &value, sizeof(bits));
+    uint32_t sign = (bits >> 16) & 0x8000;
+    uint32_t mantissa = bits & 0x7FFFFF;
+    int exponent = (int)((bits >> 23) & 0xFF);
+    if (exponent == 0xFF) return (unsigned short)(sign | 0x7C00 | (mantissa ? 0x200 : 0));
+    exponent += 15 - 127;
+    if (exponent >= 31) return (unsigned short)(sign | 0x7C00);
+    if (exponent <= 0) {
+        // Subnormal half, shift in the implicit bit and round to nearest even
+        if (exponent < -10) return (unsigned short)sign;
+        mantissa |= 0x800000;
+        uint32_t shift = (uint32_t)(14 - exponent);
+        uint32_t half = mantissa >> shift;
+        uint32_t rest = mantissa & ((1u << shift) - 1);
+        uint32_t halfway = 1u << (shift - 1);
+        if (rest > halfway || (rest == halfway && (half & 1))) half++;
+        return (unsigned short)(sign | half);
+    }
+    uint32_t half = ((uint32_t)exponent << 10) | (mantissa >> 13);
+    uint32_t rest = mantissa & 0x1FFF;
+    if (rest > 0x1000 || (rest == 0x1000 && (half & 1))) half++; // Carries in to the exponent, up to infinity
+    return (unsigned short)(sign | half);
+}
+
+static float HalfToFloat(unsigned short half) {
+    uint32_t sign = (uint32_t)(half & 0x8000) << 16;
+    uint32_t exponent = (half >> 10) & 0x1F;
+    uint32_t mantissa = half & 0x3FF;
+    uint32_t bits;
+    if (exponent == 0) {
+        if (mantissa == 0) bits = sign;
+        else {
+            exponent = 127 - 15 + 1;
+            while (!(mantissa & 0x400)) {
+                mantissa <<= 1;
+                exponent--;
+            }
+            bits = sign | (exponent << 23) | ((mantissa & 0x3FF) << 13);
+        }
+    }
+    else if (exponent == 31) bits = sign | 0x7F800000 | (mantissa << 13);
+    else bits = sign | ((exponent + 127 - 15) << 23) | (mantissa << 13);
+    float value;
+    memcpy(&value, &bits, sizeof(value));
+    return value;
+}
+
+static short EncodeSnorm16(float value) {
+    value = value < -1.0f ? -1.0f : value > 1.0f ? 1.0f : value;
+    return (short)lrintf(value * 32767.0f);
+}
+
+static float DecodeSnorm16(short value) {
+    float decoded = (float)value / 32767.0f;
+    return decoded < -1.0f ? -1.0f : decoded;
+}
+
+static unsigned short EncodeUnorm16(float value) {
+    value = value < 0.0f ? 0.0f : value > 1.0f ? 1.0f : value;
+    return (unsigned short)lrintf(value * 65535.0f);
+}
+
+// Folds the unit sphere on to an octahedron and unfolds it on to a square, see "A Survey of Efficient
+// Representations for Independent Unit Vectors" (Cigolle et al. 2014)
+static void EncodeOctahedral(const float* n, short* out) {
+    float l1 = fabsf(n[0]) + fabsf(n[1]) + fabsf(n[2]);
+    float x = l1 > 0.0f ? n[0] / l1 : 0.0f;
+    float y = l1 > 0.0f ? n[1] / l1 : 0.0f;
+    if (n[2] < 0.0f) {
+        float foldedX = (1.0f - fabsf(y)) * (x >= 0.0f ? 1.0f : -1.0f);
+        float foldedY = (1.0f - fabsf(x)) * (y >= 0.0f ? 1.0f : -1.0f);
+        x = foldedX;
+        y = foldedY;
+    }
+    out[0] = EncodeSnorm16(x);
+    out[1] = EncodeSnorm16(y);
+}
+
+static void DecodeOctahedral(const short* in, float* n) {
+    float x = DecodeSnorm16(in[0]);
+    float y = DecodeSnorm16(in[1]);
+    float z = 1.0f - fabsf(x) - fabsf(y);
+    if (z < 0.0f) {
+        float unfoldedX = (1.0f - fabsf(y)) * (x >= 0.0f ? 1.0f : -1.0f);
+        float unfoldedY = (1.0f - fabsf(x)) * (y >= 0.0f ? 1.0f : -1.0f);
+        x = unfoldedX;
+        y = unfoldedY;
+    }
+    float length = sqrtf(x * x + y * y + z * z);
+    n[0] = x / length;
+    n[1] = y / length;
+    n[2] = z / length;
+}
+
+static unsigned int GetAttributeFormat(unsigned int formats, unsigned int component) {
+    unsigned int index = 0;
+    while (component > 1) {
+        component >>= 1;
+        index++;
+    }
+    return (formats >> (index * 4)) & 0xF;
+}
+
+// Number of floats an attribute has while working on it, tangents carry their handedness in w
+static unsigned int GetAttributeFloats(unsigned int component) {
+    return component == OBJTOBIN_VERTEX_TEXCOORDS ? 2 : component == OBJTOBIN_VERTEX_TANGENTS ? 4 : 3;
+}
+
+static unsigned int GetAttributeBytes(unsigned int format, unsigned int floats) {
+    switch (format) {
+    case OBJTOBIN_FORMAT_HALF:
+    case OBJTOBIN_FORMAT_SNORM16:
+    case OBJTOBIN_FORMAT_UNORM16: return floats * 2;
+    case OBJTOBIN_FORMAT_OCT16: return floats == 4 ? 6 : 4;
+    default: return floats * 4;
+    }
+}
+
+// Bytes an attribute takes within a vertex, planar attributes are each padded so every array stays 4 byte aligned
+static unsigned int GetAttributeStride(const Header* header, unsigned int component) {
+    unsigned int bytes = GetAttributeBytes(GetAttributeFormat(header->Formats, component), GetAttributeFloats(component));
+    return header->Layout == OBJTOBIN_LAYOUT_PLANAR ? (bytes + 3) & ~3u : bytes;
+}
+
+// Byte stride of an encoded vertex, padded so every vertex starts 4 byte aligned
+static unsigned int GetVertexStride(const Header* header) {
+    unsigned int stride = 0;
+    for (unsigned int component = OBJTOBIN_VERTEX_POSITION; component <= OBJTOBIN_VERTEX_TANGENTS; component <<= 1) {
+        if (header->Components & component) stride += GetAttributeStride(header, component);
+    }
+    return (stride + 3) & ~3u;
+}
+
+// Byte offset of an attribute of vertex v in a mesh's vertex block. Planar blocks hold each attribute's
+// array one after another, so both layouts make a block of vertexCount * VertexSize bytes.
+static size_t GetAttributeOffset(const Header* header, unsigned int component, size_t v, size_t vertexCount) {
+    size_t offset = 0;
+    for (unsigned int previous = OBJTOBIN_VERTEX_POSITION; previous < component; previous <<= 1) {
+        if (header->Components & previous) offset += GetAttributeStride(header, previous);
+    }
+    if (header->Layout == OBJTOBIN_LAYOUT_PLANAR) return offset * vertexCount + v * GetAttributeStride(header, component);
+    return v * header->VertexSize + offset;
+}
+
+static unsigned char* EncodeAttribute(unsigned char* dst, const float* src, unsigned int floats, unsigned int format, const float* scale, const float* offset) {
+    float value[4];
+    for (unsigned int k = 0; k < floats; ++k) {
+        value[k] = scale ? (src[k] - offset[k]) / scale[k] : src[k];
+    }
+    if (format == OBJTOBIN_FORMAT_OCT16) {
+        short oct[2];
+        EncodeOctahedral(value, oct);
+        memcpy(dst, oct, sizeof(oct));
+        dst += sizeof(oct);
+        if (floats == 4) {
+            short handedness = EncodeSnorm16(value[3]);
+            memcpy(dst, &handedness, sizeof(handedness));
+            dst += sizeof(handedness);
+        }
+        return dst;
+    }
+    for (unsigned int k = 0; k < floats; ++k) {
+        if (format == OBJTOBIN_FORMAT_HALF) {
+            unsigned short half = FloatToHalf(value[k]);
+            memcpy(dst, &half, sizeof(half));
+            dst += sizeof(half);
+        }
+        else if (format == OBJTOBIN_FORMAT_SNORM16) {
+            short snorm = EncodeSnorm16(value[k]);
+            memcpy(dst, &snorm, sizeof(snorm));
+            dst += sizeof(snorm);
+        }
+        else if (format == OBJTOBIN_FORMAT_UNORM16) {
+            unsigned short unorm = EncodeUnorm16(value[k]);
+            memcpy(dst, &unorm, sizeof(unorm));
+            dst += sizeof(unorm);
+        }
+        else {
+            memcpy(dst, &value[k], sizeof(float));
+            dst += sizeof(float);
+        }
+    }
+    return dst;
+}
+
+static const unsigned char* DecodeAttribute(float* dst, const unsigned char* src, unsigned int floats, unsigned int format, const float* scale, const float* offset) {
+    if (format == OBJTOBIN_FORMAT_OCT16) {
+        short oct[2];
+        memcpy(oct, src, sizeof(oct));
+        DecodeOctahedral(oct, dst);
+        src += sizeof(oct);
+        if (floats == 4) {
+            short handedness;
+            memcpy(&handedness, src, sizeof(handedness));
+            dst[3] = DecodeSnorm16(handedness);
+            src += sizeof(handedness);
+        }
+    }
+    else {
+        for (unsigned int k = 0; k < floats; ++k) {
+            if (format == OBJTOBIN_FORMAT_HALF) {
+                unsigned short half;
+                memcpy(&half, src, sizeof(half));
+                dst[k] = HalfToFloat(half);
+                src += sizeof(half);
+            }
+            else if (format == OBJTOBIN_FORMAT_SNORM16) {
+                short snorm;
+                memcpy(&snorm, src, sizeof(snorm));
+                dst[k] = DecodeSnorm16(snorm);
+                src += sizeof(snorm);
+            }
+            else if (format == OBJTOBIN_FORMAT_UNORM16) {
+                unsigned short unorm;
+                memcpy(&unorm, src, sizeof(unorm));
+                dst[k] = (float)unorm / 65535.0f;
+                src += sizeof(unorm);
+            }
+            else {
+                memcpy(&dst[k], src, sizeof(float));
+                src += sizeof(float);
+            }
+        }
+    }
+    if (scale) {
+        for (unsigned int k = 0; k < floats; ++k) dst[k] = dst[k] * scale[k] + offset[k];
+    }
+    return src;
+}
+
+// Converts a working vertex of floats to vertex v of a mesh's block in the layout described by the header,
+// positions and texcoords go through the mesh's bounds transform
+static void EncodeVertex(unsigned char* block, size_t v, const float* src, const Header* header, const Mesh* mesh) {
+    for (unsigned int component = OBJTOBIN_VERTEX_POSITION; component <= OBJTOBIN_VERTEX_TANGENTS; component <<= 1) {
+        if (!(header->Components & component)) continue;
+        unsigned int floats = GetAttributeFloats(component);
+        const float* scale = component == OBJTOBIN_VERTEX_POSITION ? mesh->PositionScale : component == OBJTOBIN_VERTEX_TEXCOORDS ? mesh->TexcoordScale : NULL;
+        const float* offset = component == OBJTOBIN_VERTEX_POSITION ? mesh->PositionOffset : mesh->TexcoordOffset;
+        unsigned char* dst = &block[GetAttributeOffset(header, component, v, mesh->VertexCount)];
+        EncodeAttribute(dst, src, floats, GetAttributeFormat(header->Formats, component), scale, offset);
+        src += floats;
+    }
+}
+
+static void DecodeVertex(float* dst, const unsigned char* block, size_t v, const Header* header, const Mesh* mesh) {
+    for (unsigned int component = OBJTOBIN_VERTEX_POSITION; component <= OBJTOBIN_VERTEX_TANGENTS; component <<= 1) {
+        if (!(header->Components & component)) continue;
+        unsigned int floats = GetAttributeFloats(component);
+        const float* scale = component == OBJTOBIN_VERTEX_POSITION ? mesh->PositionScale : component == OBJTOBIN_VERTEX_TEXCOORDS ? mesh->TexcoordScale : NULL;
+        const float* offset = component == OBJTOBIN_VERTEX_POSITION ? mesh->PositionOffset : mesh->TexcoordOffset;
+        const unsigned char* src = &block[GetAttributeOffset(header, component, v, mesh->VertexCount)];
+        DecodeAttribute(dst, src, floats, GetAttributeFormat(header->Formats, component), scale, offset);
+        dst += floats;
+    }
+}
+
+// Fills in the bounds transforms that map a mesh's positions and texcoords in to the range of their format,
+// the transforms are identity for formats that store values directly
+static void ComputeMeshTransforms(Mesh* mesh, const float* vertices, unsigned int vertexFloats, const Header* header) {
+    float min[5], max[5];
+    for (unsigned int k = 0; k < 5; ++k) {
+        min[k] = mesh->VertexCount ? INFINITY : 0.0f;
+        max[k] = mesh->VertexCount ? -INFINITY : 0.0f;
+    }
+    unsigned int floats = header->Components & OBJTOBIN_VERTEX_TEXCOORDS ? 5 : 3;
+    for (unsigned int v = 0; v < mesh->VertexCount; ++v) {
+        const float* vertex = &vertices[(size_t)v * vertexFloats];
+        for (unsigned int k = 0; k < floats; ++k) {
+            if (vertex[k] < min[k]) min[k] = vertex[k];
+            if (vertex[k] > max[k]) max[k] = vertex[k];
+        }
+    }
+
+    bool positionBounds = GetAttributeFormat(header->Formats, OBJTOBIN_VERTEX_POSITION) != OBJTOBIN_FORMAT_FLOAT;
+    for (unsigned int k = 0; k < 3; ++k) {
+        float halfExtent = (max[k] - min[k]) * 0.5f;
+        bool transform = positionBounds && isfinite(halfExtent);
+        mesh->PositionScale[k] = transform && halfExtent > 0.0f ? halfExtent : 1.0f;
+        mesh->PositionOffset[k] = transform ? (min[k] + max[k]) * 0.5f : 0.0f;
+    }
+    bool texcoordBounds = GetAttributeFormat(header->Formats, OBJTOBIN_VERTEX_TEXCOORDS) == OBJTOBIN_FORMAT_UNORM16;
+    for (unsigned int k = 0; k < 2; ++k) {
+        float extent = max[k + 3] - min[k + 3];
+        bool transform = texcoordBounds && isfinite(extent);
+        mesh->TexcoordScale[k] = transform && extent > 0.0f ? extent : 1.0f;
+        mesh->TexcoordOffset[k] = transform ? min[k + 3] : 0.0f;
+    }
+}
+
+// Order sections are laid out in, the compressed sections last as they are only sized once written
+static const uint32_t kSectionOrder[PACK_SECTION_TYPES] = { OBJTOBIN_SECTION_MESHES, OBJTOBIN_SECTION_VERTICES, OBJTOBIN_SECTION_INDICES,
+                                                            OBJTOBIN_SECTION_LODS, OBJTOBIN_SECTION_MESHLETS, OBJTOBIN_SECTION_MESHLET_DATA,
+                                                            OBJTOBIN_SECTION_BVH, OBJTOBIN_SECTION_COMPRESSED_VERTICES, OBJTOBIN_SECTION_COMPRESSED_INDICES };
+
+// Whether sections of the type follow the indices and are copied as they are between packs
+static bool IsExtraSection(uint32_t type) {
+    return type > OBJTOBIN_SECTION_INDICES && type <= PACK_SECTION_TYPES && type != OBJTOBIN_SECTION_COMPRESSED_VERTICES &&
+           type != OBJTOBIN_SECTION_COMPRESSED_INDICES;
+}
+
+// Fills in the v2 header fields and lays out the sections after the section table in kSectionOrder, each aligned to
+// OBJTOBIN_ALIGNMENT. sizes holds the size of each section by ObjToBinSectionType - 1, the mesh and vertex sizes are filled
+// in from the header and the sections after the indices are left out when empty. The raw vertex and index sections
+// are left out when there are compressed ones. sections must have room for PACK_SECTION_TYPES. Returns the size of
+// the whole pack.
+static uint64_t LayoutPack(Header* header, ObjToBinSection* sections, uint64_t* sizes) {
+    header->Magic = OBJTOBIN_MAGIC;
+    header->Version = OBJTOBIN_VERSION;
+    header->HeaderSize = sizeof(Header);
+    header->SectionTableOffset = sizeof(Header);
+    header->MeshRecordSize = sizeof(Mesh);
+    sizes[OBJTOBIN_SECTION_MESHES - 1] = (uint64_t)header->MeshCount * sizeof(Mesh);
+    sizes[OBJTOBIN_SECTION_VERTICES - 1] = header->TotalVertices * header->VertexSize;
+    bool compressed = sizes[OBJTOBIN_SECTION_COMPRESSED_VERTICES - 1] > 0;
+    header->SectionCount = 0;
+    for (unsigned int s = 0; s < PACK_SECTION_TYPES; ++s) {
+        uint32_t type = kSectionOrder[s];
+        bool required = type == OBJTOBIN_SECTION_MESHES || (type <= OBJTOBIN_SECTION_INDICES && !compressed);
+        if (required || (type > OBJTOBIN_SECTION_INDICES && sizes[type - 1] > 0)) sections[header->SectionCount++].Type = type;
+    }
+    uint64_t offset = header->SectionTableOffset + header->SectionCount * sizeof(ObjToBinSection);
+    for (unsigned int s = 0; s < header->SectionCount; ++s) {
+        sections[s].Reserved = 0;
+        sections[s].Offset = (offset + OBJTOBIN_ALIGNMENT - 1) & ~(uint64_t)(OBJTOBIN_ALIGNMENT - 1);
+        sections[s].Size = sizes[sections[s].Type - 1];
+        offset = sections[s].Offset + sections[s].Size;
+    }
+    return offset;
+}
+
+// Returns the laid out section of the given type, or NULL if the pack has none
+static const ObjToBinSection* FindPackSection(const Header* header, const ObjToBinSection* sections, uint32_t type) {
+    for (unsigned int s = 0; s < header->SectionCount; ++s) {
+        if (sections[s].Type == type) return &sections[s];
+    }
+    return NULL;
+}
+
+static Writer FileWriter(FILE* file) {
+    Writer writer;
+    memset(&writer, 0, sizeof(Writer));
+    writer.File = file;
+    return writer;
+}
+
+// Writes size bytes of data at the writer's position, growing memory that is not the caller's as needed
+static bool WriterWrite(Writer* writer, const void* data, size_t size) {
+    if (writer->File) return fwrite(data, 1, size, writer->File) == size;
+    size_t end = writer->Position + size;
+    if (end > writer->Capacity && !writer->Fixed) {
+        size_t capacity = writer->Capacity * 2 > end ? writer->Capacity * 2 : end;
+        unsigned char* grown = realloc(writer->Data, capacity);
+        if (!grown) return false;
+        writer->Data = grown;
+        writer->Capacity = capacity;
+    }
+    if (end > writer->Capacity) writer->Overflow = true;
+    else if (size > 0) memcpy(&writer->Data[writer->Position], data, size);
+    writer->Position = end;
+    if (end > writer->Size) writer->Size = end;
+    return true;
+}
+
+// The result of a failed write, memory that is not the caller's failing to grow
+static int WriterResult(const Writer* writer) {
+    return writer->File ? OBJTOBIN_ERROR_WRITE : OBJTOBIN_ERROR_MEMORY;
+}
+
+static bool WriterSeek(Writer* writer, uint64_t position) {
+    if (writer->File) return FileSeek(writer->File, position) == 0;
+    writer->Position = (size_t)position;
+    return true;
+}
+
+// Writes zeros from position up to offset, the start of the next section
+static bool WritePadding(Writer* writer, uint64_t* position, uint64_t offset) {
+    static const char zeros[OBJTOBIN_ALIGNMENT] = { 0 };
+    size_t size = (size_t)(offset - *position);
+    if (size > 0 && !WriterWrite(writer, zeros, size)) return false;
+    *position = offset;
+    return true;
+}
+
+// Copies size bytes starting at offset in src to the end of dst. On Linux the kernel copies the range
+// without it passing through user space, anything it can not do is finished with large buffered copies.
+static bool CopyFileBlock(FILE* dst, FILE* src, uint64_t offset, uint64_t size, char* buffer) {
+#ifdef __linux__
+    if (fflush(dst) != 0) return false;
+    loff_t inOffset = (loff_t)offset;
+    while (size > 0) {
+        ssize_t copied = copy_file_range(fileno(src), &inOffset, fileno(dst), NULL, size, 0);
+        if (copied <= 0) break;
+        size -= copied;
+    }
+    offset = (uint64_t)inOffset;
+    if (fseeko(dst, 0, SEEK_END) != 0) return false;
+#endif
+    if (size == 0) return true;
+    if (FileSeek(src, offset) != 0) return false;
+    while (size > 0) {
+        size_t chunk = size < COPY_BUFFER_SIZE ? (size_t)size : COPY_BUFFER_SIZE;
+        if (fread(buffer, 1, chunk, src) < chunk || fwrite(buffer, 1, chunk, dst) < chunk) return false;
+        size -= chunk;
+    }
+    return true;
+}
+
+// Sets the written formats, layout and vertex size from the options, once the components are known
+static void SetPackFormats(Header* header, const Options* options) {
+    header->Formats = 0;
+    if (header->Components & OBJTOBIN_VERTEX_POSITION) header->Formats |= options->PositionFormat;
+    if (header->Components & OBJTOBIN_VERTEX_TEXCOORDS) header->Formats |= options->TexcoordFormat << 4;
+    if (header->Components & OBJTOBIN_VERTEX_NORMALS) header->Formats |= options->NormalFormat << 8;
+    if (header->Components & OBJTOBIN_VERTEX_TANGENTS) header->Formats |= options->TangentFormat << 12;
+    header->Layout = options->Flags & OBJTOBIN_FLAG_PLANAR ? OBJTOBIN_LAYOUT_PLANAR : OBJTOBIN_LAYOUT_INTERLEAVED;
+    header->VertexSize = GetVertexStride(header);
+    header->IndexSize = 2;
+}
+
+// True if mesh m uses the same vertices as the mesh before it, whose vertex block it shares rather than having its own
+static bool SharesVertices(const Mesh* meshes, unsigned int m) {
+    return m > 0 && meshes[m].VertexCount > 0 && meshes[m].VertexOffset == meshes[m - 1].VertexOffset &&
+           meshes[m].VertexCount == meshes[m - 1].VertexCount;
+}
+
+// Computes the transforms and index size of a welded mesh of the buffers and places its indices at indexBytes in
+// the pack's index section, followed by those of its levels of detail lods. A mesh sharing the vertices of shared takes its
+// transforms, shared being NULL otherwise. With OBJTOBIN_FLAG_AUTO_INDEX_SIZE a mesh with no more than 65536 vertices uses
+// 16-bit indices. Returns the size of the mesh's indices, each range padded to 4 bytes.
+static size_t PrepareMesh(Buffers* buffers, Mesh* mesh, const Mesh* shared, ObjToBinLod* lods, uint64_t indexBytes) {
+    Header* header = &buffers->Header;
+    if (shared) {
+        memcpy(mesh->PositionScale, shared->PositionScale, sizeof(mesh->PositionScale));
+        memcpy(mesh->PositionOffset, shared->PositionOffset, sizeof(mesh->PositionOffset));
+        memcpy(mesh->TexcoordScale, shared->TexcoordScale, sizeof(mesh->TexcoordScale));
+        memcpy(mesh->TexcoordOffset, shared->TexcoordOffset, sizeof(mesh->TexcoordOffset));
+    }
+    else ComputeMeshTransforms(mesh, &buffers->Vertices[(size_t)mesh->VertexOffset * buffers->VertexFloats], buffers->VertexFloats, header);
+    mesh->IndexSize = buffers->Options->Flags & OBJTOBIN_FLAG_AUTO_INDEX_SIZE && mesh->VertexCount <= 65536 ? 2 : 4;
+    mesh->IndexOffset = indexBytes;
+    if (mesh->IndexSize > header->IndexSize) header->IndexSize = mesh->IndexSize;
+    size_t size = ((size_t)mesh->IndexCount * mesh->IndexSize + 3) & ~(size_t)3;
+    for (unsigned int l = 0; l < mesh->LodCount; ++l) {
+        lods[l].IndexOffset = indexBytes + size;
+        size += ((size_t)lods[l].IndexCount * mesh->IndexSize + 3) & ~(size_t)3;
+    }
+    return size;
+}
+
+// Levels of detail of a mesh in the working buffers, NULL if it has none
+static ObjToBinLod* GetMeshLods(const Buffers* buffers, const Mesh* mesh) {
+    return mesh->LodCount > 0 ? &buffers->Lods[mesh->LodFirst] : NULL;
+}
+
+// Encodes the vertices of a mesh in to scratch and writes them
+static bool WriteMeshVertices(Writer* writer, const Buffers* buffers, const Mesh* mesh, unsigned char* scratch) {
+    const Header* header = &buffers->Header;
+    memset(scratch, 0, (size_t)mesh->VertexCount * header->VertexSize);
+    for (size_t v = 0; v < mesh->VertexCount; ++v) {
+        EncodeVertex(scratch, v, &buffers->Vertices[(mesh->VertexOffset + v) * buffers->VertexFloats], header, mesh);
+    }
+    if (!WriterWrite(writer, scratch, (size_t)mesh->VertexCount * header->VertexSize)) {
+        ReportError(WriterResult(writer), "Error: Failed to write binary vertex data! Aborting.");
+        return false;
+    }
+    return true;
+}
+
+// Writes count indices relative to the mesh's first vertex, padded to 4 bytes
+static bool WriteIndexRange(Writer* writer, const unsigned int* indices, size_t count, const Mesh* mesh, unsigned char* scratch) {
+    size_t meshIndexBytes = (count * mesh->IndexSize + 3) & ~(size_t)3;
+    memset(scratch, 0, meshIndexBytes);
+    for (size_t i = 0; i < count; ++i) {
+        unsigned int index = (unsigned int)(indices[i] - mesh->VertexOffset);
+        if (mesh->IndexSize == 2) {
+            unsigned short index16 = (unsigned short)index;
+            memcpy(&scratch[i * 2], &index16, sizeof(index16));
+        }
+        else memcpy(&scratch[i * 4], &index, sizeof(index));
+    }
+    if (!WriterWrite(writer, scratch, meshIndexBytes)) {
+        ReportError(WriterResult(writer), "Error: Failed to write binary index data! Aborting.");
+        return false;
+    }
+    return true;
+}
+
+// Writes the indices of a mesh then those of its levels of detail lods, indices and lodIndices being the mesh's
+// ranges of the working buffers
+static bool WriteMeshIndices(Writer* writer, const unsigned int* indices, const unsigned int* lodIndices, const ObjToBinLod* lods,
+                      const Mesh* mesh, unsigned char* scratch) {
+    if (!WriteIndexRange(writer, indices, mesh->IndexCount, mesh, scratch)) return false;
+    for (unsigned int l = 0; l < mesh->LodCount; lodIndices += lods[l++].IndexCount) {
+        if (!WriteIndexRange(writer, lodIndices, lods[l].IndexCount, mesh, scratch)) return false;
+    }
+    return true;
+}
+
+// Writes the header, section table and mesh records, then pads to the vertex section
+static bool WritePackHead(Writer* writer, Header* header, ObjToBinSection* sections, const Mesh* meshes, uint64_t* position) {
+    if (!WriterWrite(writer, header, sizeof(Header)) || !WriterWrite(writer, sections, header->SectionCount * sizeof(ObjToBinSection))) {
+        ReportError(WriterResult(writer), "Error: Failed to write binary header! Aborting.");
+        return false;
+    }
+    *position = sizeof(Header) + header->SectionCount * sizeof(ObjToBinSection);
+    if (!WritePadding(writer, position, sections[0].Offset) || !WriterWrite(writer, meshes, (size_t)header->MeshCount * sizeof(Mesh))) {
+        ReportError(WriterResult(writer), "Error: Failed to write binary mesh! Aborting.");
+        return false;
+    }
+    *position += sections[0].Size;
+    return WritePadding(writer, position, sections[1].Offset);
+}
+
+// Pads to and writes a section following the index section from data, if the pack has one of the type.
+// Sections must be written in the order they are laid out.
+static bool WritePackSection(Writer* writer, const Header* header, const ObjToBinSection* sections, uint32_t type, const void* data, uint64_t* position) {
+    const ObjToBinSection* section = FindPackSection(header, sections, type);
+    if (!section) return true;
+    if (!WritePadding(writer, position, section->Offset) || !WriterWrite(writer, data, (size_t)section->Size)) {
+        ReportError(WriterResult(writer), "Error: Failed to write the %s! Aborting.", type == OBJTOBIN_SECTION_LODS ? "levels of detail" : type == OBJTOBIN_SECTION_BVH ? "BVHs" : "meshlets");
+        return false;
+    }
+    *position += section->Size;
+    return true;
+}
+
+// Writes the header, section table, mesh records, encoded vertex section and index section
+static bool WriteBinary(Writer* writer, Buffers* buffers) {
+    Header* header = &buffers->Header;
+    SetPackFormats(header, buffers->Options);
+
+    uint64_t indexBytes = 0;
+    size_t maxVertexCount = 0;
+    size_t maxIndexBytes = 0;
+    for (unsigned int m = 0; m < header->MeshCount; ++m) {
+        Mesh* mesh = &buffers->Meshes[m];
+        const Mesh* shared = SharesVertices(buffers->Meshes, m) ? &buffers->Meshes[m - 1] : NULL;
+        size_t meshIndexBytes = PrepareMesh(buffers, mesh, shared, GetMeshLods(buffers, mesh), indexBytes);
+        indexBytes += meshIndexBytes;
+        if (mesh->VertexCount > maxVertexCount) maxVertexCount = mesh->VertexCount;
+        if (meshIndexBytes > maxIndexBytes) maxIndexBytes = meshIndexBytes;
+    }
+
+    ObjToBinSection sections[PACK_SECTION_TYPES];
+    uint64_t sizes[PACK_SECTION_TYPES] = { 0, 0, indexBytes, buffers->LodCount * sizeof(ObjToBinLod),
+                                           buffers->MeshletCount * sizeof(ObjToBinMeshlet), buffers->MeshletDataBytes, 0, 0, buffers->BvhBytes };
+    LayoutPack(header, sections, sizes);
+    uint64_t position = 0;
+    if (!WritePackHead(writer, header, sections, buffers->Meshes, &position)) return false;
+
+    ArenaMark mark = ArenaGetMark(buffers->Arena);
+    unsigned char* scratch = ArenaAlloc(buffers->Arena, maxVertexCount * header->VertexSize > maxIndexBytes ? maxVertexCount * header->VertexSize : maxIndexBytes);
+    if (!scratch) {
+        ReportError(OBJTOBIN_ERROR_MEMORY, "Error: Failed to allocate required internal memory.");
+        ArenaRelease(buffers->Arena, mark);
+        return false;
+    }
+    bool success = true;
+    for (unsigned int m = 0; success && m < header->MeshCount; ++m) {
+        if (!SharesVertices(buffers->Meshes, m)) success = WriteMeshVertices(writer, buffers, &buffers->Meshes[m], scratch);
+    }
+    position += sections[1].Size;
+    success = success && WritePadding(writer, &position, sections[2].Offset);
+    // Mesh and LOD index ranges are contiguous in the working buffers, IndexOffset now holds the written byte offset
+    const unsigned int* indices = buffers->Indices;
+    const unsigned int* lodIndices = buffers->LodIndices;
+    for (unsigned int m = 0; success && m < header->MeshCount; ++m) {
+        const Mesh* mesh = &buffers->Meshes[m];
+        const ObjToBinLod* lods = GetMeshLods(buffers, mesh);
+        success = WriteMeshIndices(writer, indices, lodIndices, lods, mesh, scratch);
+        indices += mesh->IndexCount;
+        for (unsigned int l = 0; l < mesh->LodCount; ++l) lodIndices += lods[l].IndexCount;
+    }
+    position += sections[2].Size;
+    success = success && WritePackSection(writer, header, sections, OBJTOBIN_SECTION_LODS, buffers->Lods, &position) &&
+              WritePackSection(writer, header, sections, OBJTOBIN_SECTION_MESHLETS, buffers->Meshlets, &position) &&
+              WritePackSection(writer, header, sections, OBJTOBIN_SECTION_MESHLET_DATA, buffers->MeshletData, &position) &&
+              WritePackSection(writer, header, sections, OBJTOBIN_SECTION_BVH, buffers->BvhData, &position);
+    ArenaRelease(buffers->Arena, mark);
+    return success;
+}
+
+// Largest an LZ stream of size bytes can get, when nothing matches
+static size_t GetLzBound(size_t size) {
+    return size + size / 255 + 16;
+}
+
+static unsigned char* WriteLzLength(unsigned char* dst, size_t length) {
+    for (; length >= 255; length -= 255) *dst++ = 255;
+    *dst++ = (unsigned char)length;
+    return dst;
+}
+
+static unsigned char* WriteLzSequence(unsigned char* dst, const unsigned char* literals, size_t literalCount, size_t offset, size_t length) {
+    unsigned char* token = dst++;
+    *token = (unsigned char)((literalCount < 15 ? literalCount : 15) << 4);
+    if (literalCount >= 15) dst = WriteLzLength(dst, literalCount - 15);
+    memcpy(dst, literals, literalCount);
+    dst += literalCount;
+    if (length == 0) return dst;
+    *dst++ = (unsigned char)offset;
+    *dst++ = (unsigned char)(offset >> 8);
+    length -= LZ_MIN_MATCH;
+    *token |= (unsigned char)(length < 15 ? length : 15);
+    if (length >= 15) dst = WriteLzLength(dst, length - 15);
+    return dst;
+}
+
+// Greedy LZ compression in to the format ObjToBinLzDecode reads, dst must hold GetLzBound(size). The table of
+// 1 << LZ_HASH_BITS positions is never cleared, every candidate is checked so stale entries only cost a miss.
+static size_t LzCompress(unsigned char* dst, const unsigned char* src, size_t size, uint32_t* table) {
+    unsigned char* out = dst;
+    size_t anchor = 0;
+    size_t i = 0;
+    while (size >= LZ_MIN_MATCH && i <= size - LZ_MIN_MATCH) {
+        uint32_t sequence;
+        memcpy(&sequence, &src[i], 4);
+        uint32_t hash = (sequence * 2654435761u) >> (32 - LZ_HASH_BITS);
+        size_t candidate = table[hash];
+        table[hash] = (uint32_t)i;
+        if (candidate >= i || i - candidate > LZ_MAX_OFFSET || memcmp(&src[candidate], &src[i], 4) != 0) {
+            i += 1 + ((i - anchor) >> 6); // Skip faster through data that does not match
+            continue;
+        }
+        size_t length = LZ_MIN_MATCH;
+        while (i + length < size && src[candidate + length] == src[i + length]) length++;
+        while (i > anchor && candidate > 0 && src[i - 1] == src[candidate - 1]) {
+            i--;
+            candidate--;
+            length++;
+        }
+        out = WriteLzSequence(out, &src[anchor], i - anchor, i - candidate, length);
+        i += length;
+        anchor = i;
+    }
+    return (size_t)(WriteLzSequence(out, &src[anchor], size - anchor, 0, 0) - dst);
+}
+
+// Zigzag delta codes count rows of a vertex plane lane by lane and byte transposes each group of
+// OBJTOBIN_VERTEX_GROUP rows, the reverse of ObjToBinDecodeVertexPlane. Returns the end of dst.
+static unsigned char* EncodeVertexPlane(unsigned char* dst, const unsigned char* src, size_t count, const uint8_t* lanes, uint32_t laneCount, uint32_t stride) {
+    uint32_t previous[OBJTOBIN_MAX_LANES] = { 0 };
+    for (size_t first = 0; first < count; first += OBJTOBIN_VERTEX_GROUP) {
+        size_t rows = count - first < OBJTOBIN_VERTEX_GROUP ? count - first : OBJTOBIN_VERTEX_GROUP;
+        for (size_t r = 0; r < rows; ++r) {
+            const unsigned char* row = src + (first + r) * stride;
+            unsigned char* column = dst + r;
+            for (uint32_t l = 0; l < laneCount; ++l) {
+                uint32_t zigzag;
+                if (lanes[l] == 4) {
+                    uint32_t value;
+                    memcpy(&value, row, 4);
+                    uint32_t delta = value - previous[l];
+                    zigzag = (delta << 1) ^ (uint32_t)((int32_t)delta >> 31);
+                    previous[l] = value;
+                }
+                else {
+                    uint16_t value;
+                    memcpy(&value, row, 2);
+                    uint16_t delta = (uint16_t)(value - previous[l]);
+                    zigzag = (uint16_t)((delta << 1) ^ (uint16_t)((int16_t)delta >> 15));
+                    previous[l] = value;
+                }
+                for (uint32_t b = 0; b < lanes[l]; ++b) column[b * rows] = (unsigned char)(zigzag >> (b * 8));
+                row += lanes[l];
+                column += lanes[l] * rows;
+            }
+        }
+        dst += rows * stride;
+    }
+    return dst;
+}
+
+// Encodes a mesh's block of count vertices, the stream is the same size as the block
+static void EncodeVertexBlock(unsigned char* dst, const unsigned char* src, size_t count, const Header* header) {
+    uint8_t lanes[OBJTOBIN_MAX_LANES];
+    uint32_t stride;
+    if (header->Layout != OBJTOBIN_LAYOUT_PLANAR) {
+        uint32_t laneCount = ObjToBinGetLanes(header, header->Components, lanes, &stride);
+        EncodeVertexPlane(dst, src, count, lanes, laneCount, stride);
+        return;
+    }
+    for (unsigned int component = OBJTOBIN_VERTEX_POSITION; component <= OBJTOBIN_VERTEX_TANGENTS; component <<= 1) {
+        if (!(header->Components & component)) continue;
+        uint32_t laneCount = ObjToBinGetLanes(header, component, lanes, &stride);
+        dst = EncodeVertexPlane(dst, src, count, lanes, laneCount, stride);
+        src += count * stride;
+    }
+}
+
+static unsigned char* WriteVarint(unsigned char* dst, uint64_t value) {
+    for (; value >= 0x80; value >>= 7) *dst++ = (unsigned char)(value | 0x80);
+    *dst++ = (unsigned char)value;
+    return dst;
+}
+
+static unsigned char* WriteVertexRef(unsigned char* dst, uint32_t v, uint32_t* next, uint32_t* last) {
+    uint32_t delta = v - *last;
+    dst = WriteVarint(dst, v == *next ? 0 : (uint64_t)((delta << 1) ^ (uint32_t)((int32_t)delta >> 31)) + 1);
+    *last = v;
+    if (v >= *next) *next = v + 1;
+    return dst;
+}
+
+static uint32_t ReadIndex(const unsigned char* indices, size_t i, uint32_t indexSize) {
+    if (indexSize == 2) {
+        uint16_t index16;
+        memcpy(&index16, &indices[i * 2], 2);
+        return index16;
+    }
+    uint32_t index;
+    memcpy(&index, &indices[i * 4], 4);
+    return index;
+}
+
+// Codes count indices a triangle at a time, naming an edge of a recent triangle where one is shared, the reverse of
+// ObjToBinDecodeIndices. Returns the end of dst, which must hold count * 6 bytes.
+static unsigned char* EncodeIndices(unsigned char* dst, const unsigned char* indices, size_t count, uint32_t indexSize) {
+    uint32_t edges[OBJTOBIN_EDGE_FIFO][2] = { { 0 } };
+    uint32_t head = 0;
+    uint32_t next = 0;
+    uint32_t last = 0;
+    size_t i = 0;
+    for (; i + 3 <= count; i += 3) {
+        uint32_t triangle[3] = { ReadIndex(indices, i, indexSize), ReadIndex(indices, i + 1, indexSize), ReadIndex(indices, i + 2, indexSize) };
+        uint32_t code = OBJTOBIN_EDGE_FIFO * 3;
+        uint32_t valid = head < OBJTOBIN_EDGE_FIFO ? head : OBJTOBIN_EDGE_FIFO;
+        for (uint32_t e = 0; e < valid && code == OBJTOBIN_EDGE_FIFO * 3; ++e) {
+            const uint32_t* edge = edges[(head - 1 - e) & (OBJTOBIN_EDGE_FIFO - 1)];
+            for (uint32_t rotation = 0; rotation < 3; ++rotation) {
+                if (edge[0] == triangle[rotation] && edge[1] == triangle[(rotation + 1) % 3]) {
+                    code = e * 3 + rotation;
+                    break;
+                }
+            }
+        }
+        *dst++ = (unsigned char)code;
+        if (code < OBJTOBIN_EDGE_FIFO * 3) dst = WriteVertexRef(dst, triangle[(code % 3 + 2) % 3], &next, &last);
+        else {
+            for (uint32_t k = 0; k < 3; ++k) dst = WriteVertexRef(dst, triangle[k], &next, &last);
+        }
+        for (uint32_t k = 0; k < 3; ++k) {
+            uint32_t* pushed = edges[head++ & (OBJTOBIN_EDGE_FIFO - 1)];
+            pushed[0] = triangle[(k + 1) % 3];
+            pushed[1] = triangle[k];
+        }
+    }
+    for (; i < count; ++i) dst = WriteVertexRef(dst, ReadIndex(indices, i, indexSize), &next, &last);
+    return dst;
+}
+
+// Writes the stream of a block as is, or LZ compressed if that is smaller, appending it to a compressed section
+static bool WriteBlock(Writer* writer, ObjToBinBlock* block, const unsigned char* stream, size_t size, unsigned char* lz, uint32_t* table, uint64_t* sectionSize) {
+    size_t lzSize = size > 0 ? LzCompress(lz, stream, size, table) : 0;
+    block->Offset = *sectionSize;
+    block->StreamSize = size;
+    block->Size = lzSize < size ? lzSize : size;
+    *sectionSize += block->Size;
+    return WriterWrite(writer, lzSize < size ? lz : stream, (size_t)block->Size);
+}
+
+// Pads to the start of a compressed section and leaves room for its block table, filled in by WriteBlockTable
+static bool BeginCompressedSection(Writer* writer, uint64_t* position, uint64_t* sectionSize, unsigned int blockCount) {
+    static const unsigned char zeros[sizeof(ObjToBinBlock)] = { 0 };
+    bool success = WritePadding(writer, position, (*position + OBJTOBIN_ALIGNMENT - 1) & ~(uint64_t)(OBJTOBIN_ALIGNMENT - 1)) &&
+                   WriterWrite(writer, zeros, sizeof(ObjToBinCompressed));
+    for (unsigned int b = 0; success && b < blockCount; ++b) success = WriterWrite(writer, zeros, sizeof(ObjToBinBlock));
+    *sectionSize = sizeof(ObjToBinCompressed) + (uint64_t)blockCount * sizeof(ObjToBinBlock);
+    return success;
+}
+
+static bool WriteBlockTable(Writer* writer, const ObjToBinSection* section, uint64_t decodedSize, const ObjToBinBlock* blocks, unsigned int blockCount) {
+    ObjToBinCompressed compressed = { decodedSize, blockCount, 0 };
+    return WriterSeek(writer, section->Offset) && WriterWrite(writer, &compressed, sizeof(ObjToBinCompressed)) &&
+           WriterWrite(writer, blocks, blockCount * sizeof(ObjToBinBlock));
+}
+
+// Writes the raw pack with its vertex and index sections compressed, block by block so memory stays within a few
+// copies of the largest mesh. The compressed sections are written last since their sizes are only known once
+// encoded, then the header, section table and block tables are written over their placeholders. Sets size to the
+// size of the new pack.
+static bool WriteCompressedPack(Writer* writer, const ObjToBinPack* pack, const Options* options, uint64_t* size) {
+    Header header = *pack->Header;
+    uint64_t sizes[PACK_SECTION_TYPES] = { 0 };
+    for (unsigned int s = 0; s < header.SectionCount; ++s) {
+        uint32_t type = pack->Sections[s].Type;
+        if (IsExtraSection(type)) sizes[type - 1] = pack->Sections[s].Size;
+    }
+    // Placeholders until they are encoded, nothing is laid out after them
+    sizes[OBJTOBIN_SECTION_COMPRESSED_VERTICES - 1] = 1;
+    sizes[OBJTOBIN_SECTION_COMPRESSED_INDICES - 1] = 1;
+    ObjToBinSection sections[PACK_SECTION_TYPES];
+    LayoutPack(&header, sections, sizes);
+
+    size_t maxStream = 0;
+    for (unsigned int m = 0; m < header.MeshCount; ++m) {
+        const Mesh* mesh = ObjToBinGetMesh(pack, m);
+        size_t indexCount = mesh->IndexCount;
+        for (unsigned int l = 0; l < mesh->LodCount; ++l) indexCount += ObjToBinGetLod(pack, mesh, l)->IndexCount;
+        size_t vertexBytes = (size_t)mesh->VertexCount * header.VertexSize;
+        if (vertexBytes > maxStream) maxStream = vertexBytes;
+        if (indexCount * 6 > maxStream) maxStream = indexCount * 6;
+    }
+    unsigned char* stream = malloc(maxStream + 1);
+    unsigned char* lz = malloc(GetLzBound(maxStream));
+    uint32_t* table = calloc((size_t)1 << LZ_HASH_BITS, sizeof(uint32_t));
+    ObjToBinBlock* blocks = calloc((size_t)header.MeshCount * 2 + 1, sizeof(ObjToBinBlock));
+    bool success = stream && lz && table && blocks;
+    if (!success) ReportError(OBJTOBIN_ERROR_MEMORY, "Error: Failed to allocate required internal memory.");
+
+    // Sections carried over as they are, header and section table placeholders first
+    uint64_t position = 0;
+    success = success && WritePackHead(writer, &header, sections, (const Mesh*)pack->Meshes, &position);
+    for (unsigned int s = 0; success && s < PACK_SECTION_TYPES; ++s) {
+        uint32_t type = kSectionOrder[s];
+        const ObjToBinSection* section = IsExtraSection(type) ? ObjToBinFindSection(pack, type) : NULL;
+        if (section) success = WritePackSection(writer, &header, sections, type, pack->Data + section->Offset, &position);
+    }
+
+    ObjToBinBlock* vertexBlocks = blocks;
+    ObjToBinBlock* indexBlocks = blocks + header.MeshCount;
+    uint64_t vertexSectionSize = 0;
+    success = success && BeginCompressedSection(writer, &position, &vertexSectionSize, header.MeshCount);
+    for (unsigned int m = 0; success && m < header.MeshCount; ++m) {
+        // Meshes sharing the vertices of the mesh before have an empty block
+        const Mesh* mesh = ObjToBinGetMesh(pack, m);
+        size_t bytes = ObjToBinSharesVertices(pack, m) ? 0 : (size_t)mesh->VertexCount * header.VertexSize;
+        if (bytes > 0) EncodeVertexBlock(stream, ObjToBinGetVertices(pack, mesh), mesh->VertexCount, &header);
+        success = WriteBlock(writer, &vertexBlocks[m], stream, bytes, lz, table, &vertexSectionSize);
+    }
+    position += vertexSectionSize;
+    uint64_t indexSectionSize = 0;
+    success = success && BeginCompressedSection(writer, &position, &indexSectionSize, header.MeshCount);
+    for (unsigned int m = 0; success && m < header.MeshCount; ++m) {
+        const Mesh* mesh = ObjToBinGetMesh(pack, m);
+        unsigned char* end = EncodeIndices(stream, ObjToBinGetIndices(pack, mesh), mesh->IndexCount, mesh->IndexSize);
+        for (unsigned int l = 0; l < mesh->LodCount; ++l) {
+            const ObjToBinLod* lod = ObjToBinGetLod(pack, mesh, l);
+            end = EncodeIndices(end, ObjToBinGetLodIndices(pack, lod), lod->IndexCount, mesh->IndexSize);
+        }
+        success = WriteBlock(writer, &indexBlocks[m], stream, (size_t)(end - stream), lz, table, &indexSectionSize);
+    }
+    position += indexSectionSize;
+
+    uint64_t vertexBytes = header.TotalVertices * header.VertexSize;
+    uint64_t indexBytes = pack->IndexBytes;
+    sizes[OBJTOBIN_SECTION_COMPRESSED_VERTICES - 1] = vertexSectionSize;
+    sizes[OBJTOBIN_SECTION_COMPRESSED_INDICES - 1] = indexSectionSize;
+    LayoutPack(&header, sections, sizes);
+    success = success && WriterSeek(writer, 0) && WriterWrite(writer, &header, sizeof(Header)) &&
+              WriterWrite(writer, sections, header.SectionCount * sizeof(ObjToBinSection)) &&
+              WriteBlockTable(writer, FindPackSection(&header, sections, OBJTOBIN_SECTION_COMPRESSED_VERTICES), vertexBytes, vertexBlocks, header.MeshCount) &&
+              WriteBlockTable(writer, FindPackSection(&header, sections, OBJTOBIN_SECTION_COMPRESSED_INDICES), indexBytes, indexBlocks, header.MeshCount);
+    if (success && options->Flags & OBJTOBIN_FLAG_VERBOSE) {
+        Report("Compressed vertices %llu -> %llu bytes, indices %llu -> %llu bytes.\n", (unsigned long long)vertexBytes,
+               (unsigned long long)vertexSectionSize, (unsigned long long)indexBytes, (unsigned long long)indexSectionSize);
+    }
+    *size = position;
+    free(stream);
+    free(lz);
+    free(table);
+    free(blocks);
+    return success;
+}
+
+// Rewrites the raw pack at binName compressed, sets size to the size of the new pack
+static bool CompressPack(const char* binName, const Options* options, uint64_t* size) {
+    ObjToBinPack pack;
+    int result = ObjToBinOpen(&pack, binName);
+    if (result != OBJTOBIN_OK) {
+        ReportError(result, "Error: Failed to read %s to compress it, %s! Aborting.\n", binName, ObjToBinResultString(result));
+        return false;
+    }
+    char* tempName = malloc(strlen(binName) + sizeof(".z.tmp"));
+    FILE* file = NULL;
+    if (tempName) {
+        strcpy(tempName, binName);
+        strcat(tempName, ".z.tmp");
+        file = fopen(tempName, "wb");
+    }
+    bool success = file != NULL;
+    if (!tempName) ReportError(OBJTOBIN_ERROR_MEMORY, "Error: Failed to allocate required internal memory.");
+    else if (!file) ReportError(OBJTOBIN_ERROR_OPEN, "Error: Failed to open %s! Aborting.\n", tempName);
+    Writer writer = FileWriter(file);
+    success = success && WriteCompressedPack(&writer, &pack, options, size);
+    if (file && fclose(file) != 0) success = false;
+    ObjToBinClose(&pack);
+    // The raw pack is replaced rather than written over, it may be a hard link in to a cache
+    if (success) success = remove(binName) == 0 && rename(tempName, binName) == 0;
+    if (!success) {
+        ReportError(OBJTOBIN_ERROR_WRITE, "Error: Failed to write the compressed pack! Aborting.\n");
+        if (file) remove(tempName);
+    }
+    free(tempName);
+    return success;
+}
+
+// Picks the working vertex from the file's components and allocates the weld state for meshes of up to
+// maxIndexCount indices. Each new attribute triple of a mesh is a candidate vertex, gathered from the planes
+// in batches then welded in order.
+static bool BeginConvert(ConvertContext* context, Buffers* buffers, size_t maxIndexCount, ConvertStats* stats) {
+    if (buffers->Options->Flags & OBJTOBIN_FLAG_GENERATE_TANGENTS) {
+        if ((buffers->Header.Components & (OBJTOBIN_VERTEX_TEXCOORDS | OBJTOBIN_VERTEX_NORMALS)) == (OBJTOBIN_VERTEX_TEXCOORDS | OBJTOBIN_VERTEX_NORMALS)) {
+            buffers->Header.Components |= OBJTOBIN_VERTEX_TANGENTS;
+        }
+        else Report("Warning: Tangents need texcoords and normals, skipping tangent generation.\n");
+    }
+    buffers->VertexFloats = 3; // Assume position
+    buffers->VertexFloats += buffers->Header.Components & OBJTOBIN_VERTEX_TEXCOORDS ? 2 : 0;
+    buffers->VertexFloats += buffers->Header.Components & OBJTOBIN_VERTEX_NORMALS   ? 3 : 0;
+    buffers->VertexFloats += buffers->Header.Components & OBJTOBIN_VERTEX_TANGENTS  ? 4 : 0;
+
+    memset(context, 0, sizeof(ConvertContext));
+    context->Stats = stats;
+    context->Batch = ArenaAlloc(buffers->Arena, sizeof(WeldBatch));
+    context->CandidatePos = ArenaAlloc(buffers->Arena, maxIndexCount * sizeof(unsigned int));
+    context->CandidateTex = ArenaAlloc(buffers->Arena, maxIndexCount * sizeof(unsigned int));
+    context->CandidateNorm = ArenaAlloc(buffers->Arena, maxIndexCount * sizeof(unsigned int));
+    context->CandidateVertex = ArenaAlloc(buffers->Arena, maxIndexCount * sizeof(unsigned int));
+    if (!WelderAllocate(&buffers->Welder, buffers->Arena, maxIndexCount) || !context->Batch || !context->CandidatePos ||
+        !context->CandidateTex || !context->CandidateNorm || !context->CandidateVertex) {
+        ReportError(OBJTOBIN_ERROR_MEMORY, "Error: Failed to allocate vertex welding tables! Aborting.");
+        return false;
+    }
+
+    WeldSources* sources = &context->Sources;
+    sources->FlipPlane = -1;
+    for (unsigned int k = 0; k < 3; ++k) {
+        sources->Planes[sources->Floats] = buffers->Positions[k];
+        sources->Indices[sources->Floats++] = context->CandidatePos;
+    }
+    if (buffers->Header.Components & OBJTOBIN_VERTEX_TEXCOORDS) {
+        for (unsigned int k = 0; k < 2; ++k) {
+            sources->Planes[sources->Floats] = buffers->Texcoords[k];
+            sources->Indices[sources->Floats++] = context->CandidateTex;
+        }
+        if (buffers->Options->Flags & OBJTOBIN_FLAG_FLIP_TEXCOORD_V) sources->FlipPlane = (int)sources->Floats - 1;
+    }
+    if (buffers->Header.Components & OBJTOBIN_VERTEX_NORMALS) {
+        for (unsigned int k = 0; k < 3; ++k) {
+            sources->Planes[sources->Floats] = buffers->Normals[k];
+            sources->Indices[sources->Floats++] = context->CandidateNorm;
+        }
+    }
+    sources->Floats = buffers->VertexFloats; // Tangents start as zero and are filled in after welding
+    sources->PaddedFloats = (sources->Floats + 3) & ~3u;
+
+    SelectWeldKernels(&context->Kernels);
+#ifdef SIMD_AVX2
+    // Gather instructions take signed 32-bit indices
+    if (buffers->PositionCount > INT32_MAX || buffers->TexcoordCount > INT32_MAX || buffers->NormalCount > INT32_MAX) {
+        context->Kernels.Gather = GatherSse2;
+    }
+#endif
+    if (buffers->Options->Flags & OBJTOBIN_FLAG_VERBOSE) Report("Welding with %s kernels\n", context->Kernels.Name);
+    return true;
+}
+
+// Welds mesh m in to vertices from its VertexOffset on
+static void WeldMesh(ConvertContext* context, Buffers* buffers, unsigned int m) {
+    double start = GetTimeSeconds();
+    const WeldSources* sources = &context->Sources;
+    WeldBatch* batch = context->Batch;
+    Mesh* mesh = &buffers->Meshes[m];
+    mesh->VertexCount = 0;
+    WelderReset(&buffers->Welder, mesh->IndexCount, (unsigned int)mesh->VertexOffset);
+    // Identical attribute indices always produce the same vertex, so only the first sighting is a candidate
+    size_t candidateCount = 0;
+    for (size_t i = mesh->IndexOffset; i < mesh->IndexCount + mesh->IndexOffset; ++i) {
+        unsigned int tex = buffers->Header.Components & OBJTOBIN_VERTEX_TEXCOORDS ? buffers->TexIndices[i] : 0;
+        unsigned int norm = buffers->Header.Components & OBJTOBIN_VERTEX_NORMALS ? buffers->NormIndices[i] : 0;
+        IndexTriple* triple = WelderFindTriple(&buffers->Welder, buffers->PosIndices[i], tex, norm);
+        if (triple->Vertex == WELD_EMPTY) {
+            triple->Pos = buffers->PosIndices[i];
+            triple->Tex = tex;
+            triple->Norm = norm;
+            triple->Vertex = (unsigned int)candidateCount;
+            context->CandidatePos[candidateCount] = buffers->PosIndices[i];
+            context->CandidateTex[candidateCount] = tex;
+            context->CandidateNorm[candidateCount++] = norm;
+        }
+        buffers->Indices[i] = triple->Vertex;
+    }
+
+    for (size_t first = 0; first < candidateCount; first += WELD_BATCH) {
+        size_t count = candidateCount - first < WELD_BATCH ? candidateCount - first : WELD_BATCH;
+        context->Kernels.Gather(batch, sources, first, count);
+        context->Kernels.Keys(batch, sources->Floats, count);
+        context->Kernels.Interleave(batch, sources->PaddedFloats, count);
+        for (size_t k = 0; k < count; ++k) {
+            const float* vertex = &batch->Rows[k * sources->PaddedFloats];
+            unsigned int dupIdx = batch->Scalar[k] ? WelderFindVertex(&buffers->Welder, buffers->Vertices, vertex, sources->Floats) :
+                                                     WelderFindBatchVertex(&buffers->Welder, buffers->Vertices, batch, k, sources->Floats, sources->PaddedFloats);
+            if (dupIdx == WELD_EMPTY) {
+                dupIdx = (unsigned int)mesh->VertexOffset + mesh->VertexCount++;
+                memcpy(&buffers->Vertices[(size_t)dupIdx * sources->Floats], vertex, sources->Floats * sizeof(float));
+                if (batch->Scalar[k]) WelderInsertVertex(&buffers->Welder, vertex, sources->Floats, dupIdx);
+                else WelderInsertBatchVertex(&buffers->Welder, batch, k, sources->Floats, dupIdx);
+            }
+            context->CandidateVertex[first + k] = dupIdx;
+        }
+    }
+    for (size_t i = mesh->IndexOffset; i < mesh->IndexCount + mesh->IndexOffset; ++i) {
+        buffers->Indices[i] = context->CandidateVertex[buffers->Indices[i]];
+    }
+    context->Stats->Weld += GetTimeSeconds() - start;
+}
+
+// Strips the triangles of welded mesh m that add nothing, keeping the rest in order. Triangles that use a vertex
+// twice or have less area than the MinArea option are dropped, as are repeats of an earlier triangle with the same
+// winding from any corner. The reverse winding faces the other way so it is kept.
+static void StripTriangles(Buffers* buffers, unsigned int m, StripCounts* counts) {
+    Mesh* mesh = &buffers->Meshes[m];
+    unsigned int* indices = &buffers->Indices[mesh->IndexOffset];
+    size_t vertexFloats = buffers->VertexFloats;
+    float minArea = buffers->Options->MinArea;
+    // The triple table is free once the mesh is welded, each kept triangle is a triple of vertices
+    WelderReset(&buffers->Welder, mesh->IndexCount, (unsigned int)mesh->VertexOffset);
+    size_t kept = 0;
+    for (size_t i = 0; i < mesh->IndexCount; i += 3) {
+        unsigned int a = indices[i], b = indices[i + 1], c = indices[i + 2];
+        if (a == b || b == c || c == a) {
+            counts->Degenerate++;
+            continue;
+        }
+        if (minArea > 0.0f) {
+            const float* pa = &buffers->Vertices[(size_t)a * vertexFloats];
+            const float* pb = &buffers->Vertices[(size_t)b * vertexFloats];
+            const float* pc = &buffers->Vertices[(size_t)c * vertexFloats];
+            float e1[3] = { pb[0] - pa[0], pb[1] - pa[1], pb[2] - pa[2] };
+            float e2[3] = { pc[0] - pa[0], pc[1] - pa[1], pc[2] - pa[2] };
+            float n[3] = { e1[1] * e2[2] - e1[2] * e2[1], e1[2] * e2[0] - e1[0] * e2[2], e1[0] * e2[1] - e1[1] * e2[0] };
+            if (0.5f * sqrtf(n[0] * n[0] + n[1] * n[1] + n[2] * n[2]) < minArea) {
+                counts->Small++;
+                continue;
+            }
+        }
+        // Starting from the lowest vertex gives every rotation of a winding the same key
+        unsigned int k0 = a, k1 = b, k2 = c;
+        if (b < a && b < c) { k0 = b; k1 = c; k2 = a; }
+        else if (c < a && c < b) { k0 = c; k1 = a; k2 = b; }
+        IndexTriple* triple = WelderFindTriple(&buffers->Welder, k0, k1, k2);
+        if (triple->Vertex != WELD_EMPTY) {
+            counts->Duplicate++;
+            continue;
+        }
+        triple->Pos = k0;
+        triple->Tex = k1;
+        triple->Norm = k2;
+        triple->Vertex = (unsigned int)(kept / 3);
+        indices[kept++] = a;
+        indices[kept++] = b;
+        indices[kept++] = c;
+    }
+    mesh->IndexCount = (uint32_t)kept;
+}
+
+// Drops the vertices of mesh m that none of its indices use, keeping the rest in order. Returns how many were dropped.
+static unsigned int CompactVertices(ConvertContext* context, Buffers* buffers, unsigned int m) {
+    Mesh* mesh = &buffers->Meshes[m];
+    unsigned int* indices = &buffers->Indices[mesh->IndexOffset];
+    unsigned int* remap = context->CandidateVertex; // A mesh never has more vertices than candidates
+    unsigned int base = (unsigned int)mesh->VertexOffset;
+    size_t vertexFloats = buffers->VertexFloats;
+    memset(remap, 0xFF, (size_t)mesh->VertexCount * sizeof(unsigned int));
+    for (size_t i = 0; i < mesh->IndexCount; ++i) remap[indices[i] - base] = 0;
+    unsigned int count = 0;
+    for (unsigned int v = 0; v < mesh->VertexCount; ++v) {
+        if (remap[v] == WELD_EMPTY) continue;
+        if (count != v) {
+            memcpy(&buffers->Vertices[(size_t)(base + count) * vertexFloats], &buffers->Vertices[(size_t)(base + v) * vertexFloats], vertexFloats * sizeof(float));
+        }
+        remap[v] = count++;
+    }
+    for (size_t i = 0; i < mesh->IndexCount; ++i) indices[i] = base + remap[indices[i] - base];
+    unsigned int unused = mesh->VertexCount - count;
+    mesh->VertexCount = count;
+    return unused;
+}
+
+// Strips the triangles of welded mesh m then the vertices they leave unused. id is only used to report on the mesh.
+static void StripMesh(ConvertContext* context, Buffers* buffers, unsigned int m, unsigned int id) {
+    double start = GetTimeSeconds();
+    StripCounts counts = { 0, 0, 0 };
+    StripTriangles(buffers, m, &counts);
+    unsigned int unused = CompactVertices(context, buffers, m);
+    context->Stats->StrippedTriangles += counts.Duplicate + counts.Degenerate + counts.Small;
+    context->Stats->Weld += GetTimeSeconds() - start;
+    if (buffers->Options->Flags & OBJTOBIN_FLAG_VERBOSE) {
+        Report("%s mesh %u: stripped %u duplicate, %u degenerate and %u small triangles, %u unused vertices\n", buffers->Name, id,
+               counts.Duplicate, counts.Degenerate, counts.Small, unused);
+    }
+}
+
+// Closes the gaps stripping left between the index ranges of the first count meshes, which follow each other in order
+static void CompactIndexRanges(Buffers* buffers, unsigned int count) {
+    size_t offset = count > 0 ? buffers->Meshes[0].IndexOffset : 0;
+    for (unsigned int m = 0; m < count; ++m) {
+        Mesh* mesh = &buffers->Meshes[m];
+        if (mesh->IndexOffset != offset) memmove(&buffers->Indices[offset], &buffers->Indices[mesh->IndexOffset], mesh->IndexCount * sizeof(unsigned int));
+        mesh->IndexOffset = offset;
+        offset += mesh->IndexCount;
+    }
+}
+
+// Generates the tangents of welded mesh m, optimizes it, builds its levels of detail and meshlets and computes its
+// bounds and BVH, for those of passes the flags ask for. id is only used to report on the mesh.
+static bool FinishMesh(ConvertContext* context, Buffers* buffers, unsigned int m, unsigned int id, unsigned int passes) {
+    double start = GetTimeSeconds();
+    if (passes & PASS_TANGENTS && buffers->Header.Components & OBJTOBIN_VERTEX_TANGENTS && !GenerateTangents(buffers, m)) {
+        ReportError(OBJTOBIN_ERROR_MEMORY, "Error: Failed to allocate tangent generation memory! Aborting.");
+        return false;
+    }
+    double tangents = GetTimeSeconds();
+    context->Stats->Tangents += tangents - start;
+    if (passes & PASS_OPTIMIZE && buffers->Options->Flags & OBJTOBIN_FLAG_OPTIMIZE && !OptimizeMesh(buffers, m, id, passes & PASS_FETCH)) {
+        ReportError(OBJTOBIN_ERROR_MEMORY, "Error: Failed to allocate mesh optimization memory! Aborting.");
+        return false;
+    }
+    double optimized = GetTimeSeconds();
+    context->Stats->Optimize += optimized - tangents;
+    if (passes & PASS_SIMPLIFY && buffers->Options->LodLevels > 0 && !SimplifyMesh(buffers, m, id)) {
+        ReportError(OBJTOBIN_ERROR_MEMORY, "Error: Failed to allocate level of detail memory! Aborting.");
+        return false;
+    }
+    double simplified = GetTimeSeconds();
+    context->Stats->Simplify += simplified - optimized;
+    if (passes & PASS_MESHLETS && buffers->Options->Flags & OBJTOBIN_FLAG_MESHLETS && !BuildMeshlets(buffers, m)) {
+        ReportError(OBJTOBIN_ERROR_MEMORY, "Error: Failed to allocate meshlet memory! Aborting.");
+        return false;
+    }
+    double meshlets = GetTimeSeconds();
+    context->Stats->Meshlets += meshlets - simplified;
+    if (passes & PASS_BOUNDS) {
+        Mesh* mesh = &buffers->Meshes[m];
+        ComputeBounds(mesh, buffers->Vertices, buffers->VertexFloats, &buffers->Indices[mesh->IndexOffset], mesh->IndexCount);
+        if (buffers->Options->Flags & OBJTOBIN_FLAG_BVH && !BuildBvh(buffers, m)) {
+            ReportError(OBJTOBIN_ERROR_MEMORY, "Error: Failed to allocate BVH memory! Aborting.");
+            return false;
+        }
+    }
+    context->Stats->Bounds += GetTimeSeconds() - meshlets;
+    return true;
+}
+
+// Welds mesh m in to vertices following the previous mesh's, strips it then runs every pass on it. Stripping leaves
+// a gap after its index range which CompactIndexRanges closes. id is only used to report on the mesh.
+static bool ConvertMesh(ConvertContext* context, Buffers* buffers, unsigned int m, unsigned int id) {
+    Mesh* mesh = &buffers->Meshes[m];
+    mesh->VertexOffset = m > 0 ? buffers->Meshes[m - 1].VertexOffset + buffers->Meshes[m - 1].VertexCount : 0;
+    WeldMesh(context, buffers, m);
+    StripMesh(context, buffers, m, id);
+    return FinishMesh(context, buffers, m, id, PASS_ALL);
+}
+
+// Gathers the vertices mesh m uses in to the view and rewrites its indices to them, so the per mesh passes only
+// touch those vertices rather than the whole shared buffer
+static void BeginSharedView(SharedView* view, Buffers* buffers, unsigned int m) {
+    const Mesh* mesh = &buffers->Meshes[m];
+    unsigned int* indices = &buffers->Indices[mesh->IndexOffset];
+    size_t vertexFloats = buffers->VertexFloats;
+    unsigned int count = 0;
+    for (size_t i = 0; i < mesh->IndexCount; ++i) {
+        unsigned int v = indices[i];
+        if (view->Remap[v] == WELD_EMPTY) {
+            view->Remap[v] = count;
+            view->Global[count] = v;
+            memcpy(&view->Vertices[(size_t)count * vertexFloats], &buffers->Vertices[(size_t)v * vertexFloats], vertexFloats * sizeof(float));
+            count++;
+        }
+        indices[i] = view->Remap[v];
+    }
+    view->Buffers = *buffers;
+    view->Buffers.Vertices = view->Vertices;
+    view->Buffers.Meshes = &view->Mesh;
+    view->Mesh = *mesh;
+    view->Mesh.VertexOffset = 0;
+    view->Mesh.VertexCount = count;
+}
+
+// Maps the indices of mesh m, and the levels of detail and meshlets the passes added through the view, back to the
+// shared vertices. The mesh record keeps its shared vertex range, and the bounds and BVH the passes gave it.
+static void EndSharedView(SharedView* view, Buffers* buffers, unsigned int m) {
+    Mesh* mesh = &buffers->Meshes[m];
+    const Buffers* local = &view->Buffers;
+    unsigned int* indices = &buffers->Indices[mesh->IndexOffset];
+    for (size_t i = 0; i < mesh->IndexCount; ++i) indices[i] = view->Global[indices[i]];
+    for (size_t i = buffers->LodIndexCount; i < local->LodIndexCount; ++i) buffers->LodIndices[i] = view->Global[buffers->LodIndices[i]];
+    for (size_t c = buffers->MeshletCount; c < local->MeshletCount; ++c) {
+        const ObjToBinMeshlet* meshlet = &buffers->Meshlets[c];
+        unsigned char* vertices = &buffers->MeshletData[meshlet->DataOffset];
+        for (unsigned int i = 0; i < meshlet->VertexCount; ++i) {
+            unsigned int v;
+            memcpy(&v, &vertices[i * sizeof(unsigned int)], sizeof(v));
+            v = view->Global[v];
+            memcpy(&vertices[i * sizeof(unsigned int)], &v, sizeof(v));
+        }
+    }
+    for (unsigned int v = 0; v < view->Mesh.VertexCount; ++v) view->Remap[view->Global[v]] = WELD_EMPTY;
+    buffers->LodIndexCount = local->LodIndexCount;
+    buffers->LodCount = local->LodCount;
+    buffers->MeshletCount = local->MeshletCount;
+    buffers->MeshletDataBytes = local->MeshletDataBytes;
+    buffers->BvhBytes = local->BvhBytes;
+    uint64_t vertexOffset = mesh->VertexOffset;
+    uint32_t vertexCount = mesh->VertexCount;
+    *mesh = view->Mesh;
+    mesh->VertexOffset = vertexOffset;
+    mesh->VertexCount = vertexCount;
+}
+
+// Converts every mesh of the file in to one shared vertex buffer with OBJTOBIN_FLAG_SHARED_VERTICES. The spare record after
+// the last mesh covers every index while welding and generating tangents. Each mesh is then optimized for the
+// vertex cache and overdraw through a view of its own vertices, vertex fetch is optimized once over every mesh so
+// the shared vertices are in the order the meshes first use them, then levels of detail, meshlets, bounds and BVHs
+// are built through views again. Every mesh record covers all of the shared vertices, its indices select its part of them.
+static bool ConvertShared(ConvertContext* context, Buffers* buffers) {
+    unsigned int meshCount = buffers->Header.MeshCount;
+    Mesh* all = &buffers->Meshes[meshCount];
+    memset(all, 0, sizeof(Mesh));
+    size_t maxIndexCount = 0;
+    for (unsigned int m = 0; m < meshCount; ++m) {
+        all->IndexCount += buffers->Meshes[m].IndexCount;
+        if (buffers->Meshes[m].IndexCount > maxIndexCount) maxIndexCount = buffers->Meshes[m].IndexCount;
+    }
+    all->IndexOffset = meshCount > 0 ? buffers->Meshes[0].IndexOffset : 0;
+    WeldMesh(context, buffers, meshCount);
+    // Each mesh is stripped alone, as the same triangle in two meshes draws two materials
+    double start = GetTimeSeconds();
+    for (unsigned int m = 0; m < meshCount; ++m) {
+        StripCounts counts = { 0, 0, 0 };
+        StripTriangles(buffers, m, &counts);
+        context->Stats->StrippedTriangles += counts.Duplicate + counts.Degenerate + counts.Small;
+        if (buffers->Options->Flags & OBJTOBIN_FLAG_VERBOSE) {
+            Report("%s mesh %u: stripped %u duplicate, %u degenerate and %u small triangles\n", buffers->Name, m, counts.Duplicate,
+                   counts.Degenerate, counts.Small);
+        }
+    }
+    CompactIndexRanges(buffers, meshCount);
+    all->IndexCount = 0;
+    for (unsigned int m = 0; m < meshCount; ++m) all->IndexCount += buffers->Meshes[m].IndexCount;
+    unsigned int unused = CompactVertices(context, buffers, meshCount);
+    context->Stats->Weld += GetTimeSeconds() - start;
+    if (buffers->Options->Flags & OBJTOBIN_FLAG_VERBOSE) Report("%s: stripped %u unused shared vertices\n", buffers->Name, unused);
+    if (!FinishMesh(context, buffers, meshCount, meshCount, PASS_TANGENTS)) return false;
+    for (unsigned int m = 0; m < meshCount; ++m) {
+        buffers->Meshes[m].VertexOffset = 0;
+        buffers->Meshes[m].VertexCount = all->VertexCount;
+    }
+
+    ArenaMark mark = ArenaGetMark(buffers->Arena);
+    SharedView view;
+    view.Remap = ArenaAlloc(buffers->Arena, (size_t)all->VertexCount * sizeof(unsigned int));
+    view.Global = ArenaAlloc(buffers->Arena, maxIndexCount * sizeof(unsigned int));
+    view.Vertices = ArenaAlloc(buffers->Arena, maxIndexCount * buffers->VertexFloats * sizeof(float));
+    if ((all->VertexCount > 0 && !view.Remap) || (maxIndexCount > 0 && (!view.Global || !view.Vertices))) {
+        ReportError(OBJTOBIN_ERROR_MEMORY, "Error: Failed to allocate shared vertex memory! Aborting.");
+        ArenaRelease(buffers->Arena, mark);
+        return false;
+    }
+    if (all->VertexCount > 0) memset(view.Remap, 0xFF, (size_t)all->VertexCount * sizeof(unsigned int));
+    bool success = true;
+    if (buffers->Options->Flags & OBJTOBIN_FLAG_OPTIMIZE) {
+        for (unsigned int m = 0; success && m < meshCount; ++m) {
+            BeginSharedView(&view, buffers, m);
+            success = FinishMesh(context, &view.Buffers, 0, m, PASS_OPTIMIZE);
+            EndSharedView(&view, buffers, m);
+        }
+        double start = GetTimeSeconds();
+        ArenaMark fetchMark = ArenaGetMark(buffers->Arena);
+        OptimizeVertexFetch(&buffers->Indices[all->IndexOffset], all->IndexCount, buffers->Vertices, all->VertexCount, buffers->VertexFloats, buffers->Arena);
+        ArenaRelease(buffers->Arena, fetchMark);
+        context->Stats->Optimize += GetTimeSeconds() - start;
+    }
+    for (unsigned int m = 0; success && m < meshCount; ++m) {
+        BeginSharedView(&view, buffers, m);
+        success = FinishMesh(context, &view.Buffers, 0, m, PASS_SIMPLIFY | PASS_MESHLETS | PASS_BOUNDS);
+        EndSharedView(&view, buffers, m);
+    }
+    ArenaRelease(buffers->Arena, mark);
+    buffers->Header.TotalVertices = all->VertexCount;
+    buffers->Header.TotalIndices = all->IndexCount;
+    return success;
+}
+
+// Records what a conversion parsed and welded, once every mesh is converted
+static void SetMeshStats(ConvertStats* stats, const Buffers* buffers) {
+    stats->Lines = buffers->LineCount;
+    stats->Meshes = buffers->Header.MeshCount;
+    stats->Triangles = buffers->Header.TotalIndices / 3;
+    stats->InputVertices = buffers->Header.TotalIndices + stats->StrippedTriangles * 3;
+    stats->UniqueVertices = buffers->Header.TotalVertices;
+}
+
+static bool ConvertData(Writer* writer, Buffers* buffers, ConvertStats* stats) {
+    size_t maxIndexCount = 0;
+    size_t totalIndexCount = 0;
+    for (unsigned int m = 0; m < buffers->Header.MeshCount; ++m) {
+        if (buffers->Meshes[m].IndexCount > maxIndexCount) maxIndexCount = buffers->Meshes[m].IndexCount;
+        totalIndexCount += buffers->Meshes[m].IndexCount;
+    }
+    ConvertContext context;
+    if (buffers->Options->Flags & OBJTOBIN_FLAG_SHARED_VERTICES) {
+        if (!BeginConvert(&context, buffers, totalIndexCount, stats) || !ConvertShared(&context, buffers)) return false;
+    }
+    else {
+        if (!BeginConvert(&context, buffers, maxIndexCount, stats)) return false;
+        for (unsigned int m = 0; m < buffers->Header.MeshCount; ++m) {
+            if (!ConvertMesh(&context, buffers, m, m)) return false;
+            buffers->Header.TotalVertices += buffers->Meshes[m].VertexCount;
+            buffers->Header.TotalIndices += buffers->Meshes[m].IndexCount;
+        }
+        CompactIndexRanges(buffers, buffers->Header.MeshCount);
+    }
+
+    SetMeshStats(stats, buffers);
+    double start = GetTimeSeconds();
+    bool success = WriteBinary(writer, buffers);
+    stats->Write += GetTimeSeconds() - start;
+    return success;
+}
+
+// Counts the records of a file in newline aligned slices, each dropped from memory once counted
+static void CountStreamRecords(const MappedFile* objFile, ObjCounts* counts) {
+    // Both ways of ending meshes are added up, as whether v records end them is only known at the end
+    ObjCounts objects;
+    memset(counts, 0, sizeof(ObjCounts));
+    memset(&objects, 0, sizeof(ObjCounts));
+    const char* end = objFile->Data + objFile->Size;
+    for (const char* start = objFile->Data; start < end;) {
+        const char* split = (size_t)(end - start) > STREAM_RELEASE_BYTES ? start + STREAM_RELEASE_BYTES : end;
+        const char* newline = split < end ? memchr(split, '\n', end - split) : NULL;
+        split = newline ? newline + 1 : end;
+        ObjCounts slice;
+        CountRecords(start, split - start, &slice);
+        ObjCounts objectSlice = slice;
+        AddCounts(counts, &slice, false);
+        AddCounts(&objects, &objectSlice, true);
+        ReleaseMappedRange(objFile, start - objFile->Data, split - objFile->Data);
+        start = split;
+    }
+    if (counts->Groups == 0) *counts = objects;
+}
+
+// Finishes the run of faces at the start of the working buffers as the next mesh of a streamed pack, appending its
+// vertices, indices, meshlet data and BVH to the spill files and its records, with pack wide offsets, to output.
+static bool StreamMesh(ConvertContext* context, Buffers* buffers, StreamOutput* output) {
+    Mesh* mesh = &buffers->Meshes[0];
+    mesh->IndexOffset = 0;
+    buffers->LodIndexCount = 0;
+    buffers->LodCount = 0;
+    buffers->MeshletCount = 0;
+    buffers->MeshletDataBytes = 0;
+    buffers->BvhBytes = 0;
+    if (!ConvertMesh(context, buffers, 0, output->MeshCount)) return false;
+    double start = GetTimeSeconds();
+    size_t meshIndexBytes = PrepareMesh(buffers, mesh, NULL, buffers->Lods, output->IndexBytes);
+    Writer vertexWriter = FileWriter(output->VertexFile);
+    Writer indexWriter = FileWriter(output->IndexFile);
+    if (!WriteMeshVertices(&vertexWriter, buffers, mesh, output->Scratch) ||
+        !WriteMeshIndices(&indexWriter, buffers->Indices, buffers->LodIndices, buffers->Lods, mesh, output->Scratch)) {
+        return false;
+    }
+    if (output->MeshletFile && fwrite(buffers->MeshletData, 1, buffers->MeshletDataBytes, output->MeshletFile) < buffers->MeshletDataBytes) {
+        ReportError(OBJTOBIN_ERROR_WRITE, "Error: Failed to write the meshlets! Aborting.");
+        return false;
+    }
+    if (output->BvhFile && fwrite(buffers->BvhData, 1, buffers->BvhBytes, output->BvhFile) < buffers->BvhBytes) {
+        ReportError(OBJTOBIN_ERROR_WRITE, "Error: Failed to write the BVHs! Aborting.");
+        return false;
+    }
+    Mesh* record = &output->Meshes[output->MeshCount++];
+    *record = *mesh;
+    record->VertexOffset = buffers->Header.TotalVertices;
+    record->LodFirst = (uint32_t)output->LodCount;
+    record->MeshletFirst = (uint32_t)output->MeshletCount;
+    if (mesh->LodCount > 0) memcpy(&output->Lods[output->LodCount], buffers->Lods, mesh->LodCount * sizeof(ObjToBinLod));
+    output->LodCount += mesh->LodCount;
+    for (unsigned int c = 0; c < mesh->MeshletCount; ++c) {
+        ObjToBinMeshlet* meshlet = &output->Meshlets[output->MeshletCount++];
+        *meshlet = buffers->Meshlets[c];
+        meshlet->DataOffset += output->MeshletDataBytes;
+    }
+    output->MeshletDataBytes += buffers->MeshletDataBytes;
+    record->BvhOffset = mesh->BvhNodeCount > 0 ? output->BvhBytes : 0;
+    output->BvhBytes += buffers->BvhBytes;
+    buffers->Header.TotalVertices += mesh->VertexCount;
+    buffers->Header.TotalIndices += mesh->IndexCount;
+    output->IndexBytes += meshIndexBytes;
+    context->Stats->Write += GetTimeSeconds() - start;
+    return true;
+}
+
+// Opens the spill file named binName with ext appended, name must be freed by the caller even on failure
+static FILE* OpenSpillFile(const char* binName, const char* ext, char** name) {
+    *name = malloc(strlen(binName) + strlen(ext) + 1);
+    if (!*name) return NULL;
+    sprintf(*name, "%s%s", binName, ext);
+    return fopen(*name, "w+b");
+}
+
+// Converts an obj in one pass with working memory bounded by the stream budget, however large the file. Obj indices
+// are file wide so the attribute planes are kept whole, but faces are only held for the mesh being read. Each mesh
+// (split in to runs when too large for the budget) is welded and written to spill files next to the output as soon
+// as it ends, then the pack is assembled from the spill files once the offsets are known.
+static bool ConvertStreaming(const MappedFile* objFile, FILE* binFile, const char* binName, Arena* arena, const Options* options, ConvertStats* stats) {
+    size_t budget = (size_t)options->StreamBudget;
+    if (options->Flags & OBJTOBIN_FLAG_SHARED_VERTICES) Report("Warning: Streamed meshes are welded a run at a time, ignoring --shared.\n");
+    double start = GetTimeSeconds();
+    ObjCounts counts;
+    CountStreamRecords(objFile, &counts);
+
+    size_t attributeBytes = (counts.Positions * 3 + counts.Texcoords * 2 + counts.Normals * 3) * sizeof(float);
+    size_t faceBytes = STREAM_FACE_BYTES + (options->LodLevels > 0 ? STREAM_LOD_FACE_BYTES : 0) +
+                       (options->Flags & OBJTOBIN_FLAG_MESHLETS ? STREAM_MESHLET_FACE_BYTES : 0) + (options->Flags & OBJTOBIN_FLAG_BVH ? STREAM_BVH_FACE_BYTES : 0);
+    // A run ends early when the next face does not fit, so it is more than half full when faces are at most half a run
+    size_t minFaces = STREAM_MIN_FACES > counts.LargestFace * 2 ? STREAM_MIN_FACES : counts.LargestFace * 2;
+    if (minFaces > counts.Faces) minFaces = counts.Faces > 0 ? counts.Faces : 1;
+    size_t runFaces = budget > attributeBytes ? (budget - attributeBytes) / faceBytes : 0;
+    if (runFaces < minFaces) {
+        size_t minimum = (attributeBytes + minFaces * faceBytes + (1 << 20) - 1) >> 20;
+        if (attributeBytes >= budget) {
+            Report("Warning: The vertex attributes alone take %zu MB, more than the %zu MB budget. Exceeding it, at least %zu MB is needed.\n",
+                   (attributeBytes + (1 << 20) - 1) >> 20, budget >> 20, minimum);
+        }
+        else Report("Warning: The %zu MB budget is too small, exceeding it. At least %zu MB is needed.\n", budget >> 20, minimum);
+        runFaces = minFaces;
+    }
+    if (runFaces > counts.Faces) runFaces = counts.Faces > 0 ? counts.Faces : 1;
+    size_t maxMeshes = counts.FaceRuns + counts.Faces * 2 / runFaces + 1;
+
+    // The working buffers hold a single run, only the attribute planes are sized for the whole file
+    Buffers buffers;
+    ObjCounts runCounts = counts;
+    runCounts.Faces = runFaces;
+    runCounts.FaceRuns = 0;
+    StreamOutput output;
+    memset(&output, 0, sizeof(StreamOutput));
+    size_t maxMeshlets = GetMaxMeshlets(counts.Faces, maxMeshes);
+    ConvertContext context;
+    if (!AllocateBuffers(&buffers, arena, &runCounts, options) || !(output.Meshes = ArenaAlloc(arena, maxMeshes * sizeof(Mesh))) ||
+        (options->LodLevels > 0 && !(output.Lods = ArenaAlloc(arena, maxMeshes * options->LodLevels * sizeof(ObjToBinLod)))) ||
+        (options->Flags & OBJTOBIN_FLAG_MESHLETS && !(output.Meshlets = ArenaAlloc(arena, maxMeshlets * sizeof(ObjToBinMeshlet))))) {
+        ReportError(OBJTOBIN_ERROR_MEMORY, "Error: Failed to allocate required internal memory.");
+        return false;
+    }
+    buffers.Name = objFile->Name;
+    buffers.PositionCount = counts.Positions;
+    buffers.TexcoordCount = counts.Texcoords;
+    buffers.NormalCount = counts.Normals;
+    buffers.Header.Components = OBJTOBIN_VERTEX_POSITION;
+    if (counts.Texcoords) buffers.Header.Components |= OBJTOBIN_VERTEX_TEXCOORDS;
+    if (counts.Normals) buffers.Header.Components |= OBJTOBIN_VERTEX_NORMALS;
+    if (!BeginConvert(&context, &buffers, runFaces * 3, stats)) return false;
+    SetPackFormats(&buffers.Header, options);
+    // A run has no more vertices than indices
+    size_t scratchSize = runFaces * 3 * (buffers.Header.VertexSize > 4 ? buffers.Header.VertexSize : 4);
+    output.Scratch = ArenaAlloc(arena, scratchSize > COPY_BUFFER_SIZE ? scratchSize : COPY_BUFFER_SIZE);
+    if (!output.Scratch) {
+        ReportError(OBJTOBIN_ERROR_MEMORY, "Error: Failed to allocate required internal memory.");
+        return false;
+    }
+
+    char* vertexName = NULL;
+    char* indexName = NULL;
+    char* meshletName = NULL;
+    char* bvhName = NULL;
+    output.VertexFile = OpenSpillFile(binName, ".vertices.tmp", &vertexName);
+    output.IndexFile = OpenSpillFile(binName, ".indices.tmp", &indexName);
+    if (options->Flags & OBJTOBIN_FLAG_MESHLETS) output.MeshletFile = OpenSpillFile(binName, ".meshlets.tmp", &meshletName);
+    if (options->Flags & OBJTOBIN_FLAG_BVH) output.BvhFile = OpenSpillFile(binName, ".bvh.tmp", &bvhName);
+    bool success = output.VertexFile && output.IndexFile && (output.MeshletFile || !(options->Flags & OBJTOBIN_FLAG_MESHLETS)) &&
+                   (output.BvhFile || !(options->Flags & OBJTOBIN_FLAG_BVH));
+    if (!success) ReportError(OBJTOBIN_ERROR_OPEN, "Error: Failed to open the spill files next to %s.", binName);
+
+    size_t read[3] = { 0, 0, 0 };
+    size_t i = 0;
+    size_t released = 0;
+    bool valid = true;
+    ObjScanner scanner;
+    ScannerInit(&scanner, objFile->Data, objFile->Size);
+    while (success) {
+        bool more = ScannerNextRecord(&scanner);
+        ObjRecord record = more ? ClassifyRecord(&scanner) : RECORD_OTHER;
+        size_t triangles = 0;
+        if (record == RECORD_FACE) {
+            const char* corners = scanner.Cursor;
+            triangles = CountFaceTriangles(&scanner);
+            scanner.Cursor = corners;
+        }
+        // The same meshes as ParseChunkTask, also ended when the run is full
+        if (i > 0 && (!more || (record == RECORD_POSITION && counts.Groups == 0) || record == RECORD_GROUP || i + triangles * 3 > runFaces * 3)) {
+            buffers.Meshes[0].IndexCount = (unsigned int)i;
+            success = StreamMesh(&context, &buffers, &output);
+            i = 0;
+        }
+        if (!more || !success) break;
+        if (record == RECORD_FACE) i += ExtractFace(&buffers, i, read, &scanner, &valid);
+        else if (record == RECORD_POSITION) ExtractFloats(buffers.Positions, 3, read[0]++, &scanner, &valid);
+        else if (record == RECORD_TEXCOORD) ExtractFloats(buffers.Texcoords, 2, read[1]++, &scanner, &valid);
+        else if (record == RECORD_NORMAL) ExtractFloats(buffers.Normals, 3, read[2]++, &scanner, &valid);
+        if (!valid) {
+            ReportInvalidRecord(objFile, scanner.Token);
+            success = false;
+        }
+        size_t parsed = scanner.Token - objFile->Data;
+        if (parsed - released >= STREAM_RELEASE_BYTES) {
+            ReleaseMappedRange(objFile, released, parsed);
+            released = parsed;
+        }
+    }
+    // Runs are converted and written as they are parsed, whatever else the loop did was parsing
+    stats->Parse = GetTimeSeconds() - start - stats->Weld - stats->Tangents - stats->Optimize - stats->Simplify - stats->Meshlets - stats->Bounds -
+                   stats->Write;
+
+    if (success) {
+        double writeStart = GetTimeSeconds();
+        Header* header = &buffers.Header;
+        header->MeshCount = output.MeshCount;
+        SetMeshStats(stats, &buffers);
+        ObjToBinSection sections[PACK_SECTION_TYPES];
+        uint64_t sizes[PACK_SECTION_TYPES] = { 0, 0, output.IndexBytes, output.LodCount * sizeof(ObjToBinLod),
+                                               output.MeshletCount * sizeof(ObjToBinMeshlet), output.MeshletDataBytes, 0, 0, output.BvhBytes };
+        LayoutPack(header, sections, sizes);
+        char* buffer = (char*)output.Scratch;
+        uint64_t written = 0;
+        Writer writer = FileWriter(binFile);
+        success = WritePackHead(&writer, header, sections, output.Meshes, &written) &&
+                  fflush(output.VertexFile) == 0 && CopyFileBlock(binFile, output.VertexFile, 0, sections[1].Size, buffer);
+        written += sections[1].Size;
+        success = success && WritePadding(&writer, &written, sections[2].Offset) &&
+                  fflush(output.IndexFile) == 0 && CopyFileBlock(binFile, output.IndexFile, 0, sections[2].Size, buffer);
+        written += sections[2].Size;
+        success = success && WritePackSection(&writer, header, sections, OBJTOBIN_SECTION_LODS, output.Lods, &written) &&
+                  WritePackSection(&writer, header, sections, OBJTOBIN_SECTION_MESHLETS, output.Meshlets, &written);
+        const ObjToBinSection* meshletData = FindPackSection(header, sections, OBJTOBIN_SECTION_MESHLET_DATA);
+        if (success && meshletData) {
+            success = WritePadding(&writer, &written, meshletData->Offset) && fflush(output.MeshletFile) == 0 &&
+                      CopyFileBlock(binFile, output.MeshletFile, 0, meshletData->Size, buffer);
+            written = meshletData->Offset + meshletData->Size;
+        }
+        const ObjToBinSection* bvh = FindPackSection(header, sections, OBJTOBIN_SECTION_BVH);
+        if (success && bvh) {
+            success = WritePadding(&writer, &written, bvh->Offset) && fflush(output.BvhFile) == 0 &&
+                      CopyFileBlock(binFile, output.BvhFile, 0, bvh->Size, buffer);
+        }
+        if (!success) ReportError(OBJTOBIN_ERROR_WRITE, "Error: Failed to write the binary from the spill files! Aborting.");
+        stats->Write += GetTimeSeconds() - writeStart;
+    }
+    if (success && options->Flags & OBJTOBIN_FLAG_VERBOSE) {
+        Report("Streamed %u meshes, %zu faces per run, %zu MB of working memory\n", output.MeshCount, runFaces, arena->Reserved >> 20);
+    }
+
+    FILE* spillFiles[4] = { output.VertexFile, output.IndexFile, output.MeshletFile, output.BvhFile };
+    char* spillNames[4] = { vertexName, indexName, meshletName, bvhName };
+    for (int f = 0; f < 4; ++f) {
+        if (spillFiles[f]) fclose(spillFiles[f]);
+        if (spillNames[f]) remove(spillNames[f]);
+        free(spillNames[f]);
+    }
+    return success;
+}
+
+static void PrintIndices(const unsigned char* indices, unsigned int count, unsigned int indexSize) {
+    for (unsigned int i = 0; i < count; ++i) {
+        unsigned int index = 0;
+        if (indexSize == 2) {
+            unsigned short index16;
+            memcpy(&index16, &indices[i * 2], sizeof(index16));
+            index = index16;
+        }
+        else memcpy(&index, &indices[i * 4], sizeof(index));
+        printf("%i ", index);
+    }
+    printf("\n");
+}
+
+// Prints every mesh of a pack. The loader maps the pack, so vertices are decoded straight from the file's pages.
+static bool ReadBinary(const char* binName) {
+    ObjToBinPack pack;
+    int result = ObjToBinOpen(&pack, binName);
+    if (result != OBJTOBIN_OK) {
+        printf("Error: Failed to open the binary file for reading, %s.\n", ObjToBinResultString(result));
+        return false;
+    }
+    const Header* header = pack.Header;
+    printf("Mesh count: %u    Version %u    Layout %s\n", header->MeshCount, header->Version, header->Layout == OBJTOBIN_LAYOUT_PLANAR ? "planar" : "interleaved");
+    if (pack.Decoded) {
+        const ObjToBinSection* vertices = ObjToBinFindSection(&pack, OBJTOBIN_SECTION_COMPRESSED_VERTICES);
+        const ObjToBinSection* indices = ObjToBinFindSection(&pack, OBJTOBIN_SECTION_COMPRESSED_INDICES);
+        printf("Compressed vertices %llu -> %llu bytes    Compressed indices %llu -> %llu bytes\n",
+               (unsigned long long)(header->TotalVertices * header->VertexSize), (unsigned long long)(vertices ? vertices->Size : 0),
+               (unsigned long long)pack.IndexBytes, (unsigned long long)(indices ? indices->Size : 0));
+    }
+    for (unsigned int m = 0; m < header->MeshCount; ++m) {
+        const Mesh* mesh = ObjToBinGetMesh(&pack, m);
+        printf("Object %i:    Vertex Count %i    Vertex Size %i    Index Count %i    Index Size %i    Components %i    Formats %x    VIOffset (%llu,%llu)\n",
+            m, mesh->VertexCount, header->VertexSize, mesh->IndexCount, mesh->IndexSize, header->Components, header->Formats,
+            (unsigned long long)mesh->VertexOffset, (unsigned long long)mesh->IndexOffset);
+        // Packs written before bounds have shorter mesh records
+        if (header->MeshRecordSize >= sizeof(Mesh)) {
+            printf("Bounds (%f, %f, %f) (%f, %f, %f)    Sphere (%f, %f, %f) %f\n", mesh->BoundsMin[0], mesh->BoundsMin[1], mesh->BoundsMin[2],
+                   mesh->BoundsMax[0], mesh->BoundsMax[1], mesh->BoundsMax[2], mesh->Center[0], mesh->Center[1], mesh->Center[2], mesh->Radius);
+        }
+        if (header->MeshRecordSize >= sizeof(Mesh) && mesh->BvhNodeCount > 0) {
+            const ObjToBinBvhNode* root = ObjToBinGetBvhNodes(&pack, mesh);
+            printf("BVH:    Node Count %u    Depth %u    Root (%f, %f, %f) (%f, %f, %f)    BOffset %llu\n", mesh->BvhNodeCount, mesh->BvhDepth,
+                   root->Min[0], root->Min[1], root->Min[2], root->Max[0], root->Max[1], root->Max[2], (unsigned long long)mesh->BvhOffset);
+        }
+        const unsigned char* vertices = ObjToBinGetVertices(&pack, mesh);
+        bool shared = ObjToBinSharesVertices(&pack, m);
+        if (shared) printf("Shares the vertices of object %u\n", m - 1);
+        for (unsigned int i = 0; !shared && i < mesh->VertexCount; ++i) {
+            float vertex[16];
+            DecodeVertex(vertex, vertices, i, header, mesh);
+            unsigned int j = 0;
+            printf("Vertex %i v(%f, %f, %f) ", i, vertex[j], vertex[j + 1], vertex[j + 2]);
+            j += 3;
+            if (header->Components & OBJTOBIN_VERTEX_TEXCOORDS) {
+                printf("vt(%f, %f) ", vertex[j], vertex[j + 1]);
+                j += 2;
+            }
+            if (header->Components & OBJTOBIN_VERTEX_NORMALS) {
+                printf("vn(%f, %f, %f)", vertex[j], vertex[j + 1], vertex[j + 2]);
+                j += 3;
+            }
+            if (header->Components & OBJTOBIN_VERTEX_TANGENTS) {
+                printf("tn(%f, %f, %f, %f)", vertex[j], vertex[j + 1], vertex[j + 2], vertex[j + 3]);
+            }
+            printf("\n");
+        }
+        printf("Indices\n");
+        PrintIndices(ObjToBinGetIndices(&pack, mesh), mesh->IndexCount, mesh->IndexSize);
+        for (unsigned int l = 0; l < mesh->LodCount; ++l) {
+            const ObjToBinLod* lod = ObjToBinGetLod(&pack, mesh, l);
+            printf("LOD %u:    Index Count %u    Error %g    IOffset %llu\n", l, lod->IndexCount, lod->Error, (unsigned long long)lod->IndexOffset);
+            PrintIndices(ObjToBinGetLodIndices(&pack, lod), lod->IndexCount, mesh->IndexSize);
+        }
+        for (unsigned int c = 0; c < mesh->MeshletCount; ++c) {
+            const ObjToBinMeshlet* meshlet = ObjToBinGetMeshlet(&pack, mesh, c);
+            printf("Meshlet %u:    Vertex Count %u    Triangle Count %u    Sphere (%f, %f, %f) %f    Cone (%f, %f, %f) %f\n", c,
+                   meshlet->VertexCount, meshlet->TriangleCount, meshlet->Center[0], meshlet->Center[1], meshlet->Center[2], meshlet->Radius,
+                   meshlet->ConeAxis[0], meshlet->ConeAxis[1], meshlet->ConeAxis[2], meshlet->ConeCutoff);
+        }
+    }
+    ObjToBinClose(&pack);
+    return true;
+}
+
+// All working memory comes from arena, which is reset rather than freed so it can be reused for the next file.
+// Stage timings are written to stats if it is not NULL.
+static bool Convert(const char* inName, const char* outName, Arena* arena, const Options* options, ConvertStats* stats) {
+    ConvertStats local;
+    if (!stats) stats = &local;
+    memset(stats, 0, sizeof(ConvertStats));
+    double start = GetTimeSeconds();
+    MappedFile objFile;
+    if (!MapFile(&objFile, inName)) {
+        ReportError(OBJTOBIN_ERROR_OPEN, "Error: Failed to open the files.");
+        return false;
+    }
+    remove(outName); // May be a hard link in to a cache, so it is replaced rather than written over
+    FILE* binFile = fopen(outName, "wb");
+    if (!binFile) {
+        UnmapFile(&objFile);
+        ReportError(OBJTOBIN_ERROR_OPEN, "Error: Failed to open the files.");
+        return false;
+    }
+
+    stats->InputBytes = objFile.Size;
+    stats->Open = GetTimeSeconds() - start;
+
+    bool success;
+    if (options->StreamBudget > 0) success = ConvertStreaming(&objFile, binFile, outName, arena, options, stats);
+    else {
+        Buffers buffers;
+        double parseStart = GetTimeSeconds();
+        bool read = ReadObj(&objFile, &buffers, arena, options);
+        stats->Parse = GetTimeSeconds() - parseStart;
+        if (!read) {
+            UnmapFile(&objFile);
+            fclose(binFile);
+            return false;
+        }
+        Writer writer = FileWriter(binFile);
+        success = ConvertData(&writer, &buffers, stats);
+    }
+
+    UnmapFile(&objFile);
+    stats->OutputBytes = FileTell(binFile);
+    stats->PeakMemory = arena->Peak;
+    stats->Allocations = arena->Allocations;
+    stats->HeapBlocks = arena->Blocks;
+    double closeStart = GetTimeSeconds();
+    if (fclose(binFile)) {
+        ReportError(OBJTOBIN_ERROR_WRITE, "Error: Failed to close the files!");
+        success = false;
+    }
+    stats->Write += GetTimeSeconds() - closeStart;
+    double compressStart = GetTimeSeconds();
+    if (success && options->Flags & OBJTOBIN_FLAG_COMPRESS) success = CompressPack(outName, options, &stats->OutputBytes);
+    stats->Compress = GetTimeSeconds() - compressStart;
+    stats->Total = GetTimeSeconds() - start;
+
+    if (success && options->Flags & OBJTOBIN_FLAG_VERBOSE && !g_Reporter.Library) {
+        ReadBinary(outName);
+    }
+
+    return success;
+}
+
+struct ObjToBinConverter {
+    Arena Arena;
+    Writer Packs[2]; // The raw pack then, when compressing, the compressed pack, kept to be grown in to next time
+};
+
+OBJTOBIN_API ObjToBinConverter* ObjToBinCreateConverter(void) {
+    return calloc(1, sizeof(ObjToBinConverter));
+}
+
+OBJTOBIN_API void ObjToBinDestroyConverter(ObjToBinConverter* converter) {
+    if (!converter) return;
+    ArenaFree(&converter->Arena);
+    free(converter->Packs[0].Data);
+    free(converter->Packs[1].Data);
+    free(converter);
+}
+
+// Writes to the caller's memory if it gave any, otherwise to the converter's own
+static Writer* BeginOutput(Writer* owned, const ObjToBinOutput* output, Writer* fixed) {
+    owned->Position = 0;
+    owned->Size = 0;
+    if (!output->Data) return owned;
+    memset(fixed, 0, sizeof(Writer));
+    fixed->Data = output->Data;
+    fixed->Capacity = output->Capacity;
+    fixed->Fixed = true;
+    return fixed;
+}
+
+// Sends the messages of a library conversion to the caller's Log, returning the reporter the thread had before
+static Reporter BeginReporting(const ObjToBinOptions* options) {
+    Reporter previous = g_Reporter;
+    g_Reporter.Library = true;
+    g_Reporter.Log = options->Log;
+    g_Reporter.LogUser = options->LogUser;
+    g_Reporter.Result = OBJTOBIN_OK;
+    return previous;
+}
+
+// Restores the thread's previous reporter and returns the ObjToBinResult of the conversion
+static int EndReporting(Reporter previous, bool success) {
+    int result = success ? OBJTOBIN_OK : g_Reporter.Result != OBJTOBIN_OK ? g_Reporter.Result : OBJTOBIN_ERROR_MEMORY;
+    g_Reporter = previous;
+    return result;
+}
+
+// Converts as Convert does but from and to memory, so nothing is shared with any other converter. With compression
+// the raw pack is kept by the converter and compressed from there.
+static bool ConvertMemory(ObjToBinConverter* converter, const ObjToBinOptions* options, const char* obj, size_t objSize,
+                          ObjToBinOutput* output) {
+    if (options->StreamBudget > 0) Report("Warning: Only files are streamed, converting in memory.\n");
+    MappedFile objFile;
+    memset(&objFile, 0, sizeof(MappedFile));
+    objFile.Name = "Obj in memory";
+    objFile.Data = obj;
+    objFile.Size = objSize;
+    ConvertStats stats;
+    memset(&stats, 0, sizeof(ConvertStats));
+    Buffers buffers;
+    if (!ReadObj(&objFile, &buffers, &converter->Arena, options)) return false;
+
+    bool compress = (options->Flags & OBJTOBIN_FLAG_COMPRESS) != 0;
+    ObjToBinOutput owned = { NULL, 0, 0 };
+    Writer fixed;
+    Writer* writer = BeginOutput(&converter->Packs[0], compress ? &owned : output, &fixed);
+    bool success = ConvertData(writer, &buffers, &stats);
+    if (success && compress) {
+        ObjToBinPack pack;
+        int result = ObjToBinOpenMemory(&pack, writer->Data, writer->Size);
+        if (result != OBJTOBIN_OK) {
+            ReportError(result, "Error: Failed to read the pack to compress it, %s! Aborting.\n", ObjToBinResultString(result));
+            success = false;
+        }
+        else {
+            uint64_t size;
+            writer = BeginOutput(&converter->Packs[1], output, &fixed);
+            success = WriteCompressedPack(writer, &pack, options, &size);
+            ObjToBinClose(&pack);
+        }
+    }
+    if (!success) return false;
+    output->Size = writer->Size;
+    if (writer->Overflow) {
+        ReportError(OBJTOBIN_ERROR_CAPACITY, "Error: The pack needs %zu bytes, more than the %zu given! Aborting.\n", writer->Size, output->Capacity);
+        return false;
+    }
+    output->Data = writer->Data;
+    return true;
+}
+
+OBJTOBIN_API int ObjToBinConvertMemory(ObjToBinConverter* converter, const ObjToBinOptions* options, const char* obj, size_t objSize,
+                                       ObjToBinOutput* output) {
+    Reporter previous = BeginReporting(options);
+    return EndReporting(previous, ConvertMemory(converter, options, obj, objSize, output));
+}
+
+OBJTOBIN_API int ObjToBinConvertFile(ObjToBinConverter* converter, const ObjToBinOptions* options, const char* objName, const char* binName) {
+    Reporter previous = BeginReporting(options);
+    return EndReporting(previous, Convert(objName, binName, &converter->Arena, options, NULL));
+}
+
+#ifndef OBJTOBIN_NO_MAIN
+
+// Fills in the bounds of mesh m of a pack written before mesh records had them, from its decoded positions.
+// mesh is the record copied from the pack, zero filled past the older record.
+static bool ComputePackBounds(const ObjToBinPack* pack, unsigned int m, Mesh* mesh) {
+    float* positions = malloc(((size_t)mesh->VertexCount * 3 + 1) * sizeof(float));
+    unsigned int* indices = malloc(((size_t)mesh->IndexCount + 1) * sizeof(unsigned int));
+    if (!positions || !indices) {
+        free(positions);
+        free(indices);
+        return false;
+    }
+    const unsigned char* vertices = ObjToBinGetVertices(pack, ObjToBinGetMesh(pack, m));
+    for (unsigned int v = 0; v < mesh->VertexCount; ++v) {
+        float vertex[16];
+        DecodeVertex(vertex, vertices, v, pack->Header, mesh);
+        memcpy(&positions[(size_t)v * 3], vertex, 3 * sizeof(float));
+    }
+    const unsigned char* src = ObjToBinGetIndices(pack, ObjToBinGetMesh(pack, m));
+    for (size_t i = 0; i < mesh->IndexCount; ++i) indices[i] = ReadIndex(src, i, mesh->IndexSize);
+    ComputeBounds(mesh, positions, 3, indices, mesh->IndexCount);
+    free(positions);
+    free(indices);
+    return true;
+}
 
-typedef struct Vec3 {
-    float x;
-    float y;
-    float z;
-} Vec3;
+// Merges the source packs in to one pack with a single header, all of the mesh records, then every vertex
+// section followed by every index section, then the LODs, meshlets and BVHs of each. Sources must share the same
+// vertex layout. Indices are mesh relative so both sections, the meshlet data and BVHs are copied untouched, only the
+// offsets of the mesh, LOD and meshlet records are rebased. Compressed sources are copied from their decoded sections,
+// and with OBJTOBIN_FLAG_COMPRESS the merged pack is compressed once written.
+static bool BatchBinaries(const char* outBinName, const char* const* srcNames, int srcCount, const Options* options) {
+    ObjToBinPack* packs = calloc(srcCount, sizeof(ObjToBinPack));
+    char* buffer = malloc(COPY_BUFFER_SIZE);
+    remove(outBinName); // May be a hard link in to a cache, so it is replaced rather than written over
+    FILE* binFile = fopen(outBinName, "wb");
+    Writer writer = FileWriter(binFile);
+    bool success = packs && buffer && binFile;
+    if (!success) printf("Error: Failed to open the output binary or allocate copy buffers.\n");
 
-typedef struct Header {
-    unsigned int MeshCount;
-    unsigned int VertexSize; // Num floats making up a vertex
-    unsigned int IndexSize; // Num bytes making up an index
-    unsigned int Components; // Components making up a vertex
-    unsigned int TotalVertices;
-    unsigned int TotalIndices;
-} Header;
-
-typedef struct Mesh {
-    unsigned int VertexCount; // Number of vertices
-    unsigned int IndexCount; // Number of indices
-    unsigned int VertexOffset; // VertexSize offset in to vertex data
-    unsigned int IndexOffset; // IndexSize offset in to vertex data
-} Mesh;
+    // Pass 1, validate the sources and build the combined header
+    Header batch;
+    memset(&batch, 0, sizeof(Header));
+    uint64_t sizes[PACK_SECTION_TYPES] = { 0 };
+    for (int f = 0; success && f < srcCount; ++f) {
+        int result = ObjToBinOpen(&packs[f], srcNames[f]);
+        const Header* header = packs[f].Header;
+        if (result != OBJTOBIN_OK) {
+            printf("Error: Failed to read %s, %s! Aborting.\n", srcNames[f], ObjToBinResultString(result));
+            success = false;
+        }
+        else if (f > 0 && (header->Components != batch.Components || header->VertexSize != batch.VertexSize || header->Formats != batch.Formats ||
+                           header->Layout != batch.Layout)) {
+            printf("Error: %s has a different vertex layout to %s (components %u, vertex size %u, formats %x, layout %u)! Aborting.\n",
+                   srcNames[f], srcNames[0], header->Components, header->VertexSize, header->Formats, header->Layout);
+            success = false;
+        }
+        else {
+            batch.Components = header->Components;
+            batch.VertexSize = header->VertexSize;
+            batch.Formats = header->Formats;
+            batch.Layout = header->Layout;
+            if (header->IndexSize > batch.IndexSize) batch.IndexSize = header->IndexSize;
+            batch.MeshCount += header->MeshCount;
+            batch.TotalVertices += header->TotalVertices;
+            batch.TotalIndices += header->TotalIndices;
+            sizes[OBJTOBIN_SECTION_INDICES - 1] += packs[f].IndexBytes;
+            for (unsigned int s = 0; s < header->SectionCount; ++s) {
+                const ObjToBinSection* section = &packs[f].Sections[s];
+                if (IsExtraSection(section->Type)) sizes[section->Type - 1] += section->Size;
+            }
+            for (unsigned int s = 0; s < header->SectionCount; ++s) {
+                if (packs[f].Sections[s].Type <= PACK_SECTION_TYPES) continue;
+                printf("Warning: %s has sections batch mode does not know, they are left out.\n", srcNames[f]);
+                break;
+            }
+        }
+    }
+    ObjToBinSection sections[PACK_SECTION_TYPES];
+    LayoutPack(&batch, sections, sizes);
+    uint64_t position = sizeof(Header) + batch.SectionCount * sizeof(ObjToBinSection);
+    if (success && (fwrite(&batch, sizeof(Header), 1, binFile) < 1 ||
+                    fwrite(sections, sizeof(ObjToBinSection), batch.SectionCount, binFile) < batch.SectionCount ||
+                    !WritePadding(&writer, &position, sections[0].Offset))) {
+        printf("Error: Failed to write binary header! Aborting.\n");
+        success = false;
+    }
 
-typedef struct Buffers {
-    size_t PositionCount;
-    size_t TexcoordCount;
-    size_t NormalCount;
+    // Pass 2, rebase and write the mesh records. Newer records with extra fields are cut down to this version's,
+    // older ones are zero filled and given bounds.
+    uint64_t vertexBase = 0;
+    uint64_t indexBase = 0;
+    uint32_t lodBase = 0;
+    uint32_t meshletBase = 0;
+    uint64_t bvhBase = 0;
+    for (int f = 0; success && f < srcCount; ++f) {
+        uint32_t recordSize = packs[f].Header->MeshRecordSize;
+        for (unsigned int m = 0; success && m < packs[f].Header->MeshCount; ++m) {
+            Mesh mesh;
+            memset(&mesh, 0, sizeof(Mesh));
+            memcpy(&mesh, ObjToBinGetMesh(&packs[f], m), recordSize < sizeof(Mesh) ? recordSize : sizeof(Mesh));
+            if (recordSize < sizeof(Mesh) && !ComputePackBounds(&packs[f], m, &mesh)) {
+                printf("Error: Failed to allocate bounds memory! Aborting.\n");
+                success = false;
+                break;
+            }
+            mesh.VertexOffset += vertexBase;
+            mesh.IndexOffset += indexBase;
+            mesh.LodFirst = mesh.LodCount > 0 ? mesh.LodFirst + lodBase : 0;
+            mesh.MeshletFirst = mesh.MeshletCount > 0 ? mesh.MeshletFirst + meshletBase : 0;
+            mesh.BvhOffset = mesh.BvhNodeCount > 0 ? mesh.BvhOffset + bvhBase : 0;
+            success = fwrite(&mesh, sizeof(Mesh), 1, binFile) == 1;
+        }
+        if (!success) printf("Error: Failed to copy the meshes of %s! Aborting.\n", srcNames[f]);
+        vertexBase += packs[f].Header->TotalVertices;
+        indexBase += packs[f].IndexBytes;
+        lodBase += (uint32_t)packs[f].LodCount;
+        meshletBase += (uint32_t)packs[f].MeshletCount;
+        const ObjToBinSection* bvh = ObjToBinFindSection(&packs[f], OBJTOBIN_SECTION_BVH);
+        bvhBase += bvh ? bvh->Size : 0;
+    }
+    position += sections[0].Size;
 
-    Vec3* Positions;
-    Vec2* Texcoords;
-    Vec3* Normals;
+    // Pass 3 and 4, stream the vertex sections then the index sections
+    for (unsigned int s = 1; s < 3; ++s) {
+        success = success && WritePadding(&writer, &position, sections[s].Offset);
+        for (int f = 0; success && f < srcCount; ++f) {
+            uint64_t size = s == 1 ? packs[f].Header->TotalVertices * packs[f].Header->VertexSize : packs[f].IndexBytes;
+            if (packs[f].Decoded) {
+                const unsigned char* data = s == 1 ? packs[f].Vertices : packs[f].Indices;
+                success = fwrite(data, 1, (size_t)size, binFile) == size;
+            }
+            else {
+                const ObjToBinSection* section = ObjToBinFindSection(&packs[f], sections[s].Type);
+                FILE* src = fopen(srcNames[f], "rb");
+                success = src && CopyFileBlock(binFile, src, section->Offset, size, buffer);
+                if (src) fclose(src);
+            }
+            if (!success) printf("Error: Failed to copy the %s of %s! Aborting.\n", s == 1 ? "vertices" : "indices", srcNames[f]);
+            position += size;
+        }
+    }
 
-    unsigned int* PosIndices;
-    unsigned int* TexIndices;
-    unsigned int* NormIndices;
+    // Pass 5 and 6, rebase and write the levels of detail then the meshlets
+    const ObjToBinSection* lods = FindPackSection(&batch, sections, OBJTOBIN_SECTION_LODS);
+    const ObjToBinSection* meshlets = FindPackSection(&batch, sections, OBJTOBIN_SECTION_MESHLETS);
+    success = success && (!lods || WritePadding(&writer, &position, lods->Offset));
+    indexBase = 0;
+    for (int f = 0; success && f < srcCount; ++f) {
+        for (uint64_t l = 0; success && l < packs[f].LodCount; ++l) {
+            ObjToBinLod lod = packs[f].Lods[l];
+            lod.IndexOffset += indexBase;
+            success = fwrite(&lod, sizeof(ObjToBinLod), 1, binFile) == 1;
+        }
+        if (!success) printf("Error: Failed to copy the levels of detail of %s! Aborting.\n", srcNames[f]);
+        indexBase += packs[f].IndexBytes;
+    }
+    position += lods ? lods->Size : 0;
+    success = success && (!meshlets || WritePadding(&writer, &position, meshlets->Offset));
+    uint64_t dataBase = 0;
+    for (int f = 0; success && f < srcCount; ++f) {
+        for (uint64_t c = 0; success && c < packs[f].MeshletCount; ++c) {
+            ObjToBinMeshlet meshlet = packs[f].Meshlets[c];
+            meshlet.DataOffset += dataBase;
+            success = fwrite(&meshlet, sizeof(ObjToBinMeshlet), 1, binFile) == 1;
+        }
+        if (!success) printf("Error: Failed to copy the meshlets of %s! Aborting.\n", srcNames[f]);
+        const ObjToBinSection* data = ObjToBinFindSection(&packs[f], OBJTOBIN_SECTION_MESHLET_DATA);
+        dataBase += data ? data->Size : 0;
+    }
+    position += meshlets ? meshlets->Size : 0;
 
-    Header Header;
-    Mesh* Meshes;
-    float* Vertices;
-    unsigned int* Indices;
-} Buffers;
+    // Pass 7, stream the meshlet data
+    const ObjToBinSection* meshletData = FindPackSection(&batch, sections, OBJTOBIN_SECTION_MESHLET_DATA);
+    success = success && (!meshletData || WritePadding(&writer, &position, meshletData->Offset));
+    for (int f = 0; success && meshletData && f < srcCount; ++f) {
+        const ObjToBinSection* section = ObjToBinFindSection(&packs[f], OBJTOBIN_SECTION_MESHLET_DATA);
+        if (!section) continue;
+        FILE* src = fopen(srcNames[f], "rb");
+        success = src && CopyFileBlock(binFile, src, section->Offset, section->Size, buffer);
+        if (!success) printf("Error: Failed to copy the meshlets of %s! Aborting.\n", srcNames[f]);
+        if (src) fclose(src);
+    }
+    position += meshletData ? meshletData->Size : 0;
 
-Flags g_Flags = 0;
+    // Pass 8, stream the BVHs
+    const ObjToBinSection* bvh = FindPackSection(&batch, sections, OBJTOBIN_SECTION_BVH);
+    success = success && (!bvh || WritePadding(&writer, &position, bvh->Offset));
+    for (int f = 0; success && bvh && f < srcCount; ++f) {
+        const ObjToBinSection* section = ObjToBinFindSection(&packs[f], OBJTOBIN_SECTION_BVH);
+        if (!section) continue;
+        FILE* src = fopen(srcNames[f], "rb");
+        success = src && CopyFileBlock(binFile, src, section->Offset, section->Size, buffer);
+        if (!success) printf("Error: Failed to copy the BVHs of %s! Aborting.\n", srcNames[f]);
+        if (src) fclose(src);
+    }
 
-bool VertexEqual(const float* v0, const float* v1, const size_t vertexSize) {
-    for (size_t i = 0; i < vertexSize; ++i) {
-        if (!FLT_EQUALS(v0[i], v1[i])) return false;
+    if (binFile && fclose(binFile)) {
+        printf("Error: Failed to close the files!\n");
+        success = false;
     }
-    return true;
+    for (int f = 0; packs && f < srcCount; ++f) {
+        if (packs[f].Data) ObjToBinClose(&packs[f]);
+    }
+    free(packs);
+    free(buffer);
+    uint64_t size;
+    if (success && options->Flags & OBJTOBIN_FLAG_COMPRESS) success = CompressPack(outBinName, options, &size);
+    if (success) printf("Batched %i binaries in to %s.\n", srcCount, outBinName);
+    else if (binFile) remove(outBinName);
+    return success;
 }
 
-bool AllocateBuffers(Buffers* buffers) {
-    memset(buffers, 0, sizeof(Buffers));
-    buffers->Positions = malloc(MAX_BUFFER_SIZE * sizeof(Vec3));
-    buffers->Texcoords = malloc(MAX_BUFFER_SIZE * sizeof(Vec2));
-    buffers->Normals = malloc(MAX_BUFFER_SIZE * sizeof(Vec3));
-    buffers->PosIndices = malloc(MAX_BUFFER_SIZE * sizeof(int));
-    buffers->TexIndices = malloc(MAX_BUFFER_SIZE * sizeof(int));
-    buffers->NormIndices = malloc(MAX_BUFFER_SIZE * sizeof(int));
-    buffers->Indices = malloc(MAX_BUFFER_SIZE * sizeof(unsigned int));
-    buffers->Vertices = malloc(MAX_BUFFER_SIZE * sizeof(float) * 12);
-    buffers->Meshes = malloc(30 * sizeof(Mesh));
-    
-    return buffers->Positions && buffers->Texcoords && buffers->Normals && buffers->PosIndices && 
-           buffers->TexIndices && buffers->NormIndices && buffers->Indices && buffers->Vertices && buffers->Meshes;
+static char* CopyString(const char* str, size_t len) {
+    char* copy = malloc(len + 1);
+    if (!copy) return NULL;
+    memcpy(copy, str, len);
+    copy[len] = '\0';
+    return copy;
+}
+
+// Output name for an input without an explicit one, the .obj extension is swapped for .bin
+static char* DefaultOutputName(const char* input) {
+    size_t len = strlen(input);
+    if (len >= 4 && strcmp(&input[len - 4], kInputExt) == 0) len -= 4;
+    char* output = malloc(len + sizeof(kOutputExt));
+    if (!output) return NULL;
+    memcpy(output, input, len);
+    memcpy(output + len, kOutputExt, sizeof(kOutputExt));
+    return output;
 }
 
-void FreeBuffers(Buffers* buffers) {
-    free(buffers->Positions);
-    free(buffers->Texcoords);
-    free(buffers->Normals);
-    free(buffers->PosIndices);
-    free(buffers->TexIndices);
-    free(buffers->NormIndices);
-    free(buffers->Indices);
-    free(buffers->Vertices);
-    free(buffers->Meshes);
+static bool AddBatchJob(BatchJob** jobs, size_t* count, size_t* capacity, char* input, char* output) {
+    if (!input || !output) {
+        free(input);
+        free(output);
+        return false;
+    }
+    if (*count == *capacity) {
+        size_t newCapacity = *capacity ? *capacity * 2 : 64;
+        BatchJob* newJobs = realloc(*jobs, newCapacity * sizeof(BatchJob));
+        if (!newJobs) {
+            free(input);
+            free(output);
+            return false;
+        }
+        *jobs = newJobs;
+        *capacity = newCapacity;
+    }
+    BatchJob* job = &(*jobs)[(*count)++];
+    memset(job, 0, sizeof(BatchJob));
+    job->Input = input;
+    job->Output = output;
+#ifdef _WIN32
+    WIN32_FILE_ATTRIBUTE_DATA attributes;
+    if (GetFileAttributesExA(input, GetFileExInfoStandard, &attributes)) job->Size = ((size_t)attributes.nFileSizeHigh << 32) | attributes.nFileSizeLow;
+#else
+    struct stat st;
+    if (stat(input, &st) == 0) job->Size = (size_t)st.st_size;
+#endif
+    return true;
 }
 
-void ExtractVec2(Vec2* vec, char* line, const char* delim) {
-    char* splitToken = strtok(NULL, delim);
-    vec->x = atof(splitToken);
-    splitToken = strtok(NULL, delim);
-    vec->y = atof(splitToken);
+static bool IsDirectory(const char* path) {
+#ifdef _WIN32
+    DWORD attributes = GetFileAttributesA(path);
+    return attributes != INVALID_FILE_ATTRIBUTES && (attributes & FILE_ATTRIBUTE_DIRECTORY);
+#else
+    struct stat st;
+    return stat(path, &st) == 0 && S_ISDIR(st.st_mode);
+#endif
 }
 
-void ExtractVec3(Vec3* vec, char* line, const char* delim) {
-    char* splitToken = strtok(NULL, delim);
-    vec->x = atof(splitToken);
-    splitToken = strtok(NULL, delim);
-    vec->y = atof(splitToken);
-    splitToken = strtok(NULL, delim);
-    vec->z = atof(splitToken);
+static char* JoinPath(const char* dir, const char* name) {
+    size_t dirLen = strlen(dir);
+    size_t nameLen = strlen(name);
+    char* path = malloc(dirLen + nameLen + 2);
+    if (!path) return NULL;
+    memcpy(path, dir, dirLen);
+    path[dirLen] = '/';
+    memcpy(path + dirLen + 1, name, nameLen + 1);
+    return path;
 }
 
-// Assumes obj has triangulated faces
-void ExtractFace(int* pos, int* uv, int* norm, char* line, const char* delim, unsigned int* components) {
-    for (size_t i = 0; i < 3; ++i) {
-        char* splitToken = strtok(NULL, delim);
-        pos[i] = strtoul(splitToken, NULL, 0) - 1;
-        splitToken = strtok(NULL, delim);
-        if (*components & VERTEX_TEXCOORDS) {
-            uv[i] = strtoul(splitToken, NULL, 0) - 1;
-            if (*components & VERTEX_NORMALS) splitToken = strtok(NULL, delim);
+// Every *.obj directly inside the directory is converted to a .bin next to it
+static bool LoadDirectoryJobs(const char* dir, BatchJob** jobs, size_t* count) {
+    size_t capacity = 0;
+#ifdef _WIN32
+    char* pattern = JoinPath(dir, "*.obj");
+    if (!pattern) return false;
+    WIN32_FIND_DATAA data;
+    HANDLE find = FindFirstFileA(pattern, &data);
+    free(pattern);
+    if (find == INVALID_HANDLE_VALUE) return true;
+    do {
+        if (data.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY) continue;
+        char* input = JoinPath(dir, data.cFileName);
+        if (!AddBatchJob(jobs, count, &capacity, input, input ? DefaultOutputName(input) : NULL)) {
+            FindClose(find);
+            return false;
         }
-        if (*components & VERTEX_NORMALS) {
-            norm[i] = strtoul(splitToken, NULL, 0) - 1;
+    } while (FindNextFileA(find, &data));
+    FindClose(find);
+#else
+    DIR* handle = opendir(dir);
+    if (!handle) return false;
+    struct dirent* entry;
+    while ((entry = readdir(handle))) {
+        size_t len = strlen(entry->d_name);
+        if (len < 4 || strcmp(&entry->d_name[len - 4], kInputExt) != 0) continue;
+        char* input = JoinPath(dir, entry->d_name);
+        if (!AddBatchJob(jobs, count, &capacity, input, input ? DefaultOutputName(input) : NULL)) {
+            closedir(handle);
+            return false;
         }
     }
+    closedir(handle);
+#endif
+    return true;
 }
 
-bool CompareIndicator(const char* indicator, const char* token) {
-    size_t indLen = strlen(indicator);
-    if (strlen(token) != indLen) return false;
-    for (size_t i = 0; i < indLen; ++i) {
-        if (token[i] != indicator[i]) return false;
+// Each line of the manifest is "input.obj [output.bin]", blank lines and lines starting with # are skipped
+static bool LoadManifestJobs(const char* manifest, BatchJob** jobs, size_t* count) {
+    MappedFile file;
+    if (!MapFile(&file, manifest)) return false;
+    size_t capacity = 0;
+    bool success = true;
+    ObjScanner scanner;
+    ScannerInit(&scanner, file.Data, file.Size);
+    while (success && ScannerNextRecord(&scanner)) {
+        if (scanner.TokenLength == 0 || scanner.Token[0] == '#') continue;
+        char* input = CopyString(scanner.Token, scanner.TokenLength);
+        ScannerSkipSpace(&scanner);
+        const char* output = scanner.Cursor;
+        while (scanner.Cursor < scanner.LineEnd && !IsSpace(*scanner.Cursor)) ++scanner.Cursor;
+        success = AddBatchJob(jobs, count, &capacity, input, scanner.Cursor > output ? CopyString(output, scanner.Cursor - output) :
+                                                             (input ? DefaultOutputName(input) : NULL));
+    }
+    UnmapFile(&file);
+    return success;
+}
+
+// Keys a conversion on the content of its input, every option that changes the pack, and the tool version
+static bool HashConversion(const char* inName, const Options* options, uint64_t* key, uint64_t* inputBytes) {
+    MappedFile objFile;
+    if (!MapFile(&objFile, inName)) return false;
+    *inputBytes = objFile.Size;
+    Hasher hasher;
+    HasherInit(&hasher, 0);
+    for (size_t offset = 0; offset < objFile.Size; offset += STREAM_RELEASE_BYTES) {
+        size_t size = objFile.Size - offset < STREAM_RELEASE_BYTES ? objFile.Size - offset : STREAM_RELEASE_BYTES;
+        HasherUpdate(&hasher, objFile.Data + offset, size);
+        ReleaseMappedRange(&objFile, offset, offset + size);
     }
+    UnmapFile(&objFile);
+    // Parsing splits meshes the same way on any number of threads, only the stream budget splits them further
+    uint32_t fields[8] = { OBJTOBIN_VERSION, options->Flags & ~OBJTOBIN_FLAG_VERBOSE, options->PositionFormat, options->TexcoordFormat,
+                           options->NormalFormat, options->TangentFormat, options->LodLevels, 0 };
+    memcpy(&fields[7], &options->MinArea, sizeof(float));
+    uint64_t budget = options->StreamBudget;
+    HasherUpdate(&hasher, kToolVersion, sizeof(kToolVersion));
+    HasherUpdate(&hasher, fields, sizeof(fields));
+    HasherUpdate(&hasher, &budget, sizeof(budget));
+    *key = HasherDigest(&hasher);
     return true;
 }
 
-char* ReadVec2s(FILE** objFile, Vec2* buffer, size_t* count, char* line, const char* indicator) {
-    size_t len;
-    int read;
-    do {
-        ExtractVec2(&buffer[(*count)++], line, kVertexDelim);
-    } while ((read = getline(&line, &len, *objFile)) != GETLINE_ERR && CompareIndicator(indicator, strtok(line, kVertexDelim)));
-    return read == GETLINE_ERR ? NULL : line;
+static bool MakeDirectory(const char* path) {
+#ifdef _WIN32
+    return CreateDirectoryA(path, NULL) || GetLastError() == ERROR_ALREADY_EXISTS;
+#else
+    return mkdir(path, 0777) == 0 || errno == EEXIST;
+#endif
 }
 
-char* ReadVec3s(FILE** objFile, Vec3* buffer, size_t* count, char* line, const char* indicator) {
-    size_t len;
-    int read;
-    do {
-        ExtractVec3(&buffer[(*count)++], line, kVertexDelim);
-    } while ((read = getline(&line, &len, *objFile)) != GETLINE_ERR && CompareIndicator(indicator, strtok(line, kVertexDelim)));
-    return read == GETLINE_ERR ? NULL : line;
+static unsigned long GetProcessIdentifier() {
+#ifdef _WIN32
+    return (unsigned long)GetCurrentProcessId();
+#else
+    return (unsigned long)getpid();
+#endif
 }
 
-bool ReadVertexData(FILE* objFile, Buffers* buffers) {
-    char* line = NULL;
-    size_t len = 0;
-    int read;
-    buffers->Header.Components |= VERTEX_POSITION;
-    while ((read = getline(&line, &len, objFile)) != GETLINE_ERR && !CompareIndicator(kPositionIndicator, strtok(line, kVertexDelim))) { }
-    if (read == GETLINE_ERR) return false;
-    line = ReadVec3s(&objFile, buffers->Positions, &buffers->PositionCount, line, kPositionIndicator);
-    if (!line) return false;
-    
-    if (CompareIndicator(kTexcoordIndicator, line)) {
-        buffers->Header.Components |= VERTEX_TEXCOORDS;
-        line = ReadVec2s(&objFile, buffers->Texcoords, &buffers->TexcoordCount, line, kTexcoordIndicator);
-    }
-    else if (CompareIndicator(kNormalIndicator, line)) {
-        buffers->Header.Components |= VERTEX_NORMALS;
-        line = ReadVec3s(&objFile, buffers->Normals, &buffers->NormalCount, line, kNormalIndicator);
+static bool LinkFile(const char* existing, const char* name) {
+#ifdef _WIN32
+    return CreateHardLinkA(name, existing, NULL) != 0;
+#else
+    return link(existing, name) == 0;
+#endif
+}
+
+static bool CopyWholeFile(const char* dstName, const char* srcName) {
+    FILE* src = fopen(srcName, "rb");
+    FILE* dst = src ? fopen(dstName, "wb") : NULL;
+    char* buffer = malloc(COPY_BUFFER_SIZE);
+    bool success = src && dst && buffer;
+    size_t size;
+    while (success && (size = fread(buffer, 1, COPY_BUFFER_SIZE, src)) > 0) {
+        success = fwrite(buffer, 1, size, dst) == size;
     }
-    else {
-        return true;
+    success = success && !ferror(src);
+    if (src) fclose(src);
+    if (dst && fclose(dst) != 0) success = false;
+    free(buffer);
+    return success;
+}
+
+// Links name to the existing file, copying it if they are on different file systems
+static bool LinkOrCopyFile(const char* existing, const char* name) {
+    return LinkFile(existing, name) || CopyWholeFile(name, existing);
+}
+
+// Records the outcome of a cached conversion. Lines are appended whole so workers can share the manifest.
+static void AppendCacheManifest(const char* status, uint64_t key, const char* inName, const char* outName) {
+    char* manifestName = JoinPath(g_CacheDir, kCacheManifestName);
+    FILE* manifest = manifestName ? fopen(manifestName, "a") : NULL;
+    if (manifest) {
+        fprintf(manifest, "%s %016llx %s %s\n", status, (unsigned long long)key, inName, outName);
+        fclose(manifest);
+    }
+    free(manifestName);
+}
+
+// Converts through the content addressed cache in g_CacheDir. Entries are named by the key of their conversion, a hit
+// is linked to the output without parsing anything and a miss is converted then linked in to the cache. Outputs and
+// entries share their data, which is safe as outputs are always replaced rather than written over.
+static bool ConvertCached(const char* inName, const char* outName, Arena* arena, const Options* options, bool* hit, ConvertStats* stats) {
+    uint64_t key;
+    uint64_t inputBytes;
+    double start = GetTimeSeconds();
+    *hit = false;
+    if (!g_CacheDir || !HashConversion(inName, options, &key, &inputBytes)) return Convert(inName, outName, arena, options, stats);
+
+    char entry[64];
+    sprintf(entry, "%016llx.bin", (unsigned long long)key);
+    char* entryName = JoinPath(g_CacheDir, entry);
+    if (!entryName) {
+        printf("Error: Failed to allocate required internal memory.");
+        return false;
     }
-    if (!line) return false;
-    
-    if (CompareIndicator(kTexcoordIndicator, line)) {
-        buffers->Header.Components |= VERTEX_TEXCOORDS;
-        line = ReadVec2s(&objFile, buffers->Texcoords, &buffers->TexcoordCount, line, kTexcoordIndicator);
+    remove(outName);
+    *hit = LinkOrCopyFile(entryName, outName);
+    if (*hit) {
+        memset(stats, 0, sizeof(ConvertStats));
+        stats->InputBytes = inputBytes;
+        stats->Total = GetTimeSeconds() - start;
     }
-    else if (CompareIndicator(kNormalIndicator, line)) {
-        buffers->Header.Components |= VERTEX_NORMALS;
-        line = ReadVec3s(&objFile, buffers->Normals, &buffers->NormalCount, line, kNormalIndicator);
+    bool success = *hit;
+    if (*hit && options->Flags & OBJTOBIN_FLAG_VERBOSE) ReadBinary(outName);
+    else if (!*hit && (success = Convert(inName, outName, arena, options, stats))) {
+        // Entries are made under a name unique to the process and worker then renamed, so a reader never sees a partial
+        // entry and processes sharing the cache never write to each other's
+        sprintf(entry, "%016llx.%lu.%lld.tmp", (unsigned long long)key, GetProcessIdentifier(), (long long)AtomicFetchAdd(&g_CacheTempCount, 1));
+        char* tempName = JoinPath(g_CacheDir, entry);
+        bool stored = tempName && MakeDirectory(g_CacheDir) && LinkOrCopyFile(outName, tempName) && rename(tempName, entryName) == 0;
+        if (!stored) {
+            if (tempName) remove(tempName);
+            printf("Warning: Failed to store %s in the cache %s.\n", outName, g_CacheDir);
+        }
+        free(tempName);
     }
-    return !line ? false : true;
+    AppendCacheManifest(*hit ? "hit" : success ? "miss" : "failed", key, inName, outName);
+    free(entryName);
+    return success;
 }
 
-bool ReadIndexData(FILE** objFile, Buffers* buffers) {
-    buffers->Meshes[buffers->Header.MeshCount].IndexCount = 0;
-    char* line = NULL;
-    size_t len = 0;
-    size_t i = buffers->Meshes[buffers->Header.MeshCount].IndexOffset;
-    int read;
-    while ((read = getline(&line, &len, *objFile)) != GETLINE_ERR && !CompareIndicator(kIndexIndicator, strtok(line, kVertexDelim))) { }
-    if (read == GETLINE_ERR) return false;
-    
-    char delim[3] = "/ ";
-    do {
-        ExtractFace(&buffers->PosIndices[i], &buffers->TexIndices[i], &buffers->NormIndices[i], line, delim, &buffers->Header.Components);
-        buffers->Meshes[buffers->Header.MeshCount].IndexCount += 3;
-        i += 3;
-    } while ((read = getline(&line, &len, *objFile)) != GETLINE_ERR && CompareIndicator(kIndexIndicator, strtok(line, kVertexDelim)));
-    return read == GETLINE_ERR && getlineErrno != EOF ? false : true;
+static void WriteJsonString(FILE* file, const char* str) {
+    fputc('"', file);
+    for (; *str; ++str) {
+        if (*str == '"' || *str == '\\') fprintf(file, "\\%c", *str);
+        else if ((unsigned char)*str < 0x20) fprintf(file, "\\u%04x", *str);
+        else fputc(*str, file);
+    }
+    fputc('"', file);
 }
 
-bool ConvertData(FILE* binFile, Buffers* buffers) {
-    buffers->Header.VertexSize = 3; // Assume position
-    buffers->Header.VertexSize += buffers->Header.Components & VERTEX_TEXCOORDS ? 2 : 0;
-    buffers->Header.VertexSize += buffers->Header.Components & VERTEX_NORMALS   ? 3 : 0;
-    buffers->Header.VertexSize += buffers->Header.Components & VERTEX_TANGENTS  ? 3 : 0;
-    buffers->Header.IndexSize = sizeof(unsigned int);
+static double GetWeldRatio(const ConvertStats* stats) {
+    return stats->InputVertices > 0 ? (double)stats->UniqueVertices / (double)stats->InputVertices : 0.0;
+}
 
-    buffers->Meshes[0].VertexOffset = 0;
-    for (unsigned int m = 0; m < buffers->Header.MeshCount; ++m) {
-        if (m > 0) buffers->Meshes[m].VertexOffset = buffers->Meshes[m - 1].VertexOffset + buffers->Meshes[m - 1].VertexCount;
-        buffers->Meshes[m].VertexCount = 0;
-        for (unsigned int i = buffers->Meshes[m].IndexOffset; i < buffers->Meshes[m].IndexCount + buffers->Meshes[m].IndexOffset; ++i) {
-            unsigned int j = buffers->Meshes[m].VertexCount * buffers->Header.VertexSize + buffers->Meshes[m].VertexOffset * buffers->Header.VertexSize;
-            float* vertex = &buffers->Vertices[j];
-            float* vptr = vertex;
-
-            memcpy(vptr, &buffers->Positions[buffers->PosIndices[i]], sizeof(Vec3));
-            vptr += 3;
-            if (buffers->Header.Components & VERTEX_TEXCOORDS) {
-                memcpy(vptr, &buffers->Texcoords[buffers->TexIndices[i]], sizeof(Vec2));
-                if (g_Flags & FLAG_FLIP_TEXCOORD_V) vptr[1] = 1.0f - vptr[1];
-                vptr += 2;
-            }
-            if (buffers->Header.Components & VERTEX_NORMALS) {
-                memcpy(vptr, &buffers->Normals[buffers->NormIndices[i]], sizeof(Vec3));
-                vptr += 3;
-            }
-
-            float* duplicate = NULL;
-            unsigned int dupIdx;
-            for (dupIdx = buffers->Meshes[m].VertexOffset; dupIdx < buffers->Meshes[m].VertexCount + buffers->Meshes[m].VertexOffset; ++dupIdx) {
-                if (VertexEqual(vertex, &buffers->Vertices[dupIdx * buffers->Header.VertexSize], buffers->Header.VertexSize)) {
-                    duplicate = &buffers->Vertices[dupIdx * buffers->Header.VertexSize];
-                    break;
-                }
-            }
-            if (duplicate) buffers->Indices[i] = dupIdx;
-            else buffers->Indices[i] = buffers->Meshes[m].VertexOffset + buffers->Meshes[m].VertexCount++;
+// Reports the stats of every job as a table on stdout, or as JSON when g_StatsOutput is a file name. Stage times of
+// files served from the cache are zero apart from the total.
+static bool ReportStats(const BatchJob* jobs, size_t count) {
+    if (strcmp(g_StatsOutput, "table") == 0) {
+        printf("%-24s %8s %9s %9s %9s %9s %6s", "file", "MB", "lines", "tris", "corners", "vertices", "weld");
+        for (int k = 0; k < STAGE_COUNT; ++k) printf(" %9s", kStageNames[k]);
+        printf(" %8s %8s %7s\n", "MB/s", "peak MB", "allocs");
+        for (size_t j = 0; j < count; ++j) {
+            const ConvertStats* stats = &jobs[j].Stats;
+            size_t nameLen = strlen(jobs[j].Input);
+            // Long paths keep their end, which names the file
+            printf("%-24s %8.1f %9llu %9llu %9llu %9llu %6.3f", nameLen > 24 ? jobs[j].Input + nameLen - 24 : jobs[j].Input,
+                   stats->InputBytes / 1e6, (unsigned long long)stats->Lines, (unsigned long long)stats->Triangles,
+                   (unsigned long long)stats->InputVertices, (unsigned long long)stats->UniqueVertices, GetWeldRatio(stats));
+            for (int k = 0; k < STAGE_COUNT; ++k) printf(" %7.1fms", *(const double*)((const char*)stats + kStageOffsets[k]) * 1000.0);
+            printf(" %8.1f %8.1f %7llu%s\n", stats->Total > 0.0 ? stats->InputBytes / 1e6 / stats->Total : 0.0, stats->PeakMemory / 1048576.0,
+                   (unsigned long long)stats->Allocations, jobs[j].Cached ? " (cached)" : jobs[j].Success ? "" : " (failed)");
         }
-        buffers->Header.TotalVertices += buffers->Meshes[m].VertexCount;
-        buffers->Header.TotalIndices += buffers->Meshes[m].IndexCount;
+        printf("Process peak resident memory %.1f MB\n", GetPeakResidentBytes() / 1048576.0);
+        return true;
     }
 
-    // TODO strip duplicate faces
-
-    if (fwrite(&buffers->Header, sizeof(Header), 1, binFile) < 1) {
-        printf("Error: Failed to write binary header! Aborting.");
+    FILE* file = fopen(g_StatsOutput, "w");
+    if (!file) {
+        printf("Error: Failed to open %s for the stats.\n", g_StatsOutput);
         return false;
     }
-    if (fwrite(buffers->Meshes, sizeof(Mesh), buffers->Header.MeshCount, binFile) < buffers->Header.MeshCount) {
-        printf("Error: Failed to write binary mesh! Aborting.");
-        return false;
+    fprintf(file, "{\n  \"version\": \"%s\",\n  \"process_peak_resident_bytes\": %llu,\n  \"files\": [",
+            kToolVersion, (unsigned long long)GetPeakResidentBytes());
+    for (size_t j = 0; j < count; ++j) {
+        const ConvertStats* stats = &jobs[j].Stats;
+        fprintf(file, "%s\n    { \"input\": ", j > 0 ? "," : "");
+        WriteJsonString(file, jobs[j].Input);
+        fprintf(file, ", \"output\": ");
+        WriteJsonString(file, jobs[j].Output);
+        fprintf(file, ", \"success\": %s, \"cached\": %s, \"input_bytes\": %llu, \"output_bytes\": %llu, \"lines\": %llu, \"meshes\": %llu, "
+                      "\"triangles\": %llu, \"input_vertices\": %llu, \"unique_vertices\": %llu, \"weld_ratio\": %.6f, \"stripped_triangles\": %llu",
+                jobs[j].Success ? "true" : "false", jobs[j].Cached ? "true" : "false", (unsigned long long)stats->InputBytes,
+                (unsigned long long)stats->OutputBytes, (unsigned long long)stats->Lines, (unsigned long long)stats->Meshes,
+                (unsigned long long)stats->Triangles, (unsigned long long)stats->InputVertices, (unsigned long long)stats->UniqueVertices,
+                GetWeldRatio(stats), (unsigned long long)stats->StrippedTriangles);
+        for (int k = 0; k < STAGE_COUNT; ++k) fprintf(file, ", \"%s\": %.6f", kStageNames[k], *(const double*)((const char*)stats + kStageOffsets[k]));
+        fprintf(file, ", \"peak_memory_bytes\": %llu, \"allocations\": %llu, \"heap_blocks\": %llu }",
+                (unsigned long long)stats->PeakMemory, (unsigned long long)stats->Allocations, (unsigned long long)stats->HeapBlocks);
     }
-    if (fwrite(buffers->Vertices, sizeof(float), buffers->Header.TotalVertices * buffers->Header.VertexSize, binFile) < buffers->Header.TotalVertices * buffers->Header.VertexSize) {
-        printf("Error: Failed to write binary vertex data! Aborting.");
-        return false;
+    fprintf(file, "\n  ]\n}\n");
+    bool success = !ferror(file);
+    if (fclose(file) != 0) success = false;
+    if (!success) printf("Error: Failed to write the stats to %s.\n", g_StatsOutput);
+    return success;
+}
+
+static int CompareJobSize(const void* a, const void* b) {
+    const BatchJob* jobA = a;
+    const BatchJob* jobB = b;
+    return jobA->Size < jobB->Size ? 1 : jobA->Size > jobB->Size ? -1 : 0;
+}
+
+// Takes the next job from the worker's own queue, or steals the smallest remaining job of another worker
+static bool NextBatchJob(BatchWorker* worker, size_t* job) {
+    for (unsigned int i = 0; i < worker->WorkerCount; ++i) {
+        WorkQueue* queue = &worker->Queues[(worker->Id + i) % worker->WorkerCount];
+        bool found = false;
+        MutexLock(&queue->Lock);
+        if (queue->Head < queue->Tail) {
+            *job = i == 0 ? queue->Jobs[queue->Head++] : queue->Jobs[--queue->Tail];
+            found = true;
+        }
+        MutexUnlock(&queue->Lock);
+        if (found) return true;
     }
-    if (fwrite(buffers->Indices, sizeof(unsigned int), buffers->Header.TotalIndices, binFile) < buffers->Header.TotalIndices) {
-        printf("Error: Failed to write binary index data! Aborting.");
-        return false;
+    return false;
+}
+
+static THREAD_FUNC(BatchWorkerMain) {
+    BatchWorker* worker = param;
+    size_t index;
+    while (NextBatchJob(worker, &index)) {
+        BatchJob* job = &worker->Jobs[index];
+        double start = GetTimeSeconds();
+        job->Success = ConvertCached(job->Input, job->Output, &worker->Arena, worker->Options, &job->Cached, &job->Stats);
+        job->Seconds = GetTimeSeconds() - start;
+        printf("%s %s -> %s (%.3fs)\n", job->Cached ? "[cached]" : job->Success ? "[ok]" : "[failed]", job->Input, job->Output, job->Seconds);
     }
-    
-    return true;
+    return 0;
 }
 
-bool Convert(const char* inName, const char* outName) {
-    FILE* objFile = fopen(inName, "r");
-    FILE* binFile = fopen(outName, "wb");
-    if (!objFile || !binFile) {
-        printf("Error: Failed to open the files.");
+// Converts every obj listed in a manifest or found in a directory on the option's thread count of workers. Jobs are
+// sorted by size and dealt round robin so each worker starts on large files, then work stealing evens out the tail.
+static bool ConvertMany(const char* source, const Options* options) {
+    unsigned int threadCount = options->ThreadCount > 0 ? options->ThreadCount : 1;
+    Options workerOptions = *options;
+    workerOptions.ThreadCount = 1;
+    BatchJob* jobs = NULL;
+    size_t jobCount = 0;
+    bool loaded = IsDirectory(source) ? LoadDirectoryJobs(source, &jobs, &jobCount) : LoadManifestJobs(source, &jobs, &jobCount);
+    if (!loaded) {
+        printf("Error: Failed to read the batch source %s.\n", source);
+        for (size_t i = 0; i < jobCount; ++i) {
+            free(jobs[i].Input);
+            free(jobs[i].Output);
+        }
+        free(jobs);
         return false;
     }
+    qsort(jobs, jobCount, sizeof(BatchJob), CompareJobSize);
 
-    Buffers buffers;
-    if (!AllocateBuffers(&buffers)) {
-        printf("Error: Failed to allocate required internal memory.");
+    if (threadCount > jobCount) threadCount = jobCount > 0 ? (unsigned int)jobCount : 1;
+    WorkQueue* queues = malloc(threadCount * sizeof(WorkQueue));
+    BatchWorker* workers = malloc(threadCount * sizeof(BatchWorker));
+    Thread* threads = malloc(threadCount * sizeof(Thread));
+    size_t* slots = malloc((jobCount + 1) * sizeof(size_t));
+    if (!queues || !workers || !threads || !slots) {
+        printf("Error: Failed to allocate required internal memory.\n");
+        free(queues);
+        free(workers);
+        free(threads);
+        free(slots);
         return false;
     }
 
-    while (true) { // Breaks when reading vertex or index data finds an EOF. Index may end early if there is no EOF newline
-        buffers.Meshes[buffers.Header.MeshCount].IndexOffset = buffers.Header.MeshCount == 0 ? 0 : 
-            buffers.Meshes[buffers.Header.MeshCount - 1].IndexOffset + buffers.Meshes[buffers.Header.MeshCount - 1].IndexCount;
-        if (!ReadVertexData(objFile, &buffers)) break;
-        if (!ReadIndexData(&objFile, &buffers)) break;
-        buffers.Header.MeshCount++;
+    // Worker w owns jobs w, w + threadCount, ... which are laid out contiguously in slots
+    size_t slot = 0;
+    for (unsigned int w = 0; w < threadCount; ++w) {
+        queues[w].Jobs = &slots[slot];
+        queues[w].Head = 0;
+        queues[w].Tail = 0;
+        for (size_t j = w; j < jobCount; j += threadCount) {
+            queues[w].Jobs[queues[w].Tail++] = j;
+        }
+        slot += queues[w].Tail;
+        MutexInit(&queues[w].Lock);
+
+        memset(&workers[w], 0, sizeof(BatchWorker));
+        workers[w].Id = w;
+        workers[w].WorkerCount = threadCount;
+        workers[w].Queues = queues;
+        workers[w].Jobs = jobs;
+        workers[w].Options = &workerOptions;
     }
 
-    ConvertData(binFile, &buffers);
-    
-    FreeBuffers(&buffers);
-    if (fclose(objFile) || fclose(binFile)) {
-        printf("Error: Failed to close the files!");
+    double start = GetTimeSeconds();
+    unsigned int started = 0;
+    for (unsigned int w = 1; w < threadCount; ++w) {
+        if (ThreadStart(&threads[started], BatchWorkerMain, &workers[w])) started++;
+    }
+    BatchWorkerMain(&workers[0]);
+    for (unsigned int t = 0; t < started; ++t) {
+        ThreadJoin(threads[t]);
     }
+    double seconds = GetTimeSeconds() - start;
 
-    if (g_Flags & FLAG_VERBOSE) {
-        ReadBinary(outName);
+    size_t succeeded = 0;
+    size_t cached = 0;
+    for (size_t i = 0; i < jobCount; ++i) {
+        if (jobs[i].Cached) cached++;
+        if (jobs[i].Success) succeeded++;
+        else printf("Failed: %s\n", jobs[i].Input);
+    }
+    printf("Converted %zu of %zu files in %.3fs on %u threads.\n", succeeded, jobCount, seconds, threadCount);
+    if (g_CacheDir) printf("%zu of the files were up to date in the cache.\n", cached);
+    if (g_StatsOutput) ReportStats(jobs, jobCount);
+    for (size_t i = 0; i < jobCount; ++i) {
+        free(jobs[i].Input);
+        free(jobs[i].Output);
     }
 
-    return true;
+    for (unsigned int w = 0; w < threadCount; ++w) {
+        MutexDestroy(&queues[w].Lock);
+        ArenaFree(&workers[w].Arena);
+    }
+    free(jobs);
+    free(queues);
+    free(workers);
+    free(threads);
+    free(slots);
+    return succeeded == jobCount;
 }
 
-bool ReadBinaryFile(FILE* binFile) {
-    Header header;
-    if (fread(&header, sizeof(Header), 1, binFile) < 1) {
-        printf("Error: Failed to read binary header! Aborting.");
-        return false;
-    }
-    Mesh* meshes = malloc(header.MeshCount * sizeof(Mesh));
-    if (fread(meshes, sizeof(Mesh), header.MeshCount, binFile) < header.MeshCount) {
-        printf("Error: Failed to read binary mesh! Aborting.");
-        return false;
-    }
+// xorshift64*, deterministic so generated objs are the same on every run and platform
+static float NextRandom(uint64_t* state) {
+    *state ^= *state >> 12;
+    *state ^= *state << 25;
+    *state ^= *state >> 27;
+    return (float)((*state * 0x2545F4914F6CDD1DULL) >> 40) / 16777216.0f;
+}
 
-    float* vertices = malloc(sizeof(float) * header.VertexSize * header.TotalVertices);
-    unsigned int* indices = malloc(sizeof(unsigned int) * header.TotalIndices);
+static void WriteCorner(FILE* file, size_t index, unsigned int components) {
+    if ((components & (OBJTOBIN_VERTEX_TEXCOORDS | OBJTOBIN_VERTEX_NORMALS)) == (OBJTOBIN_VERTEX_TEXCOORDS | OBJTOBIN_VERTEX_NORMALS)) {
+        fprintf(file, " %zu/%zu/%zu", index, index, index);
+    }
+    else if (components & OBJTOBIN_VERTEX_TEXCOORDS) fprintf(file, " %zu/%zu", index, index);
+    else if (components & OBJTOBIN_VERTEX_NORMALS) fprintf(file, " %zu//%zu", index, index);
+    else fprintf(file, " %zu", index);
+}
 
-    if (fread(vertices, sizeof(float) * header.VertexSize, header.TotalVertices, binFile) < header.TotalVertices) {
-        printf("Error: Failed to read binary vertices! Aborting.");
-        free(vertices);
-        free(indices);
-        return false;
+// Position and normal of a grid or sphere at lattice coordinates u, v in [0, 1]
+static void SurfacePoint(unsigned int shape, float u, float v, float* p, float* n) {
+    if (shape == SHAPE_GRID) {
+        const float waves = 8.0f * 3.14159265f;
+        p[0] = u;
+        p[1] = 0.02f * sinf(u * waves) * cosf(v * waves);
+        p[2] = v;
+        n[0] = -0.02f * waves * cosf(u * waves) * cosf(v * waves);
+        n[1] = 1.0f;
+        n[2] = 0.02f * waves * sinf(u * waves) * sinf(v * waves);
+        float length = sqrtf(n[0] * n[0] + n[1] * n[1] + n[2] * n[2]);
+        for (int k = 0; k < 3; ++k) n[k] /= length;
     }
-    if (fread(indices, sizeof(unsigned int), header.TotalIndices, binFile) < header.TotalIndices) {
-        printf("Error: Failed to read binary indices! Aborting.");
-        free(vertices);
-        free(indices);
-        return false;
+    else {
+        float theta = 3.14159265f * v;
+        float phi = 2.0f * 3.14159265f * u;
+        n[0] = sinf(theta) * cosf(phi);
+        n[1] = cosf(theta);
+        n[2] = sinf(theta) * sinf(phi);
+        for (int k = 0; k < 3; ++k) p[k] = n[k];
     }
-    printf("Mesh count: %i\n", header.MeshCount);
-    for (unsigned int m = 0; m < header.MeshCount; ++m) {
-        printf("Object %i:    Vertex Count %i    Vertex Size %i    Index Count %i    Index Size %i    Components %i    VIOffset (%i,%i)\n", 
-            m, meshes[m].VertexCount, header.VertexSize, meshes[m].IndexCount, header.IndexSize, header.Components, meshes[m].VertexOffset, meshes[m].IndexOffset);
-        for (unsigned int i = 0; i < meshes[m].VertexCount; ++i) {
-            unsigned int j = i * header.VertexSize;
-            printf("Vertex %i v(%f, %f, %f) ", i, vertices[j], vertices[j + 1], vertices[j + 2]);
-            j += 3;
-            if (header.Components & VERTEX_TEXCOORDS) {
-                printf("vt(%f, %f) ", vertices[j], vertices[j + 1]);
-                j += 2;
+}
+
+// Writes one object of about triangles triangles, its first vertex having the 1 based index base
+static size_t WriteSyntheticObject(FILE* file, unsigned int shape, size_t triangles, unsigned int components, float offset, size_t base, uint64_t* random) {
+    size_t vertexCount;
+    if (shape == SHAPE_SOUP) {
+        vertexCount = triangles * 3;
+        for (size_t t = 0; t < triangles; ++t) {
+            float center[3] = { NextRandom(random) + offset, NextRandom(random), NextRandom(random) };
+            for (int c = 0; c < 3; ++c) {
+                fprintf(file, "v %.6f %.6f %.6f\n", center[0] + 0.01f * NextRandom(random), center[1] + 0.01f * NextRandom(random), center[2] + 0.01f * NextRandom(random));
             }
-            if (header.Components & VERTEX_NORMALS) {
-                printf("vn(%f, %f, %f)", vertices[j], vertices[j + 1], vertices[j + 2]);
-                j += 3;
+        }
+        if (components & OBJTOBIN_VERTEX_TEXCOORDS) {
+            for (size_t v = 0; v < vertexCount; ++v) fprintf(file, "vt %.6f %.6f\n", NextRandom(random), NextRandom(random));
+        }
+        if (components & OBJTOBIN_VERTEX_NORMALS) {
+            for (size_t v = 0; v < vertexCount; ++v) {
+                float n[3] = { NextRandom(random) - 0.5f, NextRandom(random) - 0.5f, 0.5f };
+                float length = sqrtf(n[0] * n[0] + n[1] * n[1] + n[2] * n[2]);
+                fprintf(file, "vn %.6f %.6f %.6f\n", n[0] / length, n[1] / length, n[2] / length);
             }
-            if (header.Components & VERTEX_TANGENTS) {
-                printf("tn(%f, %f, %f)", vertices[j], vertices[j + 1], vertices[j + 2]);
+        }
+        for (size_t t = 0; t < triangles; ++t) {
+            fprintf(file, "f");
+            for (size_t c = 0; c < 3; ++c) WriteCorner(file, base + t * 3 + c, components);
+            fprintf(file, "\n");
+        }
+        return vertexCount;
+    }
+
+    // Lattice of (cols + 1) x (rows + 1) points with two triangles per cell, a sphere has twice as many columns as rows
+    size_t rows = (size_t)sqrt((double)triangles / (shape == SHAPE_SPHERE ? 4.0 : 2.0));
+    if (rows < 1) rows = 1;
+    size_t cols = shape == SHAPE_SPHERE ? rows * 2 : rows;
+    vertexCount = (rows + 1) * (cols + 1);
+    float p[3], n[3];
+    for (size_t r = 0; r <= rows; ++r) {
+        for (size_t c = 0; c <= cols; ++c) {
+            SurfacePoint(shape, (float)c / cols, (float)r / rows, p, n);
+            fprintf(file, "v %.6f %.6f %.6f\n", p[0] + offset, p[1], p[2]);
+        }
+    }
+    if (components & OBJTOBIN_VERTEX_TEXCOORDS) {
+        for (size_t r = 0; r <= rows; ++r) {
+            for (size_t c = 0; c <= cols; ++c) fprintf(file, "vt %.6f %.6f\n", (float)c / cols, (float)r / rows);
+        }
+    }
+    if (components & OBJTOBIN_VERTEX_NORMALS) {
+        for (size_t r = 0; r <= rows; ++r) {
+            for (size_t c = 0; c <= cols; ++c) {
+                SurfacePoint(shape, (float)c / cols, (float)r / rows, p, n);
+                fprintf(file, "vn %.6f %.6f %.6f\n", n[0], n[1], n[2]);
             }
-            printf("\n");
         }
-        printf("Indices\n");
-        for (unsigned int i = meshes[m].IndexOffset; i < meshes[m].IndexCount + meshes[m].IndexOffset; ++i) {
-            printf("%i ", indices[i]);
+    }
+    for (size_t r = 0; r < rows; ++r) {
+        for (size_t c = 0; c < cols; ++c) {
+            size_t a = base + r * (cols + 1) + c;
+            size_t b = a + cols + 1;
+            size_t corners[6] = { a, b, a + 1, a + 1, b, b + 1 };
+            for (size_t t = 0; t < 2; ++t) {
+                fprintf(file, "f");
+                for (size_t k = 0; k < 3; ++k) WriteCorner(file, corners[t * 3 + k], components);
+                fprintf(file, "\n");
+            }
         }
-        printf("\n");
     }
+    return vertexCount;
+}
 
-    free(vertices);
-    free(indices);
-    return true;
+// Writes a synthetic obj of about triangles triangles split evenly across objects, each object being an o record
+// followed by its attributes then its faces
+static bool GenerateObj(const char* objName, unsigned int shape, size_t triangles, unsigned int components, unsigned int objects) {
+    FILE* file = fopen(objName, "wb");
+    if (!file) {
+        printf("Error: Failed to open %s for writing.\n", objName);
+        return false;
+    }
+    setvbuf(file, NULL, _IOFBF, COPY_BUFFER_SIZE);
+    uint64_t random = 0x9E3779B97F4A7C15ULL;
+    size_t base = 1;
+    size_t objectTriangles = objects > 0 ? triangles / objects : triangles;
+    if (objectTriangles < 1) objectTriangles = 1;
+    fprintf(file, "# objtobin synthetic %s, %zu triangles, %s, %u objects\n", kShapeNames[shape], triangles, kAttributeSetNames[(components >> 1) & 3], objects);
+    for (unsigned int o = 0; o < objects; ++o) {
+        fprintf(file, "o %s%u\n", kShapeNames[shape], o);
+        base += WriteSyntheticObject(file, shape, objectTriangles, components, 2.5f * o, base, &random);
+    }
+    bool success = !ferror(file);
+    if (fclose(file) != 0) success = false;
+    if (!success) printf("Error: Failed to write %s.\n", objName);
+    return success;
 }
 
-bool ReadBinary(const char* binName) {
-    FILE* binFile = fopen(binName, "rb");
-    if (!binFile) {
-        printf("Error: Failed to open the binary file for reading.");
+static int CompareDouble(const void* a, const void* b) {
+    double x = *(const double*)a;
+    double y = *(const double*)b;
+    return x < y ? -1 : x > y;
+}
+
+static double GetMedian(double* values, unsigned int count) {
+    qsort(values, count, sizeof(double), CompareDouble);
+    return count % 2 ? values[count / 2] : 0.5 * (values[count / 2 - 1] + values[count / 2]);
+}
+
+// Converts every benchmark case generated with the given number of triangles, runs times each, and writes the median
+// of each stage as JSON, or CSV if the results file ends in .csv. Conversion flags apply to every run.
+static bool RunBenchmarks(const char* resultsName, size_t triangles, unsigned int runs, const Options* options) {
+    static const BenchmarkCase cases[] = {
+        { "grid_ptn", SHAPE_GRID, OBJTOBIN_VERTEX_POSITION | OBJTOBIN_VERTEX_TEXCOORDS | OBJTOBIN_VERTEX_NORMALS, 1 },
+        { "grid_p", SHAPE_GRID, OBJTOBIN_VERTEX_POSITION, 1 },
+        { "sphere_ptn", SHAPE_SPHERE, OBJTOBIN_VERTEX_POSITION | OBJTOBIN_VERTEX_TEXCOORDS | OBJTOBIN_VERTEX_NORMALS, 1 },
+        { "sphere_pt_multi", SHAPE_SPHERE, OBJTOBIN_VERTEX_POSITION | OBJTOBIN_VERTEX_TEXCOORDS, 256 },
+        { "soup_pn", SHAPE_SOUP, OBJTOBIN_VERTEX_POSITION | OBJTOBIN_VERTEX_NORMALS, 1 },
+        { "soup_ptn_multi", SHAPE_SOUP, OBJTOBIN_VERTEX_POSITION | OBJTOBIN_VERTEX_TEXCOORDS | OBJTOBIN_VERTEX_NORMALS, 64 }
+    };
+    size_t caseCount = sizeof(cases) / sizeof(cases[0]);
+    size_t nameLen = strlen(resultsName);
+    bool csv = nameLen >= 4 && strcmp(&resultsName[nameLen - 4], ".csv") == 0;
+    char* objName = malloc(nameLen + 5);
+    char* binName = malloc(nameLen + 5);
+    ConvertStats* stats = malloc(runs * sizeof(ConvertStats));
+    double* values = malloc(runs * sizeof(double));
+    FILE* results = fopen(resultsName, "w");
+    if (!objName || !binName || !stats || !values || !results) {
+        printf("Error: Failed to open %s for the results.\n", resultsName);
+        free(objName);
+        free(binName);
+        free(stats);
+        free(values);
+        if (results) fclose(results);
         return false;
     }
+    sprintf(objName, "%s.obj", resultsName);
+    sprintf(binName, "%s.bin", resultsName);
+
+    if (csv) {
+        fprintf(results, "case,shape,attributes,objects,input_bytes,triangles");
+        for (int k = 0; k < STAGE_COUNT; ++k) fprintf(results, ",%s", kStageNames[k]);
+        fprintf(results, ",mb_per_s,tris_per_s\n");
+    }
+    else {
+        fprintf(results, "{\n  \"version\": \"%s\",\n  \"triangles\": %zu,\n  \"runs\": %u,\n  \"threads\": %u,\n  \"flags\": %u,\n  \"results\": [",
+                kToolVersion, triangles, runs, options->ThreadCount, (unsigned int)(options->Flags & ~OBJTOBIN_FLAG_VERBOSE));
+    }
+    printf("%-16s %10s %10s", "case", "MB", "tris");
+    for (int k = 0; k < STAGE_COUNT; ++k) printf(" %9s", kStageNames[k]);
+    printf(" %9s %12s\n", "MB/s", "tris/s");
+
+    Arena arena = { 0 };
+    bool success = true;
+    for (size_t c = 0; success && c < caseCount; ++c) {
+        const BenchmarkCase* bench = &cases[c];
+        success = GenerateObj(objName, bench->Shape, triangles, bench->Components, bench->Objects);
+        for (unsigned int r = 0; success && r < runs; ++r) {
+            success = Convert(objName, binName, &arena, options, &stats[r]);
+        }
+        if (!success) {
+            printf("Error: Benchmark %s failed.\n", bench->Name);
+            break;
+        }
 
-    ReadBinaryFile(binFile);
+        double medians[STAGE_COUNT];
+        for (int k = 0; k < STAGE_COUNT; ++k) {
+            for (unsigned int r = 0; r < runs; ++r) values[r] = *(const double*)((const char*)&stats[r] + kStageOffsets[k]);
+            medians[k] = GetMedian(values, runs);
+        }
+        double total = medians[STAGE_COUNT - 1] > 0.0 ? medians[STAGE_COUNT - 1] : 1e-9;
+        double megabytesPerSecond = (double)stats[0].InputBytes / 1e6 / total;
+        double trianglesPerSecond = (double)stats[0].Triangles / total;
+        const char* attributes = kAttributeSetNames[(bench->Components >> 1) & 3];
 
-    if (fclose(binFile)) {
-        printf("Error: Failed to close the files!");
+        printf("%-16s %10.1f %10llu", bench->Name, (double)stats[0].InputBytes / 1e6, (unsigned long long)stats[0].Triangles);
+        for (int k = 0; k < STAGE_COUNT; ++k) printf(" %9.4f", medians[k]);
+        printf(" %9.1f %12.0f\n", megabytesPerSecond, trianglesPerSecond);
+        if (csv) {
+            fprintf(results, "%s,%s,%s,%u,%llu,%llu", bench->Name, kShapeNames[bench->Shape], attributes, bench->Objects,
+                    (unsigned long long)stats[0].InputBytes, (unsigned long long)stats[0].Triangles);
+            for (int k = 0; k < STAGE_COUNT; ++k) fprintf(results, ",%.6f", medians[k]);
+            fprintf(results, ",%.3f,%.0f\n", megabytesPerSecond, trianglesPerSecond);
+        }
+        else {
+            fprintf(results, "%s\n    { \"case\": \"%s\", \"shape\": \"%s\", \"attributes\": \"%s\", \"objects\": %u, \"input_bytes\": %llu, \"triangles\": %llu",
+                    c > 0 ? "," : "", bench->Name, kShapeNames[bench->Shape], attributes, bench->Objects,
+                    (unsigned long long)stats[0].InputBytes, (unsigned long long)stats[0].Triangles);
+            for (int k = 0; k < STAGE_COUNT; ++k) fprintf(results, ", \"%s\": %.6f", kStageNames[k], medians[k]);
+            fprintf(results, ", \"mb_per_s\": %.3f, \"tris_per_s\": %.0f }", megabytesPerSecond, trianglesPerSecond);
+        }
+    }
+    if (!csv) fprintf(results, "\n  ]\n}\n");
+
+    if (fclose(results) != 0) success = false;
+    remove(objName);
+    remove(binName);
+    ArenaFree(&arena);
+    free(objName);
+    free(binName);
+    free(stats);
+    free(values);
+    return success;
+}
+
+// Drops the pages of a file from the page cache so the next read of it comes from the disk. Only clean pages can be
+// dropped, so it is synced first. Returns false where this is not possible.
+static bool DropFileCache(const char* name) {
+#if defined(_WIN32) || !defined(POSIX_FADV_DONTNEED)
+    (void)name;
+    return false;
+#else
+    int fd = open(name, O_RDONLY);
+    if (fd < 0) return false;
+    bool dropped = fsync(fd) == 0 && posix_fadvise(fd, 0, 0, POSIX_FADV_DONTNEED) == 0;
+    close(fd);
+    return dropped;
+#endif
+}
+
+// Reads the whole pack with fread before any mesh can be used, as binaries were loaded before the mapped loader
+static bool LoadWithFread(const char* binName, uint64_t size, LoadTimes* times) {
+    double start = GetTimeSeconds();
+    FILE* file = fopen(binName, "rb");
+    unsigned char* data = malloc((size_t)size + 1);
+    bool success = file && data && fread(data, 1, (size_t)size, file) == size;
+    if (file) fclose(file);
+    ObjToBinPack pack;
+    success = success && ObjToBinOpenMemory(&pack, data, (size_t)size) == OBJTOBIN_OK;
+    if (success) ObjToBinClose(&pack);
+    times->First = GetTimeSeconds() - start;
+    times->All = times->First;
+    free(data);
+    return success;
+}
+
+static void OnMeshLoaded(void* user, uint32_t mesh, int result) {
+    LoadProgress* progress = user;
+    if (progress->Loaded++ == 0) progress->First = GetTimeSeconds() - progress->Start;
+    if (result != OBJTOBIN_OK) progress->Failed++;
+    (void)mesh;
+}
+
+// Streams every mesh of the pack in to the buffers of the requests, as a streaming engine would with everything in view
+static bool LoadWithStream(const char* binName, int backend, ObjToBinStreamRequest* requests, uint32_t meshCount, LoadTimes* times) {
+    LoadProgress progress = { GetTimeSeconds(), 0.0, 0, 0 };
+    ObjToBinStream* stream = malloc(sizeof(ObjToBinStream));
+    if (!stream || ObjToBinStreamOpen(stream, binName, backend) != OBJTOBIN_OK) {
+        free(stream);
         return false;
     }
-    return true;
+    bool success = true;
+    for (uint32_t m = 0; success && m < meshCount; ++m) {
+        requests[m].User = &progress;
+        success = ObjToBinStreamLoad(stream, &requests[m]) == OBJTOBIN_OK;
+    }
+    while (ObjToBinStreamPending(stream) > 0) ObjToBinStreamPoll(stream, 1);
+    times->First = progress.First;
+    times->All = GetTimeSeconds() - progress.Start;
+    ObjToBinStreamClose(stream);
+    free(stream);
+    return success && progress.Failed == 0 && progress.Loaded == meshCount;
 }
 
-bool BatchBinaries(const char* inBinName, const char* const* srcNames, int srcCount) {
-    // Batch the binary vertex data and index data packed tightly in one file, with multiple "Headers" for each separate dataset.
-    return true;
+// Loads a pack runs times each with fread, and streamed a mesh at a time through io_uring and through threads, from a
+// cold then a warm page cache. Prints the median time until the first mesh and every mesh can be used.
+static bool RunLoadBenchmark(const char* binName, unsigned int runs) {
+    ObjToBinStream* stream = malloc(sizeof(ObjToBinStream));
+    int result = stream ? ObjToBinStreamOpen(stream, binName, OBJTOBIN_STREAM_AUTO) : OBJTOBIN_ERROR_MEMORY;
+    if (result != OBJTOBIN_OK) {
+        printf("Error: Failed to read %s, %s! Aborting.\n", binName, ObjToBinResultString(result));
+        free(stream);
+        return false;
+    }
+    // The streamed meshes are read in to buffers allocated up front, a mesh sharing vertices only reads its indices
+    uint32_t meshCount = stream->Header.MeshCount;
+    uint64_t packSize = stream->Size;
+    bool ring = stream->Backend == OBJTOBIN_STREAM_IO_URING;
+    uint64_t bufferBytes = 0;
+    for (uint32_t m = 0; m < meshCount; ++m) {
+        const ObjToBinMesh* mesh = ObjToBinStreamGetMesh(stream, m);
+        uint64_t vertexBytes = ObjToBinStreamSharesVertices(stream, m) ? 0 : ObjToBinStreamVertexBytes(stream, mesh);
+        bufferBytes += ((vertexBytes + 15) & ~(uint64_t)15) + ((ObjToBinStreamIndexBytes(stream, mesh) + 15) & ~(uint64_t)15);
+    }
+    ObjToBinStreamRequest* requests = malloc(((size_t)meshCount + 1) * sizeof(ObjToBinStreamRequest));
+    unsigned char* buffers = malloc((size_t)bufferBytes + 1);
+    LoadTimes* times = malloc(runs * sizeof(LoadTimes));
+    double* values = malloc(runs * sizeof(double));
+    bool success = requests && buffers && times && values;
+    if (!success) printf("Error: Failed to allocate required internal memory.");
+    for (uint32_t m = 0, offset = 0; success && m < meshCount; ++m) {
+        const ObjToBinMesh* mesh = ObjToBinStreamGetMesh(stream, m);
+        uint64_t vertexBytes = ObjToBinStreamSharesVertices(stream, m) ? 0 : ObjToBinStreamVertexBytes(stream, mesh);
+        uint64_t indexBytes = ObjToBinStreamIndexBytes(stream, mesh);
+        requests[m].Mesh = m;
+        requests[m].Vertices = vertexBytes > 0 ? buffers + offset : NULL;
+        offset += (vertexBytes + 15) & ~(uint64_t)15;
+        requests[m].Indices = indexBytes > 0 ? buffers + offset : NULL;
+        offset += (indexBytes + 15) & ~(uint64_t)15;
+        requests[m].Callback = OnMeshLoaded;
+    }
+    ObjToBinStreamClose(stream);
+    free(stream);
+
+    bool cold = DropFileCache(binName);
+    if (!cold) printf("Warning: The page cache can not be dropped here, cold loads are warm.\n");
+    printf("%s: %u meshes, %.1f MB, %u runs\n", binName, meshCount, packSize / 1e6, runs);
+    printf("%-10s %6s %14s %14s %9s\n", "path", "cache", "first mesh ms", "all meshes ms", "MB/s");
+    static const char* const paths[3] = { "fread", "io_uring", "threads" };
+    static const int backends[3] = { 0, OBJTOBIN_STREAM_IO_URING, OBJTOBIN_STREAM_THREADS };
+    for (int warm = 0; success && warm < 2; ++warm) {
+        // Warm loads follow a read of the whole file
+        LoadTimes warmup;
+        if (warm) success = LoadWithFread(binName, packSize, &warmup);
+        for (int path = 0; success && path < 3; ++path) {
+            if (path == 1 && !ring) continue;
+            for (unsigned int r = 0; success && r < runs; ++r) {
+                if (!warm) DropFileCache(binName);
+                success = path == 0 ? LoadWithFread(binName, packSize, &times[r]) : LoadWithStream(binName, backends[path], requests, meshCount, &times[r]);
+            }
+            if (!success) {
+                printf("Error: Loading %s with %s failed.\n", binName, paths[path]);
+                break;
+            }
+            for (unsigned int r = 0; r < runs; ++r) values[r] = times[r].First;
+            double first = GetMedian(values, runs);
+            for (unsigned int r = 0; r < runs; ++r) values[r] = times[r].All;
+            double all = GetMedian(values, runs);
+            printf("%-10s %6s %14.3f %14.3f %9.1f\n", paths[path], warm ? "warm" : "cold", first * 1e3, all * 1e3, packSize / 1e6 / (all > 0.0 ? all : 1e-9));
+        }
+    }
+    if (!ring) printf("io_uring is not available, only the thread pool was streamed with.\n");
+    free(requests);
+    free(buffers);
+    free(times);
+    free(values);
+    return success;
 }
 
-void OutputHelp() {
+
+static void OutputHelp() {
     printf("objtobin help: \n\t"
-            "Converts Wavefront obj meshes containing vertex positions, uvs, and normals with triangulated faces to an interleaved binary format.\n\t"
+            "Converts Wavefront obj meshes containing vertex positions, uvs, and normals with any polygonal faces to an interleaved binary format.\n\t"
             "Output mode (-c):\n\t\tRead a wavefront obj and output it in binary format.\n\t"
                 "Usage: objtobin.exe -c [input obj] [output bin] [flags]\n\t\t"
-                "Flags:\n\t\t\t -t (Generate tangents)\n\t\t\t -v (Verbose)\n\t\t\t -f (Flip texcoords vertically)\n\t"
+                "Flags:\n\t\t\t -t (Generate MikkTSpace tangents, needs texcoords and normals)\n\t\t\t -v (Verbose)\n\t\t\t -f (Flip texcoords vertically)\n\t\t\t"
+                    " -j [threads] (Parse in parallel chunks, 0 uses every core)\n\t\t\t"
+                    " -o (Optimize for the vertex cache, overdraw, and vertex fetch, reporting ACMR and ATVR with -v)\n\t\t\t"
+                    " -s [megabytes] (Stream the obj in one pass within about this much memory, 0 uses 1024. Meshes too large\n\t\t\t\t"
+                        " for it are split. Faces must follow the attributes they use, -j is ignored)\n\t\t\t"
+                    " -l [levels] (Generate up to this many levels of detail per mesh, each with about half the triangles of the last,\n\t\t\t\t"
+                        " up to 8. Seams and borders are kept, so levels reuse the mesh's vertices)\n\t\t\t"
+                    " --meshlets (Split each mesh in to meshlets of up to 64 vertices and 124 triangles, each with a bounding sphere\n\t\t\t\t"
+                        " and a normal cone for culling)\n\t\t\t"
+                    " --bvh (Build a triangle BVH of each mesh with binned SAH, for raycasts and picking)\n\t\t\t"
+                    " --min-area [area] (Strip triangles with less area than this, in the obj's units squared, as well as the\n\t\t\t\t"
+                        " duplicate and degenerate triangles always stripped)\n\t\t\t"
+                    " -z (Compress the vertices and indices losslessly, they are decoded when the pack is opened)\n\t\t\t"
+                    " --shared (Weld every mesh of the obj in to one vertex buffer that all of the meshes index, -s ignores it)\n\t\t\t"
+                    " -p (Planar vertices, one array per attribute in each mesh instead of interleaved)\n\t\t\t"
+                    " -q (Compact vertices, same as --position snorm16 --texcoord unorm16 --normal oct16 --tangent oct16 --index auto)\n\t\t\t"
+                    " --position [float|half|snorm16] (Position format, non float formats use the mesh bounds)\n\t\t\t"
+                    " --texcoord [float|half|unorm16] (Texcoord format, unorm16 uses the mesh texcoord bounds)\n\t\t\t"
+                    " --normal [float|half|oct16] (Normal format)\n\t\t\t"
+                    " --tangent [float|half|oct16] (Tangent format, oct16 adds a snorm16 handedness)\n\t\t\t"
+                    " --index [auto|32] (auto uses 16-bit indices for meshes with up to 65536 vertices)\n\t\t\t"
+                    " --cache [directory] (Reuse the pack of an earlier conversion with the same input content and flags,\n\t\t\t\t"
+                        " outputs are hard links in to the cache. Hits and misses are appended to manifest.txt in the cache)\n\t\t\t"
+                    " --stats [table|json file] (Time every stage and count lines, vertices before and after welding, working memory\n\t\t\t\t"
+                        " and allocations of each file. Printed as a table, or written as JSON to the given file)\n\t"
+            "Many mode (-m):\n\t\tConvert every obj listed in a manifest, or found in a directory, on a pool of worker threads.\n\t\t"
+                "Manifest lines are \"input.obj [output.bin]\", without an output the .obj is swapped for .bin.\n\t\t"
+                "Usage: objtobin.exe -m [manifest or directory] [flags]\n\t\t"
+                "Flags are as for output mode, -j sets the number of workers and defaults to every core. A -s budget is per worker.\n\t"
+            "Generate mode (-g):\n\t\tWrite a synthetic obj of about the given number of triangles, split across objects.\n\t\t"
+                "Usage: objtobin.exe -g [grid|sphere|soup] [triangles] [output obj] [p|pt|pn|ptn] [objects]\n\t"
+            "Benchmark mode (-k):\n\t\tConvert generated grids, spheres and soups runs times each, timing every stage.\n\t\t"
+                "Writes the median of each stage, MB/s and triangles/s as JSON, or as CSV if the results file ends in .csv.\n\t\t"
+                "Usage: objtobin.exe -k [results file] [triangles] [runs] [flags]\n\t\t"
+                "Flags are as for output mode.\n\t"
+            "Load benchmark mode (-r):\n\t\tLoad a pack runs times with fread, then streamed a mesh at a time through io_uring and a thread pool.\n\t\t"
+                "Prints the median time until the first and every mesh can be used, from a cold then a warm page cache.\n\t\t"
+                "Usage: objtobin.exe -r [input bin] [runs]\n\t"
             "Inspect mode (-i):\n\t\tRead a binary obj file and display its data.\n\t\t"
                 "Usage: objtobin.exe -i [input bin]\n\t"
             "Batch mode (-b):\n\t\tBatch the input binary files together to one file.\n\t\t"
-                "Usage: objtobin.exe -b [output bin] [input bin 1, input bin 2, ...]\n\t");
+                "Usage: objtobin.exe -b [output bin] [input bin 1, input bin 2, ...] [-z]\n\t\t"
+                "Inputs may be compressed, the output is only compressed with -z.\n\t");
+}
+
+// Returns the ObjToBinAttributeFormat with the given name if the attribute can use it, otherwise -1
+static int ParseAttributeFormat(const char* name, unsigned int component) {
+    for (int format = OBJTOBIN_FORMAT_FLOAT; format <= OBJTOBIN_FORMAT_OCT16; ++format) {
+        if (strcmp(name, kFormatNames[format]) != 0) continue;
+        if (format == OBJTOBIN_FORMAT_FLOAT || format == OBJTOBIN_FORMAT_HALF) return format;
+        if (component == OBJTOBIN_VERTEX_POSITION && format == OBJTOBIN_FORMAT_SNORM16) return format;
+        if (component == OBJTOBIN_VERTEX_TEXCOORDS && format == OBJTOBIN_FORMAT_UNORM16) return format;
+        if ((component == OBJTOBIN_VERTEX_NORMALS || component == OBJTOBIN_VERTEX_TANGENTS) && format == OBJTOBIN_FORMAT_OCT16) return format;
+    }
+    printf("Error: %s is not a valid format for this attribute.\n", name);
+    return -1;
+}
+
+static void ParseFlags(int argc, char** argv, int first, Options* options) {
+    for (int i = first; i < argc; ++i) {
+        if (strcmp(argv[i], kTangentArg) == 0) options->Flags |= OBJTOBIN_FLAG_GENERATE_TANGENTS;
+        else if (strcmp(argv[i], kVerboseArg) == 0) options->Flags |= OBJTOBIN_FLAG_VERBOSE;
+        else if (strcmp(argv[i], kFlipTexcoordArg) == 0) options->Flags |= OBJTOBIN_FLAG_FLIP_TEXCOORD_V;
+        else if (strcmp(argv[i], kOptimizeArg) == 0) options->Flags |= OBJTOBIN_FLAG_OPTIMIZE;
+        else if (strcmp(argv[i], kPlanarArg) == 0) options->Flags |= OBJTOBIN_FLAG_PLANAR;
+        else if (strcmp(argv[i], kMeshletArg) == 0) options->Flags |= OBJTOBIN_FLAG_MESHLETS;
+        else if (strcmp(argv[i], kCompressArg) == 0) options->Flags |= OBJTOBIN_FLAG_COMPRESS;
+        else if (strcmp(argv[i], kSharedArg) == 0) options->Flags |= OBJTOBIN_FLAG_SHARED_VERTICES;
+        else if (strcmp(argv[i], kBvhArg) == 0) options->Flags |= OBJTOBIN_FLAG_BVH;
+        else if (strcmp(argv[i], kCompactArg) == 0) {
+            options->PositionFormat = OBJTOBIN_FORMAT_SNORM16;
+            options->TexcoordFormat = OBJTOBIN_FORMAT_UNORM16;
+            options->NormalFormat = OBJTOBIN_FORMAT_OCT16;
+            options->TangentFormat = OBJTOBIN_FORMAT_OCT16;
+            options->Flags |= OBJTOBIN_FLAG_AUTO_INDEX_SIZE;
+        }
+        else if (strcmp(argv[i], kPositionFormatArg) == 0 && i + 1 < argc) {
+            int format = ParseAttributeFormat(argv[++i], OBJTOBIN_VERTEX_POSITION);
+            if (format >= 0) options->PositionFormat = format;
+        }
+        else if (strcmp(argv[i], kTexcoordFormatArg) == 0 && i + 1 < argc) {
+            int format = ParseAttributeFormat(argv[++i], OBJTOBIN_VERTEX_TEXCOORDS);
+            if (format >= 0) options->TexcoordFormat = format;
+        }
+        else if (strcmp(argv[i], kNormalFormatArg) == 0 && i + 1 < argc) {
+            int format = ParseAttributeFormat(argv[++i], OBJTOBIN_VERTEX_NORMALS);
+            if (format >= 0) options->NormalFormat = format;
+        }
+        else if (strcmp(argv[i], kTangentFormatArg) == 0 && i + 1 < argc) {
+            int format = ParseAttributeFormat(argv[++i], OBJTOBIN_VERTEX_TANGENTS);
+            if (format >= 0) options->TangentFormat = format;
+        }
+        else if (strcmp(argv[i], kIndexFormatArg) == 0 && i + 1 < argc) {
+            if (strcmp(argv[++i], "auto") == 0) options->Flags |= OBJTOBIN_FLAG_AUTO_INDEX_SIZE;
+            else options->Flags &= ~OBJTOBIN_FLAG_AUTO_INDEX_SIZE;
+        }
+        else if (strcmp(argv[i], kCacheArg) == 0 && i + 1 < argc) g_CacheDir = argv[++i];
+        else if (strcmp(argv[i], kStatsArg) == 0 && i + 1 < argc) g_StatsOutput = argv[++i];
+        else if (strcmp(argv[i], kStreamArg) == 0 && i + 1 < argc) {
+            int megabytes = atoi(argv[++i]);
+            options->StreamBudget = megabytes > 0 ? (uint64_t)megabytes * 1024 * 1024 : STREAM_DEFAULT_BUDGET;
+        }
+        else if (strcmp(argv[i], kMinAreaArg) == 0 && i + 1 < argc) {
+            double area = atof(argv[++i]);
+            options->MinArea = area > 0.0 ? (float)area : 0.0f;
+        }
+        else if (strcmp(argv[i], kLodArg) == 0 && i + 1 < argc) {
+            int levels = atoi(argv[++i]);
+            options->LodLevels = levels < 0 ? 0 : levels > LOD_MAX_LEVELS ? LOD_MAX_LEVELS : (unsigned int)levels;
+        }
+        else if (strcmp(argv[i], kThreadsArg) == 0 && i + 1 < argc) {
+            int threads = atoi(argv[++i]);
+            options->ThreadCount = threads > 0 ? (unsigned int)threads : GetCoreCount();
+        }
+        else OutputHelp();
+    }
 }
 
-bool ParseConvertArgs(int argc, char** argv, char** inObjName, char** outBinName) {
+static bool ParseConvertArgs(int argc, char** argv, char** inObjName, char** outBinName, Options* options) {
     if (argc < 4) {
         OutputHelp();
         printf("Error: Not enough arguments provided.\n");
@@ -454,16 +6146,24 @@ bool ParseConvertArgs(int argc, char** argv, char** inObjName, char** outBinName
     *inObjName = argv[2];
     *outBinName = argv[3];
 
-    for (size_t i = 4; i < argc; ++i) {
-        if (strcmp(argv[i], kTangentArg) == 0) g_Flags |= FLAG_GENERATE_TANGENTS;
-        else if (strcmp(argv[i], kVerboseArg) == 0) g_Flags |= FLAG_VERBOSE;
-        else if (strcmp(argv[i], kFlipTexcoordArg) == 0) g_Flags |= FLAG_FLIP_TEXCOORD_V;
-        else OutputHelp();
+    ParseFlags(argc, argv, 4, options);
+    return true;
+}
+
+static bool ParseManyArgs(int argc, char** argv, char** source, Options* options) {
+    if (argc < 3) {
+        OutputHelp();
+        printf("Error: Not enough arguments provided.\n");
+        return false;
     }
+
+    *source = argv[2];
+    options->ThreadCount = GetCoreCount();
+    ParseFlags(argc, argv, 3, options);
     return true;
 }
 
-bool ParseReadArgs(int argc, char** argv, char** inName) {
+static bool ParseReadArgs(int argc, char** argv, char** inName) {
     if (argc < 3) {
         OutputHelp();
         printf("Error: Not enough arguments provided.\n");
@@ -475,7 +6175,7 @@ bool ParseReadArgs(int argc, char** argv, char** inName) {
     return true;
 }
 
-bool ParseBatchArgs(int argc, char** argv, char** outName, char*** srcNames, int* srcCount) {
+static bool ParseBatchArgs(int argc, char** argv, char** outName, char*** srcNames, int* srcCount, Options* options) {
     if (argc < 4) {
         OutputHelp();
         printf("Error: Not enough arguments provided.\n");
@@ -484,8 +6184,85 @@ bool ParseBatchArgs(int argc, char** argv, char** outName, char*** srcNames, int
 
     *outName = argv[2];
     *srcNames = &argv[3];
-    *srcCount = argc - 3;
+    *srcCount = 0;
+    for (int i = 3; i < argc; ++i) {
+        if (strcmp(argv[i], kCompressArg) == 0) options->Flags |= OBJTOBIN_FLAG_COMPRESS;
+        else (*srcNames)[(*srcCount)++] = argv[i];
+    }
+    if (*srcCount == 0) {
+        printf("Error: No input binaries provided.\n");
+        return false;
+    }
+
+    return true;
+}
+
+// Returns the ObjToBinVertexComponents of an attribute set name, 0 if it is not one
+static unsigned int ParseAttributeSet(const char* name) {
+    for (unsigned int set = 0; set < 4; ++set) {
+        if (strcmp(name, kAttributeSetNames[set]) == 0) return OBJTOBIN_VERTEX_POSITION | set << 1;
+    }
+    printf("Error: %s is not an attribute set, use p, pt, pn or ptn.\n", name);
+    return 0;
+}
+
+static bool ParseGenerateArgs(int argc, char** argv, unsigned int* shape, size_t* triangles, char** objName, unsigned int* components, unsigned int* objects) {
+    if (argc < 5) {
+        OutputHelp();
+        printf("Error: Not enough arguments provided.\n");
+        return false;
+    }
+
+    *shape = 3;
+    for (unsigned int s = 0; s < 3; ++s) {
+        if (strcmp(argv[2], kShapeNames[s]) == 0) *shape = s;
+    }
+    long long count = atoll(argv[3]);
+    *objName = argv[4];
+    *components = argc > 5 ? ParseAttributeSet(argv[5]) : OBJTOBIN_VERTEX_POSITION | OBJTOBIN_VERTEX_TEXCOORDS | OBJTOBIN_VERTEX_NORMALS;
+    *objects = argc > 6 ? (unsigned int)atoi(argv[6]) : 1;
+    if (*shape > SHAPE_SOUP || count <= 0 || !*components || *objects == 0) {
+        printf("Error: Expected a shape of grid, sphere or soup, and a positive number of triangles and objects.\n");
+        return false;
+    }
+    *triangles = (size_t)count;
+    return true;
+}
+
+static bool ParseBenchmarkArgs(int argc, char** argv, char** resultsName, size_t* triangles, unsigned int* runs, Options* options) {
+    if (argc < 5) {
+        OutputHelp();
+        printf("Error: Not enough arguments provided.\n");
+        return false;
+    }
+
+    *resultsName = argv[2];
+    long long count = atoll(argv[3]);
+    int runCount = atoi(argv[4]);
+    if (count <= 0 || runCount <= 0) {
+        printf("Error: The number of triangles and runs must be positive.\n");
+        return false;
+    }
+    *triangles = (size_t)count;
+    *runs = (unsigned int)runCount;
+    ParseFlags(argc, argv, 5, options);
+    return true;
+}
+
+static bool ParseLoadBenchmarkArgs(int argc, char** argv, char** binName, unsigned int* runs) {
+    if (argc < 4) {
+        OutputHelp();
+        printf("Error: Not enough arguments provided.\n");
+        return false;
+    }
 
+    *binName = argv[2];
+    int runCount = atoi(argv[3]);
+    if (runCount <= 0) {
+        printf("Error: The number of runs must be positive.\n");
+        return false;
+    }
+    *runs = (unsigned int)runCount;
     return true;
 }
 
@@ -494,30 +6271,70 @@ int main(int argc, char** argv) {
         OutputHelp();
         return 0;
     }
+    Options options;
+    memset(&options, 0, sizeof(Options));
+    options.ThreadCount = 1;
     if (strcmp(argv[1], "-c") == 0) {
         char* inObjName;
         char* outBinName;
-        if (!ParseConvertArgs(argc, argv, &inObjName, &outBinName)) return false;
+        if (!ParseConvertArgs(argc, argv, &inObjName, &outBinName, &options)) return false;
         printf("Converting %s -> %s...\n", inObjName, outBinName);
-        bool success = Convert(inObjName, outBinName);
-        if (success) printf("Successfully converted.\n");
+        Arena arena = { 0 };
+        BatchJob job;
+        memset(&job, 0, sizeof(BatchJob));
+        job.Input = inObjName;
+        job.Output = outBinName;
+        job.Success = ConvertCached(inObjName, outBinName, &arena, &options, &job.Cached, &job.Stats);
+        ArenaFree(&arena);
+        bool success = job.Success;
+        bool cached = job.Cached;
+        if (g_StatsOutput) ReportStats(&job, 1);
+        if (cached) printf("Up to date in the cache.\n");
+        else if (success) printf("Successfully converted.\n");
         else printf("Failed to convert.\n");
         return success;
     }
+    else if (strcmp(argv[1], "-m") == 0) {
+        char* source;
+        if (!ParseManyArgs(argc, argv, &source, &options)) return false;
+        return ConvertMany(source, &options);
+    }
+    else if (strcmp(argv[1], "-g") == 0) {
+        unsigned int shape, components, objects;
+        size_t triangles;
+        char* objName;
+        if (!ParseGenerateArgs(argc, argv, &shape, &triangles, &objName, &components, &objects)) return false;
+        return GenerateObj(objName, shape, triangles, components, objects);
+    }
+    else if (strcmp(argv[1], "-k") == 0) {
+        char* resultsName;
+        size_t triangles;
+        unsigned int runs;
+        if (!ParseBenchmarkArgs(argc, argv, &resultsName, &triangles, &runs, &options)) return false;
+        return RunBenchmarks(resultsName, triangles, runs, &options);
+    }
+    else if (strcmp(argv[1], "-r") == 0) {
+        char* binName;
+        unsigned int runs;
+        if (!ParseLoadBenchmarkArgs(argc, argv, &binName, &runs)) return false;
+        return RunLoadBenchmark(binName, runs);
+    }
     else if (strcmp(argv[1], "-i") == 0) {
         char* inBinName;
         if (!ParseReadArgs(argc, argv, &inBinName)) return false;
         return ReadBinary(inBinName);
     }
     else if (strcmp(argv[1], "-b") == 0) {
-        char* inBinName;
+        char* outBinName;
         char** srcNames;
         int srcCount;
-        if (!ParseBatchArgs(argc, argv, &inBinName, &srcNames, &srcCount)) return false;
-        return BatchBinaries(inBinName, srcNames, srcCount);
+        if (!ParseBatchArgs(argc, argv, &outBinName, &srcNames, &srcCount, &options)) return false;
+        return BatchBinaries(outBinName, (const char* const*)srcNames, srcCount, &options);
     }
     else {
         OutputHelp();
         return 0;
     }
 }
+
+#endif
@@ -0,0 +1,103 @@
+/*
+Copyright 2020 Ralph Ridley
+
+Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated documentation files (the "Software"),
+to deal in the Software without restriction, including without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense,
+and/or sell copies of the Software, and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+// Library interface of the converter. Build objtobin.c with OBJTOBIN_NO_MAIN defined to leave out the command line
+// tool, as a static or shared library, and convert objs held in memory in to packs held in memory. Options take
+// the place of the tool's flags and every conversion only touches its converter, so each thread can convert at
+// once on a converter of its own.
+//
+//     ObjToBinConverter* converter = ObjToBinCreateConverter();
+//     ObjToBinOptions options = { OBJTOBIN_FLAG_OPTIMIZE | OBJTOBIN_FLAG_GENERATE_TANGENTS };
+//     ObjToBinOutput output = { NULL, 0, 0 };
+//     if (ObjToBinConvertMemory(converter, &options, objText, objSize, &output) == OBJTOBIN_OK) {
+//         ObjToBinPack pack;
+//         if (ObjToBinOpenMemory(&pack, output.Data, output.Size) == OBJTOBIN_OK) ...
+//     }
+//     ObjToBinDestroyConverter(converter);
+
+#ifndef OBJTOBIN_H
+#define OBJTOBIN_H
+
+#include "objtobin_loader.h"
+
+// Define as __declspec(dllexport) when building a Windows DLL, and __declspec(dllimport) when using one
+#ifndef OBJTOBIN_API
+#define OBJTOBIN_API
+#endif
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+enum ObjToBinFlags {
+    OBJTOBIN_FLAG_VERBOSE = 0x0002, // Print what each stage did, and the pack once written
+    OBJTOBIN_FLAG_GENERATE_TANGENTS = 0x0004, // -t
+    OBJTOBIN_FLAG_FLIP_TEXCOORD_V = 0x0008, // -f
+    OBJTOBIN_FLAG_OPTIMIZE = 0x0010, // -o
+    OBJTOBIN_FLAG_AUTO_INDEX_SIZE = 0x0020, // --index auto
+    OBJTOBIN_FLAG_PLANAR = 0x0040, // -p
+    OBJTOBIN_FLAG_MESHLETS = 0x0080, // --meshlets
+    OBJTOBIN_FLAG_COMPRESS = 0x0100, // -z
+    OBJTOBIN_FLAG_SHARED_VERTICES = 0x0200, // --shared
+    OBJTOBIN_FLAG_BVH = 0x0400 // --bvh
+};
+
+// Receives each message of a conversion, without a trailing newline, on the thread converting
+typedef void (*ObjToBinLog)(void* user, const char* message);
+
+// How to convert, a zeroed struct converts as the tool does without flags
+typedef struct ObjToBinOptions {
+    uint32_t Flags; // ObjToBinFlags
+    uint32_t ThreadCount; // Threads parsing the obj, 0 or 1 parses on the calling thread
+    uint32_t LodLevels; // Levels of detail generated for each mesh, up to 8
+    uint32_t PositionFormat; // ObjToBinAttributeFormat of each attribute
+    uint32_t TexcoordFormat;
+    uint32_t NormalFormat;
+    uint32_t TangentFormat;
+    float MinArea; // Triangles with less area than this, in the obj's units squared, are stripped
+    uint64_t StreamBudget; // Bytes, 0 converts in memory. Only files are streamed.
+    ObjToBinLog Log; // Errors, warnings and verbose output, NULL drops them. Nothing is printed.
+    void* LogUser; // Passed to Log
+} ObjToBinOptions;
+
+// Where a pack converted in memory goes. With Data NULL the pack is kept by the converter until its next
+// conversion and Data is set to it, so set Data back to NULL before converting in to the converter again.
+// Otherwise the pack is written to the Capacity bytes at Data. Size is set to the size of the pack.
+typedef struct ObjToBinOutput {
+    void* Data;
+    size_t Capacity;
+    size_t Size;
+} ObjToBinOutput;
+
+// Working memory kept between the conversions made with it, which must not overlap
+typedef struct ObjToBinConverter ObjToBinConverter;
+
+// Returns NULL if out of memory
+OBJTOBIN_API ObjToBinConverter* ObjToBinCreateConverter(void);
+OBJTOBIN_API void ObjToBinDestroyConverter(ObjToBinConverter* converter);
+
+// Converts the objSize bytes of obj text at obj in to a pack at output. Returns OBJTOBIN_OK or the ObjToBinResult of
+// the first error, which is also passed to Log. A pack too large for the caller's Data fails with
+// OBJTOBIN_ERROR_CAPACITY and Size set to the bytes it needs.
+OBJTOBIN_API int ObjToBinConvertMemory(ObjToBinConverter* converter, const ObjToBinOptions* options, const char* obj, size_t objSize,
+                                       ObjToBinOutput* output);
+
+// Converts the obj file objName in to the pack file binName, as the tool does. Returns as ObjToBinConvertMemory does.
+OBJTOBIN_API int ObjToBinConvertFile(ObjToBinConverter* converter, const ObjToBinOptions* options, const char* objName, const char* binName);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
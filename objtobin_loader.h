@@ -0,0 +1,770 @@
+/*
+Copyright 2020 Ralph Ridley
+
+Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated documentation files (the "Software"),
+to deal in the Software without restriction, including without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense,
+and/or sell copies of the Software, and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+// Header only loader for objtobin packs. The pack is memory mapped and every pointer handed back points straight
+// in to the mapping, so loading costs nothing but the page faults of the data that is actually touched. Packs
+// written with -z have their vertex and index sections decoded in to memory when opened, the rest stays mapped.
+// Every mesh of a pack written with --shared has the same vertex block, see ObjToBinSharesVertices.
+//
+//     ObjToBinPack pack;
+//     if (ObjToBinOpen(&pack, "mesh.bin") != OBJTOBIN_OK) ...
+//     for (uint32_t m = 0; m < pack.Header->MeshCount; ++m) {
+//         const ObjToBinMesh* mesh = ObjToBinGetMesh(&pack, m);
+//         upload(ObjToBinGetVertices(&pack, mesh), mesh->VertexCount * pack.Header->VertexSize);
+//         upload(ObjToBinGetIndices(&pack, mesh), mesh->IndexCount * mesh->IndexSize);
+//         for (uint32_t l = 0; l < mesh->LodCount; ++l) {
+//             const ObjToBinLod* lod = ObjToBinGetLod(&pack, mesh, l);
+//             upload(ObjToBinGetLodIndices(&pack, lod), lod->IndexCount * mesh->IndexSize);
+//         }
+//         for (uint32_t c = 0; c < mesh->MeshletCount; ++c) {
+//             const ObjToBinMeshlet* meshlet = ObjToBinGetMeshlet(&pack, mesh, c);
+//             cull(meshlet->Center, meshlet->Radius, meshlet->ConeApex, meshlet->ConeAxis, meshlet->ConeCutoff);
+//             draw(ObjToBinGetMeshletVertices(&pack, meshlet), ObjToBinGetMeshletTriangles(&pack, meshlet), meshlet->TriangleCount);
+//         }
+//         if (mesh->BvhNodeCount > 0) raycast(ObjToBinGetBvhNodes(&pack, mesh), ObjToBinGetBvhTriangles(&pack, mesh), mesh->BvhDepth);
+//     }
+//     ObjToBinClose(&pack);
+
+#ifndef OBJTOBIN_LOADER_H
+#define OBJTOBIN_LOADER_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef _WIN32
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#endif
+
+#define OBJTOBIN_MAGIC 0x4E49424Fu // "OBIN" in file byte order
+#define OBJTOBIN_VERSION 2
+#define OBJTOBIN_ALIGNMENT 64 // Every section starts on a multiple of this from the start of the file
+#define OBJTOBIN_VERTEX_GROUP 256 // Vertices byte transposed together in a compressed vertex block
+#define OBJTOBIN_EDGE_FIFO 32 // Recent edges a compressed triangle can name, a power of 2
+#define OBJTOBIN_MAX_LANES 16 // Most delta coded lanes in a row of vertex data
+
+enum ObjToBinVertexComponents {
+    OBJTOBIN_VERTEX_POSITION = 0x0001,
+    OBJTOBIN_VERTEX_TEXCOORDS = 0x0002,
+    OBJTOBIN_VERTEX_NORMALS = 0x0004,
+    OBJTOBIN_VERTEX_TANGENTS = 0x0008
+};
+
+// Encoding of a vertex attribute, Formats holds 4 bits per attribute in ObjToBinVertexComponents order
+enum ObjToBinAttributeFormat {
+    OBJTOBIN_FORMAT_FLOAT = 0, // 32-bit floats
+    OBJTOBIN_FORMAT_HALF = 1, // 16-bit IEEE half floats
+    OBJTOBIN_FORMAT_SNORM16 = 2, // 16-bit signed normalized
+    OBJTOBIN_FORMAT_UNORM16 = 3, // 16-bit unsigned normalized
+    OBJTOBIN_FORMAT_OCT16 = 4 // Unit vector octahedral encoded in to two snorm16s, tangents add a snorm16 handedness
+};
+
+// Arrangement of each mesh's vertex block
+enum ObjToBinVertexLayout {
+    OBJTOBIN_LAYOUT_INTERLEAVED = 0, // Whole vertices one after another
+    OBJTOBIN_LAYOUT_PLANAR = 1 // One array per attribute, each attribute padded to 4 bytes
+};
+
+enum ObjToBinSectionType {
+    OBJTOBIN_SECTION_MESHES = 1, // MeshCount records of MeshRecordSize bytes
+    OBJTOBIN_SECTION_VERTICES = 2, // TotalVertices * VertexSize bytes
+    OBJTOBIN_SECTION_INDICES = 3, // Each mesh's indices then those of its levels of detail, each padded to 4 bytes
+    OBJTOBIN_SECTION_LODS = 4, // ObjToBinLod records, only present if some mesh has levels of detail
+    OBJTOBIN_SECTION_MESHLETS = 5, // ObjToBinMeshlet records, only present if some mesh has meshlets
+    OBJTOBIN_SECTION_MESHLET_DATA = 6, // Vertex and triangle lists of every meshlet
+    OBJTOBIN_SECTION_COMPRESSED_VERTICES = 7, // Replaces OBJTOBIN_SECTION_VERTICES, an ObjToBinCompressed section
+    OBJTOBIN_SECTION_COMPRESSED_INDICES = 8, // Replaces OBJTOBIN_SECTION_INDICES, an ObjToBinCompressed section
+    OBJTOBIN_SECTION_BVH = 9 // Nodes then triangle list of each mesh's BVH, only present if some mesh has one
+};
+
+enum ObjToBinResult {
+    OBJTOBIN_OK = 0,
+    OBJTOBIN_ERROR_OPEN, // File could not be opened or mapped
+    OBJTOBIN_ERROR_FORMAT, // Not a pack, or a pre-v2 binary
+    OBJTOBIN_ERROR_VERSION, // Written by a newer, incompatible version
+    OBJTOBIN_ERROR_CORRUPT, // Sizes or offsets run past the end of the file
+    OBJTOBIN_ERROR_MEMORY, // Compressed sections could not be decoded in to memory, or a conversion ran out of memory
+    OBJTOBIN_ERROR_OBJ, // Conversions only, the obj has a malformed record
+    OBJTOBIN_ERROR_WRITE, // Conversions only, the pack could not be written
+    OBJTOBIN_ERROR_CAPACITY // Conversions only, the pack does not fit the caller's memory
+};
+
+// Starts the file. Fields are only ever added to the end, HeaderSize says how many a file has.
+typedef struct ObjToBinHeader {
+    uint32_t Magic;
+    uint32_t Version;
+    uint32_t HeaderSize;
+    uint32_t SectionCount;
+    uint64_t SectionTableOffset;
+    uint32_t MeshCount;
+    uint32_t MeshRecordSize; // Stride of the mesh records, newer versions may append fields to them
+    uint32_t VertexSize; // Num bytes making up a vertex, a multiple of 4
+    uint32_t IndexSize; // Num bytes making up the largest index of any mesh
+    uint32_t Components; // ObjToBinVertexComponents making up a vertex
+    uint32_t Formats; // ObjToBinAttributeFormat of each component
+    uint32_t Layout; // ObjToBinVertexLayout of the vertex data
+    uint32_t Reserved;
+    uint64_t TotalVertices;
+    uint64_t TotalIndices;
+} ObjToBinHeader;
+
+typedef struct ObjToBinSection {
+    uint32_t Type; // ObjToBinSectionType, unknown types are skipped
+    uint32_t Reserved;
+    uint64_t Offset; // From the start of the file, a multiple of OBJTOBIN_ALIGNMENT
+    uint64_t Size;
+} ObjToBinSection;
+
+typedef struct ObjToBinMesh {
+    uint64_t VertexOffset; // VertexSize offset in to the vertex section
+    uint64_t IndexOffset; // Byte offset in to the index section, always a multiple of 4
+    uint32_t VertexCount; // Number of vertices
+    uint32_t IndexCount; // Number of indices
+    uint32_t IndexSize; // Num bytes making up an index, indices are relative to VertexOffset
+    float PositionScale[3]; // Decoded position = encoded * scale + offset
+    float PositionOffset[3];
+    float TexcoordScale[2]; // Decoded texcoord = encoded * scale + offset
+    float TexcoordOffset[2];
+    uint32_t LodCount; // Simplified levels of detail after the full mesh, zero in packs written without them
+    uint32_t LodFirst; // First of the mesh's records in the LOD section, finest first
+    uint32_t MeshletCount; // Clusters of the full mesh, zero in packs written without them
+    uint32_t MeshletFirst; // First of the mesh's records in the meshlet section
+    uint32_t Reserved;
+    float BoundsMin[3]; // Box around the mesh's triangles, from its positions before they were encoded
+    float BoundsMax[3];
+    float Center[3]; // Bounding sphere of the mesh's triangles
+    float Radius;
+    uint64_t BvhOffset; // Byte offset in to the BVH section, always a multiple of 64
+    uint32_t BvhNodeCount; // Nodes of the mesh's triangle BVH, zero in packs written without them
+    uint32_t BvhDepth; // Most nodes on a path from the root, so the stack a traversal needs
+} ObjToBinMesh;
+
+// A simplified index buffer of a mesh, using the mesh's vertices and IndexSize
+typedef struct ObjToBinLod {
+    uint64_t IndexOffset; // Byte offset in to the index section, always a multiple of 4
+    uint32_t IndexCount;
+    float Error; // Furthest the simplified surface is expected to be from the full mesh, in the mesh's units
+} ObjToBinLod;
+
+// A cluster of up to 64 vertices and 124 triangles of a mesh, bounds are in the mesh's decoded units. The cluster
+// faces away from a camera at eye, so can be culled, if dot(normalize(ConeApex - eye), ConeAxis) >= ConeCutoff.
+typedef struct ObjToBinMeshlet {
+    uint64_t DataOffset; // Byte offset in to the meshlet data section, always a multiple of 4
+    uint32_t VertexCount; // uint32 vertices at DataOffset, relative to the mesh's VertexOffset
+    uint32_t TriangleCount; // Then 3 uint8 indices in to the meshlet's vertices per triangle
+    float Center[3]; // Bounding sphere
+    float Radius;
+    float ConeApex[3];
+    float ConeAxis[3];
+    float ConeCutoff; // 1 when the triangles face too many ways to ever be culled
+    uint32_t Reserved;
+} ObjToBinMeshlet;
+
+// A box of a mesh's triangle BVH, in the mesh's decoded units. The root is the mesh's first node and the two children
+// of an interior node are next to each other, sharing a 64 byte cache line. The second node is unused padding when
+// there is more than one. Leaves list their triangles in the triangle list after the mesh's
+// nodes, a uint32 per triangle numbering it in the mesh's index buffer, so triangle t is indices 3t to 3t + 2.
+typedef struct ObjToBinBvhNode {
+    float Min[3];
+    uint32_t First; // First child of an interior node, counted from the mesh's first node, or first triangle of a leaf
+    float Max[3];
+    uint32_t Count; // Triangles of a leaf, zero for interior nodes
+} ObjToBinBvhNode;
+
+// Starts a compressed section, followed by BlockCount ObjToBinBlocks then their encoded bytes
+typedef struct ObjToBinCompressed {
+    uint64_t DecodedSize; // Size of the raw section it replaces
+    uint32_t BlockCount; // One block per mesh
+    uint32_t Reserved;
+} ObjToBinCompressed;
+
+// The encoded vertices, or indices followed by those of its levels of detail, of a mesh. Vertices are zigzag delta
+// coded per lane of each attribute and byte transposed in groups of OBJTOBIN_VERTEX_GROUP, indices are coded a
+// triangle at a time against the edges of recent triangles. Either stream may then be LZ compressed.
+typedef struct ObjToBinBlock {
+    uint64_t Offset; // Byte offset in to the section
+    uint64_t Size; // Encoded bytes
+    uint64_t StreamSize; // Bytes before LZ compression, equal to Size if it was not applied
+} ObjToBinBlock;
+
+// An open pack, every pointer is in to the read only mapping and is valid until ObjToBinClose
+typedef struct ObjToBinPack {
+    const ObjToBinHeader* Header;
+    const ObjToBinSection* Sections;
+    const unsigned char* Meshes;
+    const unsigned char* Vertices;
+    const unsigned char* Indices;
+    const ObjToBinLod* Lods; // NULL if no mesh has levels of detail
+    uint64_t LodCount;
+    const ObjToBinMeshlet* Meshlets; // NULL if no mesh has meshlets
+    uint64_t MeshletCount;
+    const unsigned char* MeshletData;
+    const unsigned char* Bvh; // NULL if no mesh has a BVH
+    uint64_t IndexBytes; // Size of the index section
+    unsigned char* Decoded; // Vertices and indices decoded from compressed sections, NULL for raw packs
+    const unsigned char* Data;
+    uint64_t Size;
+    int Mapped; // Zero when opened from memory, which is left to the caller
+#ifdef _WIN32
+    HANDLE File;
+    HANDLE Mapping;
+#endif
+} ObjToBinPack;
+
+static inline const char* ObjToBinResultString(int result) {
+    switch (result) {
+    case OBJTOBIN_OK: return "ok";
+    case OBJTOBIN_ERROR_OPEN: return "the file could not be opened";
+    case OBJTOBIN_ERROR_FORMAT: return "the file is not an objtobin v2 pack";
+    case OBJTOBIN_ERROR_VERSION: return "the pack was written by a newer version";
+    case OBJTOBIN_ERROR_MEMORY: return "there was not enough memory";
+    case OBJTOBIN_ERROR_OBJ: return "the obj has a malformed record";
+    case OBJTOBIN_ERROR_WRITE: return "the pack could not be written";
+    case OBJTOBIN_ERROR_CAPACITY: return "the pack does not fit the memory given";
+    default: return "the pack is corrupt";
+    }
+}
+
+static inline void ObjToBinClose(ObjToBinPack* pack) {
+    free(pack->Decoded);
+#ifdef _WIN32
+    if (pack->Data && pack->Mapped) UnmapViewOfFile(pack->Data);
+    if (pack->Mapping) CloseHandle(pack->Mapping);
+    if (pack->File && pack->File != INVALID_HANDLE_VALUE) CloseHandle(pack->File);
+#else
+    if (pack->Data && pack->Mapped) munmap((void*)pack->Data, (size_t)pack->Size);
+#endif
+    memset(pack, 0, sizeof(ObjToBinPack));
+}
+
+// Returns the section of the given type, or NULL if the pack has none
+static inline const ObjToBinSection* ObjToBinFindSection(const ObjToBinPack* pack, uint32_t type) {
+    for (uint32_t s = 0; s < pack->Header->SectionCount; ++s) {
+        if (pack->Sections[s].Type == type) return &pack->Sections[s];
+    }
+    return NULL;
+}
+
+// Decoded size of a compressed section of the given type once its blocks are checked, UINT64_MAX if the pack has
+// none or it is corrupt
+static inline uint64_t ObjToBinGetDecodedSize(const ObjToBinPack* pack, uint32_t type) {
+    const ObjToBinSection* section = ObjToBinFindSection(pack, type);
+    if (!section || section->Size < sizeof(ObjToBinCompressed)) return UINT64_MAX;
+    const ObjToBinCompressed* compressed = (const ObjToBinCompressed*)(pack->Data + section->Offset);
+    if (compressed->BlockCount != pack->Header->MeshCount ||
+        compressed->BlockCount > (section->Size - sizeof(ObjToBinCompressed)) / sizeof(ObjToBinBlock)) {
+        return UINT64_MAX;
+    }
+    const ObjToBinBlock* blocks = (const ObjToBinBlock*)(compressed + 1);
+    for (uint32_t b = 0; b < compressed->BlockCount; ++b) {
+        if (blocks[b].Offset > section->Size || blocks[b].Size > section->Size - blocks[b].Offset || blocks[b].Size > blocks[b].StreamSize) {
+            return UINT64_MAX;
+        }
+    }
+    return compressed->DecodedSize;
+}
+
+// Splits a row of the given vertex components in to the lanes that are delta coded, 4 bytes for float attributes
+// and 2 for the rest, padded to 4 bytes. Returns the number of lanes and sets stride to the row's size.
+static inline uint32_t ObjToBinGetLanes(const ObjToBinHeader* header, uint32_t components, uint8_t* lanes, uint32_t* stride) {
+    uint32_t count = 0;
+    uint32_t bytes = 0;
+    for (uint32_t c = 0; c < 4; ++c) {
+        if (!(components & (1u << c))) continue;
+        uint32_t format = (header->Formats >> (c * 4)) & 0xF;
+        uint32_t floats = c == 1 ? 2 : c == 3 ? 4 : 3;
+        uint32_t size = format == OBJTOBIN_FORMAT_FLOAT ? floats * 4 : format == OBJTOBIN_FORMAT_OCT16 ? (floats == 4 ? 6 : 4) : floats * 2;
+        uint32_t width = format == OBJTOBIN_FORMAT_FLOAT ? 4 : 2;
+        for (uint32_t b = 0; b < size; b += width) lanes[count++] = (uint8_t)width;
+        bytes += size;
+    }
+    for (; bytes % 4 != 0; bytes += 2) lanes[count++] = 2;
+    *stride = bytes;
+    return count;
+}
+
+// Undoes the byte transposition and zigzag delta coding of count rows of a vertex plane, returns the end of src.
+// Each lane of a group is decoded in turn so its byte columns are read sequentially.
+static inline const uint8_t* ObjToBinDecodeVertexPlane(uint8_t* dst, const uint8_t* src, uint32_t count, const uint8_t* lanes, uint32_t laneCount, uint32_t stride) {
+    uint32_t previous[OBJTOBIN_MAX_LANES] = { 0 };
+    for (uint32_t first = 0; first < count; first += OBJTOBIN_VERTEX_GROUP) {
+        uint32_t rows = count - first < OBJTOBIN_VERTEX_GROUP ? count - first : OBJTOBIN_VERTEX_GROUP;
+        uint8_t* row = dst + (size_t)first * stride;
+        for (uint32_t l = 0; l < laneCount; ++l) {
+            uint32_t value = previous[l];
+            if (lanes[l] == 4) {
+                for (uint32_t r = 0; r < rows; ++r) {
+                    uint32_t zigzag = src[r] | (uint32_t)src[rows + r] << 8 | (uint32_t)src[rows * 2 + r] << 16 | (uint32_t)src[rows * 3 + r] << 24;
+                    value += (zigzag >> 1) ^ (0u - (zigzag & 1));
+                    memcpy(row + (size_t)r * stride, &value, 4);
+                }
+            }
+            else {
+                for (uint32_t r = 0; r < rows; ++r) {
+                    uint32_t zigzag = src[r] | (uint32_t)src[rows + r] << 8;
+                    value += (zigzag >> 1) ^ (0u - (zigzag & 1));
+                    uint16_t decoded = (uint16_t)value;
+                    memcpy(row + (size_t)r * stride, &decoded, 2);
+                }
+            }
+            previous[l] = value;
+            row += lanes[l];
+            src += (size_t)lanes[l] * rows;
+        }
+    }
+    return src;
+}
+
+// Decodes count vertices of the pack's layout from a stream of count * VertexSize bytes, returns 0 if the
+// attribute formats do not add up to VertexSize
+static inline int ObjToBinDecodeVertices(const ObjToBinHeader* header, uint8_t* dst, const uint8_t* src, uint32_t count) {
+    uint8_t lanes[OBJTOBIN_MAX_LANES];
+    uint32_t stride;
+    if (header->Layout != OBJTOBIN_LAYOUT_PLANAR) {
+        uint32_t laneCount = ObjToBinGetLanes(header, header->Components & 0xF, lanes, &stride);
+        if (stride != header->VertexSize) return 0;
+        ObjToBinDecodeVertexPlane(dst, src, count, lanes, laneCount, stride);
+        return 1;
+    }
+    uint32_t size = 0;
+    for (uint32_t component = OBJTOBIN_VERTEX_POSITION; component <= OBJTOBIN_VERTEX_TANGENTS; component <<= 1) {
+        if (!(header->Components & component)) continue;
+        uint32_t laneCount = ObjToBinGetLanes(header, component, lanes, &stride);
+        size += stride;
+        if (size > header->VertexSize) return 0;
+        src = ObjToBinDecodeVertexPlane(dst, src, count, lanes, laneCount, stride);
+        dst += (size_t)count * stride;
+    }
+    return size == header->VertexSize;
+}
+
+static inline int ObjToBinReadVarint(const uint8_t** src, const uint8_t* end, uint64_t* value) {
+    *value = 0;
+    for (uint32_t shift = 0; shift < 35 && *src < end; shift += 7) {
+        uint8_t byte = *(*src)++;
+        *value |= (uint64_t)(byte & 0x7F) << shift;
+        if (!(byte & 0x80)) return 1;
+    }
+    return 0;
+}
+
+// A vertex of a compressed triangle, 0 for the next unseen vertex or the zigzag delta from the last vertex plus 1
+static inline int ObjToBinReadVertexRef(const uint8_t** src, const uint8_t* end, uint32_t* next, uint32_t* last) {
+    uint64_t code;
+    if (*src < end && **src < 0x80) code = *(*src)++;
+    else if (!ObjToBinReadVarint(src, end, &code)) return 0;
+    uint32_t delta = (uint32_t)(code - 1);
+    *last = code == 0 ? *next : *last + ((delta >> 1) ^ (0u - (delta & 1)));
+    if (*last >= *next) *next = *last + 1;
+    return 1;
+}
+
+// Decodes count indices of indexSize bytes. Each triangle is a code byte, under OBJTOBIN_EDGE_FIFO * 3 for one
+// sharing the edge at code / 3 in the FIFO, most recent first, rotated by code % 3 followed by its third vertex, or
+// OBJTOBIN_EDGE_FIFO * 3 followed by all three. Returns the end of src, or NULL if it is corrupt.
+static inline const uint8_t* ObjToBinDecodeIndices(uint8_t* dst, uint32_t count, uint32_t indexSize, const uint8_t* src, const uint8_t* end) {
+    uint32_t edges[OBJTOBIN_EDGE_FIFO][2] = { { 0 } };
+    uint32_t head = 0;
+    uint32_t next = 0;
+    uint32_t last = 0;
+    uint32_t i = 0;
+    for (; i + 3 <= count; i += 3) {
+        if (src == end) return NULL;
+        uint32_t code = *src++;
+        uint32_t triangle[3];
+        if (code < OBJTOBIN_EDGE_FIFO * 3) {
+            const uint32_t* edge = edges[(head - 1 - code / 3) & (OBJTOBIN_EDGE_FIFO - 1)];
+            uint32_t rotation = code % 3;
+            if (!ObjToBinReadVertexRef(&src, end, &next, &last)) return NULL;
+            triangle[rotation] = edge[0];
+            triangle[(rotation + 1) % 3] = edge[1];
+            triangle[(rotation + 2) % 3] = last;
+        }
+        else if (code == OBJTOBIN_EDGE_FIFO * 3) {
+            for (uint32_t k = 0; k < 3; ++k) {
+                if (!ObjToBinReadVertexRef(&src, end, &next, &last)) return NULL;
+                triangle[k] = last;
+            }
+        }
+        else return NULL;
+        for (uint32_t k = 0; k < 3; ++k) {
+            // A neighbour with the same winding walks a shared edge the other way
+            uint32_t* pushed = edges[head++ & (OBJTOBIN_EDGE_FIFO - 1)];
+            pushed[0] = triangle[(k + 1) % 3];
+            pushed[1] = triangle[k];
+            if (indexSize == 2) {
+                uint16_t index16 = (uint16_t)triangle[k];
+                memcpy(dst + ((size_t)i + k) * 2, &index16, 2);
+            }
+            else memcpy(dst + ((size_t)i + k) * 4, &triangle[k], 4);
+        }
+    }
+    for (; i < count; ++i) {
+        if (!ObjToBinReadVertexRef(&src, end, &next, &last)) return NULL;
+        if (indexSize == 2) {
+            uint16_t index16 = (uint16_t)last;
+            memcpy(dst + (size_t)i * 2, &index16, 2);
+        }
+        else memcpy(dst + (size_t)i * 4, &last, 4);
+    }
+    return src;
+}
+
+// Decompresses an LZ stream of literal runs and matches in to exactly size bytes, returns 0 if it is corrupt. Each
+// sequence is a token of the literal length in the high nibble and the match length - 4 in the low, each extended by
+// bytes that add up while 255, then the literals and a 2 byte match offset. The last sequence has only literals.
+static inline int ObjToBinLzDecode(uint8_t* dst, uint64_t size, const uint8_t* src, uint64_t srcSize) {
+    const uint8_t* end = src + srcSize;
+    uint8_t* out = dst;
+    uint8_t* outEnd = dst + size;
+    while (src < end) {
+        uint32_t token = *src++;
+        uint64_t literals = token >> 4;
+        if (literals == 15) {
+            uint8_t byte;
+            do {
+                if (src == end) return 0;
+                byte = *src++;
+                literals += byte;
+            } while (byte == 255);
+        }
+        if (literals > (uint64_t)(end - src) || literals > (uint64_t)(outEnd - out)) return 0;
+        // Short runs are copied 16 bytes at a time when there is room to overrun, the next sequence overwrites it
+        if (literals <= 16 && end - src >= 16 && outEnd - out >= 16) memcpy(out, src, 16);
+        else memcpy(out, src, (size_t)literals);
+        out += literals;
+        src += literals;
+        if (src == end) break;
+
+        if (end - src < 2) return 0;
+        uint32_t offset = src[0] | (uint32_t)src[1] << 8;
+        src += 2;
+        uint64_t length = (token & 15) + 4;
+        if ((token & 15) == 15) {
+            uint8_t byte;
+            do {
+                if (src == end) return 0;
+                byte = *src++;
+                length += byte;
+            } while (byte == 255);
+        }
+        if (offset == 0 || offset > (uint64_t)(out - dst) || length > (uint64_t)(outEnd - out)) return 0;
+        const uint8_t* match = out - offset;
+        if (offset >= 16 && (uint64_t)(outEnd - out) >= length + 16) {
+            for (uint64_t k = 0; k < length; k += 16) memcpy(out + k, match + k, 16);
+        }
+        else if (offset >= length) memcpy(out, match, (size_t)length);
+        else if (offset == 1) memset(out, *match, (size_t)length);
+        else for (uint64_t k = 0; k < length; ++k) out[k] = match[k];
+        out += length;
+    }
+    return out == outEnd;
+}
+
+// True if mesh m uses the same vertices as the mesh before it, as every mesh of a pack converted with --shared does.
+// Its vertices are not repeated, and its block of a compressed vertex section is empty.
+static inline int ObjToBinSharesVertices(const ObjToBinPack* pack, uint32_t m) {
+    if (m == 0) return 0;
+    const ObjToBinMesh* mesh = (const ObjToBinMesh*)(pack->Meshes + (size_t)m * pack->Header->MeshRecordSize);
+    const ObjToBinMesh* previous = (const ObjToBinMesh*)(pack->Meshes + (size_t)(m - 1) * pack->Header->MeshRecordSize);
+    return mesh->VertexCount > 0 && mesh->VertexOffset == previous->VertexOffset && mesh->VertexCount == previous->VertexCount;
+}
+
+// Decodes the compressed vertex and index sections of a validated pack in to one allocation. Levels of detail are
+// decoded after their mesh's indices, padding is left zero. Sizes are checked against the mesh records first, so a
+// corrupt pack can not ask for more memory than a raw one would take.
+static inline int ObjToBinDecode(ObjToBinPack* pack, uint64_t vertexBytes, uint64_t indexBytes) {
+    const ObjToBinHeader* header = pack->Header;
+    const ObjToBinSection* sections[2] = { pack->Vertices ? NULL : ObjToBinFindSection(pack, OBJTOBIN_SECTION_COMPRESSED_VERTICES),
+                                           pack->Indices ? NULL : ObjToBinFindSection(pack, OBJTOBIN_SECTION_COMPRESSED_INDICES) };
+    uint64_t indexEnd = 0;
+    uint64_t maxStream = 0;
+    for (uint32_t m = 0; m < header->MeshCount; ++m) {
+        const ObjToBinMesh* mesh = (const ObjToBinMesh*)(pack->Meshes + (size_t)m * header->MeshRecordSize);
+        uint64_t end = mesh->IndexOffset + (uint64_t)mesh->IndexCount * mesh->IndexSize;
+        uint64_t indexCount = mesh->IndexCount;
+        for (uint32_t l = mesh->LodFirst; l < mesh->LodFirst + mesh->LodCount; ++l) {
+            uint64_t lodEnd = pack->Lods[l].IndexOffset + (uint64_t)pack->Lods[l].IndexCount * mesh->IndexSize;
+            if (lodEnd > end) end = lodEnd;
+            indexCount += pack->Lods[l].IndexCount;
+        }
+        if (end > indexEnd) indexEnd = end;
+        // Vertex streams are the size of the block, index streams take at most 5 bytes an index and 1 a triangle
+        const ObjToBinBlock* blocks[2];
+        for (int s = 0; s < 2; ++s) {
+            blocks[s] = sections[s] ? (const ObjToBinBlock*)(pack->Data + sections[s]->Offset + sizeof(ObjToBinCompressed)) + m : NULL;
+            if (blocks[s] && blocks[s]->Size < blocks[s]->StreamSize && blocks[s]->StreamSize > maxStream) maxStream = blocks[s]->StreamSize;
+        }
+        uint64_t vertexStream = ObjToBinSharesVertices(pack, m) ? 0 : (uint64_t)mesh->VertexCount * header->VertexSize;
+        if ((blocks[0] && blocks[0]->StreamSize != vertexStream) ||
+            (blocks[1] && blocks[1]->StreamSize > indexCount * 6)) {
+            return OBJTOBIN_ERROR_CORRUPT;
+        }
+    }
+    if ((sections[0] && vertexBytes != header->TotalVertices * header->VertexSize) || (sections[1] && indexBytes > ((indexEnd + 3) & ~(uint64_t)3))) {
+        return OBJTOBIN_ERROR_CORRUPT;
+    }
+    uint64_t size = (sections[0] ? vertexBytes : 0) + (sections[1] ? indexBytes : 0);
+    if (size + maxStream + 1 > SIZE_MAX) return OBJTOBIN_ERROR_MEMORY;
+    pack->Decoded = (unsigned char*)calloc(1, (size_t)(size + 1));
+    uint8_t* stream = maxStream > 0 ? (uint8_t*)malloc((size_t)maxStream) : NULL;
+    if (!pack->Decoded || (maxStream > 0 && !stream)) {
+        free(stream);
+        return OBJTOBIN_ERROR_MEMORY;
+    }
+    if (sections[0]) pack->Vertices = pack->Decoded;
+    if (sections[1]) pack->Indices = pack->Decoded + (sections[0] ? vertexBytes : 0);
+
+    int result = OBJTOBIN_OK;
+    for (int s = 0; s < 2 && result == OBJTOBIN_OK; ++s) {
+        if (!sections[s]) continue;
+        const unsigned char* base = pack->Data + sections[s]->Offset;
+        const ObjToBinBlock* blocks = (const ObjToBinBlock*)(base + sizeof(ObjToBinCompressed));
+        for (uint32_t m = 0; m < header->MeshCount && result == OBJTOBIN_OK; ++m) {
+            const ObjToBinBlock* block = &blocks[m];
+            const ObjToBinMesh* mesh = (const ObjToBinMesh*)(pack->Meshes + (size_t)m * header->MeshRecordSize);
+            const uint8_t* src = base + block->Offset;
+            if (block->Size < block->StreamSize) {
+                if (!ObjToBinLzDecode(stream, block->StreamSize, src, block->Size)) result = OBJTOBIN_ERROR_CORRUPT;
+                src = stream;
+            }
+            if (result != OBJTOBIN_OK) break;
+            if (s == 0) {
+                if (block->StreamSize > 0 && !ObjToBinDecodeVertices(header, pack->Decoded + mesh->VertexOffset * header->VertexSize, src, mesh->VertexCount)) {
+                    result = OBJTOBIN_ERROR_CORRUPT;
+                }
+                continue;
+            }
+            const uint8_t* end = src + block->StreamSize;
+            uint8_t* indices = (uint8_t*)pack->Indices;
+            src = ObjToBinDecodeIndices(indices + mesh->IndexOffset, mesh->IndexCount, mesh->IndexSize, src, end);
+            for (uint32_t l = mesh->LodFirst; src && l < mesh->LodFirst + mesh->LodCount; ++l) {
+                src = ObjToBinDecodeIndices(indices + pack->Lods[l].IndexOffset, pack->Lods[l].IndexCount, mesh->IndexSize, src, end);
+            }
+            if (src != end) result = OBJTOBIN_ERROR_CORRUPT;
+        }
+    }
+    free(stream);
+    return result;
+}
+
+// Checks a mapped pack fits in size bytes and sets up the section pointers, decoding any compressed sections
+static inline int ObjToBinValidate(ObjToBinPack* pack) {
+    const ObjToBinHeader* header = (const ObjToBinHeader*)pack->Data;
+    if (pack->Size < sizeof(ObjToBinHeader) || header->Magic != OBJTOBIN_MAGIC) return OBJTOBIN_ERROR_FORMAT;
+    if (header->Version != OBJTOBIN_VERSION) return OBJTOBIN_ERROR_VERSION;
+    // Records before levels of detail end at LodFirst, their LodCount was reserved and is always zero
+    if (header->HeaderSize < sizeof(ObjToBinHeader) || header->MeshRecordSize < offsetof(ObjToBinMesh, LodFirst) ||
+        header->SectionTableOffset % 8 != 0 || header->SectionTableOffset > pack->Size ||
+        header->SectionCount > (pack->Size - header->SectionTableOffset) / sizeof(ObjToBinSection)) {
+        return OBJTOBIN_ERROR_CORRUPT;
+    }
+    pack->Header = header;
+    pack->Sections = (const ObjToBinSection*)(pack->Data + header->SectionTableOffset);
+    for (uint32_t s = 0; s < header->SectionCount; ++s) {
+        const ObjToBinSection* section = &pack->Sections[s];
+        if (section->Offset % OBJTOBIN_ALIGNMENT != 0 || section->Offset > pack->Size || section->Size > pack->Size - section->Offset) {
+            return OBJTOBIN_ERROR_CORRUPT;
+        }
+    }
+
+    const ObjToBinSection* meshes = ObjToBinFindSection(pack, OBJTOBIN_SECTION_MESHES);
+    const ObjToBinSection* vertices = ObjToBinFindSection(pack, OBJTOBIN_SECTION_VERTICES);
+    const ObjToBinSection* indices = ObjToBinFindSection(pack, OBJTOBIN_SECTION_INDICES);
+    uint64_t vertexBytes = vertices ? vertices->Size : ObjToBinGetDecodedSize(pack, OBJTOBIN_SECTION_COMPRESSED_VERTICES);
+    uint64_t indexBytes = indices ? indices->Size : ObjToBinGetDecodedSize(pack, OBJTOBIN_SECTION_COMPRESSED_INDICES);
+    if (!meshes || vertexBytes == UINT64_MAX || indexBytes == UINT64_MAX || meshes->Size / header->MeshRecordSize < header->MeshCount ||
+        (header->VertexSize && vertexBytes / header->VertexSize < header->TotalVertices)) {
+        return OBJTOBIN_ERROR_CORRUPT;
+    }
+    pack->Meshes = pack->Data + meshes->Offset;
+    if (vertices) pack->Vertices = pack->Data + vertices->Offset;
+    if (indices) pack->Indices = pack->Data + indices->Offset;
+    pack->IndexBytes = indexBytes;
+    const ObjToBinSection* lods = ObjToBinFindSection(pack, OBJTOBIN_SECTION_LODS);
+    if (lods) {
+        if (lods->Size % sizeof(ObjToBinLod) != 0) return OBJTOBIN_ERROR_CORRUPT;
+        pack->Lods = (const ObjToBinLod*)(pack->Data + lods->Offset);
+        pack->LodCount = lods->Size / sizeof(ObjToBinLod);
+    }
+    const ObjToBinSection* meshlets = ObjToBinFindSection(pack, OBJTOBIN_SECTION_MESHLETS);
+    const ObjToBinSection* meshletData = ObjToBinFindSection(pack, OBJTOBIN_SECTION_MESHLET_DATA);
+    if (meshlets) {
+        if (!meshletData || meshlets->Size % sizeof(ObjToBinMeshlet) != 0) return OBJTOBIN_ERROR_CORRUPT;
+        pack->Meshlets = (const ObjToBinMeshlet*)(pack->Data + meshlets->Offset);
+        pack->MeshletCount = meshlets->Size / sizeof(ObjToBinMeshlet);
+        pack->MeshletData = pack->Data + meshletData->Offset;
+    }
+    const ObjToBinSection* bvh = ObjToBinFindSection(pack, OBJTOBIN_SECTION_BVH);
+    if (bvh) pack->Bvh = pack->Data + bvh->Offset;
+    for (uint32_t m = 0; m < header->MeshCount; ++m) {
+        const ObjToBinMesh* mesh = (const ObjToBinMesh*)(pack->Meshes + (size_t)m * header->MeshRecordSize);
+        if (mesh->VertexOffset > header->TotalVertices || mesh->VertexCount > header->TotalVertices - mesh->VertexOffset ||
+            (mesh->IndexSize != 2 && mesh->IndexSize != 4) || mesh->IndexOffset > indexBytes ||
+            (uint64_t)mesh->IndexCount * mesh->IndexSize > indexBytes - mesh->IndexOffset) {
+            return OBJTOBIN_ERROR_CORRUPT;
+        }
+        if (mesh->LodCount > 0 && (header->MeshRecordSize < offsetof(ObjToBinMesh, MeshletCount) || mesh->LodFirst > pack->LodCount ||
+                                   mesh->LodCount > pack->LodCount - mesh->LodFirst)) {
+            return OBJTOBIN_ERROR_CORRUPT;
+        }
+        for (uint32_t l = mesh->LodFirst; l < mesh->LodFirst + mesh->LodCount; ++l) {
+            const ObjToBinLod* lod = &pack->Lods[l];
+            if (lod->IndexOffset % 4 != 0 || lod->IndexOffset > indexBytes ||
+                (uint64_t)lod->IndexCount * mesh->IndexSize > indexBytes - lod->IndexOffset) {
+                return OBJTOBIN_ERROR_CORRUPT;
+            }
+        }
+        // Records before meshlets end at MeshletFirst, their MeshletCount was reserved and is always zero
+        if (mesh->MeshletCount > 0 && (header->MeshRecordSize < offsetof(ObjToBinMesh, Reserved) || mesh->MeshletFirst > pack->MeshletCount ||
+                                       mesh->MeshletCount > pack->MeshletCount - mesh->MeshletFirst)) {
+            return OBJTOBIN_ERROR_CORRUPT;
+        }
+        for (uint32_t c = mesh->MeshletFirst; c < mesh->MeshletFirst + mesh->MeshletCount; ++c) {
+            const ObjToBinMeshlet* meshlet = &pack->Meshlets[c];
+            if (meshlet->DataOffset % 4 != 0 || meshlet->DataOffset > meshletData->Size ||
+                (uint64_t)meshlet->VertexCount * 4 + (uint64_t)meshlet->TriangleCount * 3 > meshletData->Size - meshlet->DataOffset) {
+                return OBJTOBIN_ERROR_CORRUPT;
+            }
+        }
+        // Records before bounds end at BoundsMin, and never have a BVH
+        if (header->MeshRecordSize >= sizeof(ObjToBinMesh) && mesh->BvhNodeCount > 0) {
+            uint64_t nodeBytes = (uint64_t)mesh->BvhNodeCount * sizeof(ObjToBinBvhNode);
+            uint32_t triangles = mesh->IndexCount / 3;
+            if (!bvh || mesh->BvhOffset % 64 != 0 || mesh->BvhOffset > bvh->Size ||
+                nodeBytes + (uint64_t)triangles * 4 > bvh->Size - mesh->BvhOffset) {
+                return OBJTOBIN_ERROR_CORRUPT;
+            }
+            const ObjToBinBvhNode* nodes = (const ObjToBinBvhNode*)(pack->Bvh + mesh->BvhOffset);
+            // Children always follow their parent, so a traversal can not loop. Node 1 is padding.
+            for (uint32_t n = 0; n < mesh->BvhNodeCount; ++n) {
+                if (n != 1 && (nodes[n].Count > 0 ? nodes[n].First > triangles || nodes[n].Count > triangles - nodes[n].First
+                                                  : nodes[n].First <= n || nodes[n].First >= mesh->BvhNodeCount - 1)) {
+                    return OBJTOBIN_ERROR_CORRUPT;
+                }
+            }
+            const uint32_t* list = (const uint32_t*)(nodes + mesh->BvhNodeCount);
+            for (uint32_t t = 0; t < triangles; ++t) {
+                if (list[t] >= triangles) return OBJTOBIN_ERROR_CORRUPT;
+            }
+        }
+    }
+    return vertices && indices ? OBJTOBIN_OK : ObjToBinDecode(pack, vertexBytes, indexBytes);
+}
+
+// Maps the pack at path read only and validates it, the pack is left closed on failure
+static inline int ObjToBinOpen(ObjToBinPack* pack, const char* path) {
+    memset(pack, 0, sizeof(ObjToBinPack));
+#ifdef _WIN32
+    LARGE_INTEGER size;
+    pack->File = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+    if (pack->File == INVALID_HANDLE_VALUE || !GetFileSizeEx(pack->File, &size) || size.QuadPart == 0) {
+        ObjToBinClose(pack);
+        return OBJTOBIN_ERROR_OPEN;
+    }
+    pack->Size = (uint64_t)size.QuadPart;
+    pack->Mapping = CreateFileMappingA(pack->File, NULL, PAGE_READONLY, 0, 0, NULL);
+    pack->Data = pack->Mapping ? (const unsigned char*)MapViewOfFile(pack->Mapping, FILE_MAP_READ, 0, 0, 0) : NULL;
+#else
+    struct stat info;
+    int fd = open(path, O_RDONLY);
+    if (fd < 0 || fstat(fd, &info) != 0 || info.st_size == 0) {
+        if (fd >= 0) close(fd);
+        return OBJTOBIN_ERROR_OPEN;
+    }
+    pack->Size = (uint64_t)info.st_size;
+    void* data = mmap(NULL, (size_t)pack->Size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    pack->Data = data == MAP_FAILED ? NULL : (const unsigned char*)data;
+#endif
+    if (!pack->Data) {
+        ObjToBinClose(pack);
+        return OBJTOBIN_ERROR_OPEN;
+    }
+    pack->Mapped = 1;
+    int result = ObjToBinValidate(pack);
+    if (result != OBJTOBIN_OK) ObjToBinClose(pack);
+    return result;
+}
+
+// Validates the pack of size bytes at data, which must be 8 byte aligned and stay valid until ObjToBinClose.
+// The pack is left closed on failure.
+static inline int ObjToBinOpenMemory(ObjToBinPack* pack, const void* data, size_t size) {
+    memset(pack, 0, sizeof(ObjToBinPack));
+    if (!data || size == 0 || (uintptr_t)data % 8 != 0) return OBJTOBIN_ERROR_OPEN;
+    pack->Data = (const unsigned char*)data;
+    pack->Size = size;
+    int result = ObjToBinValidate(pack);
+    if (result != OBJTOBIN_OK) ObjToBinClose(pack);
+    return result;
+}
+
+static inline const ObjToBinMesh* ObjToBinGetMesh(const ObjToBinPack* pack, uint32_t m) {
+    return (const ObjToBinMesh*)(pack->Meshes + (size_t)m * pack->Header->MeshRecordSize);
+}
+
+// Start of a mesh's vertex block, VertexCount * VertexSize bytes in the pack's Layout
+static inline const void* ObjToBinGetVertices(const ObjToBinPack* pack, const ObjToBinMesh* mesh) {
+    return pack->Vertices + mesh->VertexOffset * pack->Header->VertexSize;
+}
+
+// Start of a mesh's indices, IndexCount indices of IndexSize bytes relative to the mesh's vertices
+static inline const void* ObjToBinGetIndices(const ObjToBinPack* pack, const ObjToBinMesh* mesh) {
+    return pack->Indices + mesh->IndexOffset;
+}
+
+// Level of detail level of a mesh, 0 being the first simplification, for level < mesh->LodCount
+static inline const ObjToBinLod* ObjToBinGetLod(const ObjToBinPack* pack, const ObjToBinMesh* mesh, uint32_t level) {
+    return &pack->Lods[mesh->LodFirst + level];
+}
+
+// Start of a level of detail's indices, IndexCount indices of the mesh's IndexSize relative to the mesh's vertices
+static inline const void* ObjToBinGetLodIndices(const ObjToBinPack* pack, const ObjToBinLod* lod) {
+    return pack->Indices + lod->IndexOffset;
+}
+
+static inline const ObjToBinMeshlet* ObjToBinGetMeshlet(const ObjToBinPack* pack, const ObjToBinMesh* mesh, uint32_t meshlet) {
+    return &pack->Meshlets[mesh->MeshletFirst + meshlet];
+}
+
+// Vertices of a meshlet, VertexCount indices relative to the mesh's vertices
+static inline const uint32_t* ObjToBinGetMeshletVertices(const ObjToBinPack* pack, const ObjToBinMeshlet* meshlet) {
+    return (const uint32_t*)(pack->MeshletData + meshlet->DataOffset);
+}
+
+// Triangles of a meshlet, TriangleCount * 3 indices in to the meshlet's vertices
+static inline const uint8_t* ObjToBinGetMeshletTriangles(const ObjToBinPack* pack, const ObjToBinMeshlet* meshlet) {
+    return pack->MeshletData + meshlet->DataOffset + meshlet->VertexCount * 4;
+}
+
+// BvhNodeCount nodes of a mesh's BVH, the root first
+static inline const ObjToBinBvhNode* ObjToBinGetBvhNodes(const ObjToBinPack* pack, const ObjToBinMesh* mesh) {
+    return (const ObjToBinBvhNode*)(pack->Bvh + mesh->BvhOffset);
+}
+
+// Triangle list of a mesh's BVH, IndexCount / 3 triangles the leaves index in to
+static inline const uint32_t* ObjToBinGetBvhTriangles(const ObjToBinPack* pack, const ObjToBinMesh* mesh) {
+    return (const uint32_t*)(pack->Bvh + mesh->BvhOffset + (uint64_t)mesh->BvhNodeCount * sizeof(ObjToBinBvhNode));
+}
+
+#endif
@@ -0,0 +1,789 @@
+/*
+Copyright 2020 Ralph Ridley
+
+Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated documentation files (the "Software"),
+to deal in the Software without restriction, including without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense,
+and/or sell copies of the Software, and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+// Header only streaming loader for objtobin packs, for making meshes resident one at a time rather than a pack at
+// once. Opening a pack reads only its header, section table, mesh records, levels of detail and compressed block
+// tables. The vertices and indices of a mesh are then read asynchronously on request, straight in to buffers the
+// caller supplies, through io_uring on Linux or a pool of threads where it is not available. Blocks of compressed
+// packs are read in to memory of their own and decoded in to the caller's buffers. Meshlets and BVHs are left to
+// ObjToBinOpen.
+//
+// A request's callback runs on the thread calling ObjToBinStreamPoll once everything it asked for has loaded. Up to
+// OBJTOBIN_STREAM_DEPTH requests are read at once, the rest are queued. Loads are read before any prefetch, so
+// meshes that may be needed soon can be queued without holding up those needed now.
+//
+//     ObjToBinStream stream;
+//     if (ObjToBinStreamOpen(&stream, "world.bin", OBJTOBIN_STREAM_AUTO) != OBJTOBIN_OK) ...
+//     const ObjToBinMesh* mesh = ObjToBinStreamGetMesh(&stream, m);
+//     ObjToBinStreamRequest request = { m, vertexBuffer, indexBuffer, OnMeshLoaded, user };
+//     ObjToBinStreamLoad(&stream, &request); // Buffers of ObjToBinStreamVertexBytes and ObjToBinStreamIndexBytes
+//     ...
+//     ObjToBinStreamPoll(&stream, 0); // Once a frame, calls OnMeshLoaded(user, m, result) for each loaded mesh
+//     ObjToBinStreamClose(&stream);
+//
+// Needs pread and syscall, so define _GNU_SOURCE (or _POSIX_C_SOURCE 200809L off Linux) when compiling as strict
+// c99, and link with -pthread. Define OBJTOBIN_NO_IO_URING to always use the pool of threads.
+
+#ifndef OBJTOBIN_STREAM_H
+#define OBJTOBIN_STREAM_H
+
+#include "objtobin_loader.h"
+
+#ifndef _WIN32
+#include <errno.h>
+#include <pthread.h>
+#include <sys/uio.h>
+#if defined(__linux__) && !defined(OBJTOBIN_NO_IO_URING) && defined(__has_include)
+#if __has_include(<linux/io_uring.h>)
+#define OBJTOBIN_IO_URING
+#include <linux/io_uring.h>
+#include <sys/syscall.h>
+#endif
+#endif
+#endif
+
+#define OBJTOBIN_STREAM_DEPTH 64 // Requests read at once
+#define OBJTOBIN_STREAM_READERS 4 // Readers of the pool used without io_uring
+#define OBJTOBIN_STREAM_MAX_READ 0x40000000u // Largest single read, larger parts are read in pieces
+
+enum ObjToBinStreamBackend {
+    OBJTOBIN_STREAM_AUTO = 0, // io_uring if the kernel allows it, otherwise threads
+    OBJTOBIN_STREAM_IO_URING = 1, // Fails to open if io_uring is not available
+    OBJTOBIN_STREAM_THREADS = 2
+};
+
+// Called with the mesh of a request and its ObjToBinResult, OBJTOBIN_OK once its buffers are filled
+typedef void (*ObjToBinStreamCallback)(void* user, uint32_t mesh, int result);
+
+typedef struct ObjToBinStreamRequest {
+    uint32_t Mesh;
+    void* Vertices; // ObjToBinStreamVertexBytes bytes, or NULL to leave the vertices out
+    void* Indices; // ObjToBinStreamIndexBytes bytes, or NULL to leave the indices out
+    ObjToBinStreamCallback Callback; // May be NULL
+    void* User;
+} ObjToBinStreamRequest;
+
+// A request being read, part 0 is its vertices and part 1 its indices
+typedef struct ObjToBinStreamOp {
+    ObjToBinStreamRequest Request;
+    unsigned char* Dst[2]; // The caller's buffer, or Encoded
+    unsigned char* Encoded[2]; // Compressed blocks, decoded in to the caller's buffers once read
+    uint64_t Offset[2]; // In the file
+    uint64_t Size[2];
+    uint64_t Done[2];
+    uint32_t Block[2]; // Compressed block of each part
+    uint32_t Parts; // Parts still being read
+    int Result;
+#ifdef OBJTOBIN_IO_URING
+    struct iovec Iov[2];
+#endif
+} ObjToBinStreamOp;
+
+// Growable ring of requests waiting to be read
+typedef struct ObjToBinStreamQueue {
+    ObjToBinStreamRequest* Items;
+    uint32_t Head;
+    uint32_t Count;
+    uint32_t Capacity;
+} ObjToBinStreamQueue;
+
+#ifdef _WIN32
+typedef HANDLE ObjToBinFile;
+typedef CRITICAL_SECTION ObjToBinMutex;
+typedef CONDITION_VARIABLE ObjToBinCond;
+typedef HANDLE ObjToBinThread;
+#else
+typedef int ObjToBinFile;
+typedef pthread_mutex_t ObjToBinMutex;
+typedef pthread_cond_t ObjToBinCond;
+typedef pthread_t ObjToBinThread;
+#endif
+
+#ifdef OBJTOBIN_IO_URING
+typedef struct ObjToBinRing {
+    int Fd;
+    void* SqMap;
+    size_t SqMapSize;
+    void* CqMap; // Same as SqMap when the kernel maps both rings together
+    size_t CqMapSize;
+    struct io_uring_sqe* Sqes;
+    size_t SqesSize;
+    uint32_t* SqHead;
+    uint32_t* SqTail;
+    uint32_t* SqArray;
+    uint32_t SqMask;
+    uint32_t* CqHead;
+    uint32_t* CqTail;
+    struct io_uring_cqe* Cqes;
+    uint32_t CqMask;
+    uint32_t Queued; // Entries written but not yet submitted
+} ObjToBinRing;
+#endif
+
+// An open pack being streamed, it must not be moved while open as its readers point at it
+typedef struct ObjToBinStream {
+    ObjToBinHeader Header;
+    unsigned char* Meshes; // MeshCount records of MeshRecordSize bytes
+    ObjToBinLod* Lods; // NULL if no mesh has levels of detail
+    uint64_t LodCount;
+    uint64_t SectionOffsets[2]; // Of the vertex and index sections, raw or compressed
+    ObjToBinBlock* Blocks[2]; // Of the compressed vertex and index sections, NULL for raw sections
+    uint64_t Size;
+    int Backend; // ObjToBinStreamBackend in use
+    ObjToBinFile File;
+    ObjToBinStreamQueue Loads;
+    ObjToBinStreamQueue Prefetches;
+    ObjToBinStreamOp Ops[OBJTOBIN_STREAM_DEPTH];
+    uint32_t FreeOps[OBJTOBIN_STREAM_DEPTH];
+    uint32_t FreeCount;
+    uint32_t Reading; // Ops taken from FreeOps and not yet completed
+    // Ops read by the pool of threads, and ops completed by either backend waiting for their callbacks
+    uint32_t Work[OBJTOBIN_STREAM_DEPTH];
+    uint32_t WorkHead;
+    uint32_t WorkCount;
+    uint32_t Completed[OBJTOBIN_STREAM_DEPTH];
+    uint32_t CompletedCount;
+    int Stop;
+    ObjToBinMutex Lock;
+    ObjToBinCond WorkReady;
+    ObjToBinCond WorkDone;
+    ObjToBinThread Threads[OBJTOBIN_STREAM_READERS];
+    uint32_t ThreadCount;
+#ifdef OBJTOBIN_IO_URING
+    ObjToBinRing Ring;
+#endif
+} ObjToBinStream;
+
+#ifdef _WIN32
+static inline void ObjToBinMutexInit(ObjToBinMutex* mutex) { InitializeCriticalSection(mutex); }
+static inline void ObjToBinMutexDestroy(ObjToBinMutex* mutex) { DeleteCriticalSection(mutex); }
+static inline void ObjToBinMutexLock(ObjToBinMutex* mutex) { EnterCriticalSection(mutex); }
+static inline void ObjToBinMutexUnlock(ObjToBinMutex* mutex) { LeaveCriticalSection(mutex); }
+static inline void ObjToBinCondInit(ObjToBinCond* cond) { InitializeConditionVariable(cond); }
+static inline void ObjToBinCondDestroy(ObjToBinCond* cond) { (void)cond; }
+static inline void ObjToBinCondWait(ObjToBinCond* cond, ObjToBinMutex* mutex) { SleepConditionVariableCS(cond, mutex, INFINITE); }
+static inline void ObjToBinCondSignal(ObjToBinCond* cond) { WakeConditionVariable(cond); }
+static inline void ObjToBinCondBroadcast(ObjToBinCond* cond) { WakeAllConditionVariable(cond); }
+#else
+static inline void ObjToBinMutexInit(ObjToBinMutex* mutex) { pthread_mutex_init(mutex, NULL); }
+static inline void ObjToBinMutexDestroy(ObjToBinMutex* mutex) { pthread_mutex_destroy(mutex); }
+static inline void ObjToBinMutexLock(ObjToBinMutex* mutex) { pthread_mutex_lock(mutex); }
+static inline void ObjToBinMutexUnlock(ObjToBinMutex* mutex) { pthread_mutex_unlock(mutex); }
+static inline void ObjToBinCondInit(ObjToBinCond* cond) { pthread_cond_init(cond, NULL); }
+static inline void ObjToBinCondDestroy(ObjToBinCond* cond) { pthread_cond_destroy(cond); }
+static inline void ObjToBinCondWait(ObjToBinCond* cond, ObjToBinMutex* mutex) { pthread_cond_wait(cond, mutex); }
+static inline void ObjToBinCondSignal(ObjToBinCond* cond) { pthread_cond_signal(cond); }
+static inline void ObjToBinCondBroadcast(ObjToBinCond* cond) { pthread_cond_broadcast(cond); }
+#endif
+
+// Reads up to size bytes at offset in to dst, returns the bytes read which are fewer only at the end of the file
+// or on an error
+static inline uint64_t ObjToBinReadAt(ObjToBinFile file, void* dst, uint64_t size, uint64_t offset) {
+    uint64_t done = 0;
+    while (done < size) {
+        uint32_t chunk = size - done < OBJTOBIN_STREAM_MAX_READ ? (uint32_t)(size - done) : OBJTOBIN_STREAM_MAX_READ;
+#ifdef _WIN32
+        OVERLAPPED overlapped;
+        memset(&overlapped, 0, sizeof(OVERLAPPED));
+        overlapped.Offset = (DWORD)(offset + done);
+        overlapped.OffsetHigh = (DWORD)((offset + done) >> 32);
+        DWORD count = 0;
+        if (!ReadFile(file, (unsigned char*)dst + done, chunk, &count, &overlapped) || count == 0) break;
+#else
+        ssize_t count = pread(file, (unsigned char*)dst + done, chunk, (off_t)(offset + done));
+        if (count < 0 && errno == EINTR) continue;
+        if (count <= 0) break;
+#endif
+        done += (uint64_t)count;
+    }
+    return done;
+}
+
+static inline const ObjToBinMesh* ObjToBinStreamGetMesh(const ObjToBinStream* stream, uint32_t m) {
+    return (const ObjToBinMesh*)(stream->Meshes + (size_t)m * stream->Header.MeshRecordSize);
+}
+
+// Size of the vertex buffer of a request for the mesh
+static inline uint64_t ObjToBinStreamVertexBytes(const ObjToBinStream* stream, const ObjToBinMesh* mesh) {
+    return (uint64_t)mesh->VertexCount * stream->Header.VertexSize;
+}
+
+// Size of the index buffer of a request for the mesh, which holds the mesh's indices then those of its levels of
+// detail. Level l starts ObjToBinGetLod(...)->IndexOffset - mesh->IndexOffset bytes in to the buffer.
+static inline uint64_t ObjToBinStreamIndexBytes(const ObjToBinStream* stream, const ObjToBinMesh* mesh) {
+    uint64_t end = mesh->IndexOffset + (uint64_t)mesh->IndexCount * mesh->IndexSize;
+    for (uint32_t l = mesh->LodFirst; l < mesh->LodFirst + mesh->LodCount; ++l) {
+        uint64_t lodEnd = stream->Lods[l].IndexOffset + (uint64_t)stream->Lods[l].IndexCount * mesh->IndexSize;
+        if (lodEnd > end) end = lodEnd;
+    }
+    return end - mesh->IndexOffset;
+}
+
+// Reads and checks the table of a compressed section, section 0 for vertices and 1 for indices
+static inline int ObjToBinStreamReadBlocks(ObjToBinStream* stream, const ObjToBinSection* section, int part, uint64_t* decodedSize) {
+    ObjToBinCompressed compressed;
+    if (section->Size < sizeof(ObjToBinCompressed) ||
+        ObjToBinReadAt(stream->File, &compressed, sizeof(ObjToBinCompressed), section->Offset) != sizeof(ObjToBinCompressed) ||
+        compressed.BlockCount != stream->Header.MeshCount ||
+        compressed.BlockCount > (section->Size - sizeof(ObjToBinCompressed)) / sizeof(ObjToBinBlock)) {
+        return OBJTOBIN_ERROR_CORRUPT;
+    }
+    uint64_t tableSize = (uint64_t)compressed.BlockCount * sizeof(ObjToBinBlock);
+    stream->Blocks[part] = (ObjToBinBlock*)malloc((size_t)tableSize + 1);
+    if (!stream->Blocks[part]) return OBJTOBIN_ERROR_MEMORY;
+    if (ObjToBinReadAt(stream->File, stream->Blocks[part], tableSize, section->Offset + sizeof(ObjToBinCompressed)) != tableSize) {
+        return OBJTOBIN_ERROR_CORRUPT;
+    }
+    for (uint32_t b = 0; b < compressed.BlockCount; ++b) {
+        const ObjToBinBlock* block = &stream->Blocks[part][b];
+        if (block->Offset > section->Size || block->Size > section->Size - block->Offset || block->Size > block->StreamSize) {
+            return OBJTOBIN_ERROR_CORRUPT;
+        }
+    }
+    *decodedSize = compressed.DecodedSize;
+    return OBJTOBIN_OK;
+}
+
+// Reads the tables of the pack and checks them as ObjToBinValidate does, leaving out the meshlets
+static inline int ObjToBinStreamReadTables(ObjToBinStream* stream) {
+    ObjToBinHeader* header = &stream->Header;
+    if (ObjToBinReadAt(stream->File, header, sizeof(ObjToBinHeader), 0) != sizeof(ObjToBinHeader) || header->Magic != OBJTOBIN_MAGIC) {
+        return OBJTOBIN_ERROR_FORMAT;
+    }
+    if (header->Version != OBJTOBIN_VERSION) return OBJTOBIN_ERROR_VERSION;
+    if (header->HeaderSize < sizeof(ObjToBinHeader) || header->MeshRecordSize < offsetof(ObjToBinMesh, LodFirst) ||
+        header->SectionTableOffset % 8 != 0 || header->SectionTableOffset > stream->Size ||
+        header->SectionCount > (stream->Size - header->SectionTableOffset) / sizeof(ObjToBinSection)) {
+        return OBJTOBIN_ERROR_CORRUPT;
+    }
+    uint64_t tableSize = (uint64_t)header->SectionCount * sizeof(ObjToBinSection);
+    ObjToBinSection* sections = (ObjToBinSection*)malloc((size_t)tableSize + 1);
+    if (!sections) return OBJTOBIN_ERROR_MEMORY;
+    int result = ObjToBinReadAt(stream->File, sections, tableSize, header->SectionTableOffset) == tableSize ? OBJTOBIN_OK : OBJTOBIN_ERROR_CORRUPT;
+    const ObjToBinSection* found[OBJTOBIN_SECTION_COMPRESSED_INDICES + 1] = { NULL };
+    for (uint32_t s = 0; result == OBJTOBIN_OK && s < header->SectionCount; ++s) {
+        const ObjToBinSection* section = &sections[s];
+        if (section->Offset % OBJTOBIN_ALIGNMENT != 0 || section->Offset > stream->Size || section->Size > stream->Size - section->Offset) {
+            result = OBJTOBIN_ERROR_CORRUPT;
+        }
+        else if (section->Type <= OBJTOBIN_SECTION_COMPRESSED_INDICES && !found[section->Type]) found[section->Type] = section;
+    }
+
+    const ObjToBinSection* meshes = found[OBJTOBIN_SECTION_MESHES];
+    uint64_t sizes[2] = { 0, 0 };
+    for (int part = 0; result == OBJTOBIN_OK && part < 2; ++part) {
+        const ObjToBinSection* raw = found[OBJTOBIN_SECTION_VERTICES + part];
+        const ObjToBinSection* compressed = found[OBJTOBIN_SECTION_COMPRESSED_VERTICES + part];
+        if (raw) sizes[part] = raw->Size;
+        else if (compressed) result = ObjToBinStreamReadBlocks(stream, compressed, part, &sizes[part]);
+        else result = OBJTOBIN_ERROR_CORRUPT;
+        stream->SectionOffsets[part] = raw ? raw->Offset : compressed ? compressed->Offset : 0;
+    }
+    if (result == OBJTOBIN_OK && (!meshes || meshes->Size / header->MeshRecordSize < header->MeshCount ||
+                                  (header->VertexSize && sizes[0] / header->VertexSize < header->TotalVertices))) {
+        result = OBJTOBIN_ERROR_CORRUPT;
+    }
+    const ObjToBinSection* lods = found[OBJTOBIN_SECTION_LODS];
+    if (result == OBJTOBIN_OK && lods && lods->Size % sizeof(ObjToBinLod) != 0) result = OBJTOBIN_ERROR_CORRUPT;
+    if (result == OBJTOBIN_OK) {
+        uint64_t meshBytes = (uint64_t)header->MeshCount * header->MeshRecordSize;
+        stream->Meshes = (unsigned char*)malloc((size_t)meshBytes + 1);
+        stream->LodCount = lods ? lods->Size / sizeof(ObjToBinLod) : 0;
+        stream->Lods = lods ? (ObjToBinLod*)malloc((size_t)lods->Size + 1) : NULL;
+        if (!stream->Meshes || (lods && !stream->Lods)) result = OBJTOBIN_ERROR_MEMORY;
+        else if (ObjToBinReadAt(stream->File, stream->Meshes, meshBytes, meshes->Offset) != meshBytes ||
+                 (lods && ObjToBinReadAt(stream->File, stream->Lods, lods->Size, lods->Offset) != lods->Size)) {
+            result = OBJTOBIN_ERROR_CORRUPT;
+        }
+    }
+    free(sections);
+
+    for (uint32_t m = 0; result == OBJTOBIN_OK && m < header->MeshCount; ++m) {
+        const ObjToBinMesh* mesh = ObjToBinStreamGetMesh(stream, m);
+        if (mesh->VertexOffset > header->TotalVertices || mesh->VertexCount > header->TotalVertices - mesh->VertexOffset ||
+            (mesh->IndexSize != 2 && mesh->IndexSize != 4) || mesh->IndexOffset > sizes[1] ||
+            (uint64_t)mesh->IndexCount * mesh->IndexSize > sizes[1] - mesh->IndexOffset) {
+            result = OBJTOBIN_ERROR_CORRUPT;
+        }
+        if (mesh->LodCount > 0 && (header->MeshRecordSize < offsetof(ObjToBinMesh, MeshletCount) || mesh->LodFirst > stream->LodCount ||
+                                   mesh->LodCount > stream->LodCount - mesh->LodFirst)) {
+            result = OBJTOBIN_ERROR_CORRUPT;
+        }
+        // Levels of detail are read with their mesh, so must come after its indices
+        for (uint32_t l = mesh->LodFirst; result == OBJTOBIN_OK && l < mesh->LodFirst + mesh->LodCount; ++l) {
+            const ObjToBinLod* lod = &stream->Lods[l];
+            if (lod->IndexOffset % 4 != 0 || lod->IndexOffset < mesh->IndexOffset || lod->IndexOffset > sizes[1] ||
+                (uint64_t)lod->IndexCount * mesh->IndexSize > sizes[1] - lod->IndexOffset) {
+                result = OBJTOBIN_ERROR_CORRUPT;
+            }
+        }
+    }
+    return result;
+}
+
+// True if mesh m uses the same vertices as the mesh before it, see ObjToBinSharesVertices
+static inline int ObjToBinStreamSharesVertices(const ObjToBinStream* stream, uint32_t m) {
+    if (m == 0) return 0;
+    const ObjToBinMesh* mesh = ObjToBinStreamGetMesh(stream, m);
+    const ObjToBinMesh* previous = ObjToBinStreamGetMesh(stream, m - 1);
+    return mesh->VertexCount > 0 && mesh->VertexOffset == previous->VertexOffset && mesh->VertexCount == previous->VertexCount;
+}
+
+// Decodes the compressed parts of an op once read, as ObjToBinDecode does for a whole pack
+static inline int ObjToBinStreamDecode(const ObjToBinStream* stream, ObjToBinStreamOp* op) {
+    const ObjToBinMesh* mesh = ObjToBinStreamGetMesh(stream, op->Request.Mesh);
+    for (int part = 0; part < 2; ++part) {
+        if (!op->Encoded[part]) continue;
+        const ObjToBinBlock* block = &stream->Blocks[part][op->Block[part]];
+        uint64_t indexCount = mesh->IndexCount;
+        for (uint32_t l = mesh->LodFirst; l < mesh->LodFirst + mesh->LodCount; ++l) indexCount += stream->Lods[l].IndexCount;
+        if ((part == 0 && block->StreamSize != ObjToBinStreamVertexBytes(stream, mesh)) || (part == 1 && block->StreamSize > indexCount * 6)) {
+            return OBJTOBIN_ERROR_CORRUPT;
+        }
+        const uint8_t* src = op->Encoded[part];
+        uint8_t* decoded = NULL;
+        if (block->Size < block->StreamSize) {
+            decoded = (uint8_t*)malloc((size_t)block->StreamSize);
+            if (!decoded) return OBJTOBIN_ERROR_MEMORY;
+            if (!ObjToBinLzDecode(decoded, block->StreamSize, src, block->Size)) {
+                free(decoded);
+                return OBJTOBIN_ERROR_CORRUPT;
+            }
+            src = decoded;
+        }
+        int valid;
+        if (part == 0) valid = ObjToBinDecodeVertices(&stream->Header, (uint8_t*)op->Request.Vertices, src, mesh->VertexCount);
+        else {
+            const uint8_t* end = src + block->StreamSize;
+            uint8_t* indices = (uint8_t*)op->Request.Indices;
+            src = ObjToBinDecodeIndices(indices, mesh->IndexCount, mesh->IndexSize, src, end);
+            for (uint32_t l = mesh->LodFirst; src && l < mesh->LodFirst + mesh->LodCount; ++l) {
+                const ObjToBinLod* lod = &stream->Lods[l];
+                src = ObjToBinDecodeIndices(indices + (lod->IndexOffset - mesh->IndexOffset), lod->IndexCount, mesh->IndexSize, src, end);
+            }
+            valid = src == end;
+        }
+        free(decoded);
+        if (!valid) return OBJTOBIN_ERROR_CORRUPT;
+    }
+    return OBJTOBIN_OK;
+}
+
+// Sets up the parts of an op for a request, an op with no parts is complete already
+static inline int ObjToBinStreamBeginOp(ObjToBinStream* stream, ObjToBinStreamOp* op, const ObjToBinStreamRequest* request) {
+    memset(op, 0, sizeof(ObjToBinStreamOp));
+    op->Request = *request;
+    const ObjToBinMesh* mesh = ObjToBinStreamGetMesh(stream, request->Mesh);
+    void* buffers[2] = { request->Vertices, request->Indices };
+    uint64_t sizes[2] = { ObjToBinStreamVertexBytes(stream, mesh), ObjToBinStreamIndexBytes(stream, mesh) };
+    uint64_t offsets[2] = { mesh->VertexOffset * stream->Header.VertexSize, mesh->IndexOffset };
+    // Meshes sharing vertices have an empty block, the vertices are in the block of the first mesh sharing them
+    uint32_t blocks[2] = { request->Mesh, request->Mesh };
+    while (blocks[0] > 0 && ObjToBinStreamSharesVertices(stream, blocks[0])) --blocks[0];
+    for (int part = 0; part < 2; ++part) {
+        if (!buffers[part] || sizes[part] == 0) continue;
+        if (stream->Blocks[part]) {
+            const ObjToBinBlock* block = &stream->Blocks[part][blocks[part]];
+            op->Block[part] = blocks[part];
+            op->Encoded[part] = (unsigned char*)malloc((size_t)block->Size + 1);
+            if (!op->Encoded[part]) return OBJTOBIN_ERROR_MEMORY;
+            op->Dst[part] = op->Encoded[part];
+            op->Offset[part] = stream->SectionOffsets[part] + block->Offset;
+            op->Size[part] = block->Size;
+        }
+        else {
+            op->Dst[part] = (unsigned char*)buffers[part];
+            op->Offset[part] = stream->SectionOffsets[part] + offsets[part];
+            op->Size[part] = sizes[part];
+        }
+        // An empty block has nothing to read, it is still checked when decoded
+        if (op->Size[part] > 0) op->Parts++;
+    }
+    return OBJTOBIN_OK;
+}
+
+// Frees the op's memory and returns it to the free list
+static inline void ObjToBinStreamEndOp(ObjToBinStream* stream, uint32_t index) {
+    ObjToBinStreamOp* op = &stream->Ops[index];
+    free(op->Encoded[0]);
+    free(op->Encoded[1]);
+    op->Encoded[0] = NULL;
+    op->Encoded[1] = NULL;
+    stream->FreeOps[stream->FreeCount++] = index;
+    stream->Reading--;
+}
+
+// Hands an op, every part read, to the next ObjToBinStreamPoll
+static inline void ObjToBinStreamComplete(ObjToBinStream* stream, uint32_t index, int locked) {
+    ObjToBinStreamOp* op = &stream->Ops[index];
+    if (op->Result == OBJTOBIN_OK) op->Result = ObjToBinStreamDecode(stream, op);
+    if (!locked && stream->Backend == OBJTOBIN_STREAM_THREADS) ObjToBinMutexLock(&stream->Lock);
+    stream->Completed[stream->CompletedCount++] = index;
+    if (!locked && stream->Backend == OBJTOBIN_STREAM_THREADS) ObjToBinMutexUnlock(&stream->Lock);
+}
+
+#ifdef _WIN32
+static DWORD WINAPI ObjToBinStreamWorker(LPVOID param) {
+#else
+static void* ObjToBinStreamWorker(void* param) {
+#endif
+    ObjToBinStream* stream = (ObjToBinStream*)param;
+    ObjToBinMutexLock(&stream->Lock);
+    for (;;) {
+        while (stream->WorkCount == 0 && !stream->Stop) ObjToBinCondWait(&stream->WorkReady, &stream->Lock);
+        if (stream->WorkCount == 0) break;
+        uint32_t index = stream->Work[stream->WorkHead];
+        stream->WorkHead = (stream->WorkHead + 1) % OBJTOBIN_STREAM_DEPTH;
+        stream->WorkCount--;
+        ObjToBinMutexUnlock(&stream->Lock);
+
+        ObjToBinStreamOp* op = &stream->Ops[index];
+        for (int part = 0; part < 2; ++part) {
+            if (op->Size[part] > 0 && ObjToBinReadAt(stream->File, op->Dst[part], op->Size[part], op->Offset[part]) != op->Size[part]) {
+                op->Result = OBJTOBIN_ERROR_CORRUPT;
+            }
+        }
+        if (op->Result == OBJTOBIN_OK) op->Result = ObjToBinStreamDecode(stream, op);
+
+        ObjToBinMutexLock(&stream->Lock);
+        stream->Completed[stream->CompletedCount++] = index;
+        ObjToBinCondSignal(&stream->WorkDone);
+    }
+    ObjToBinMutexUnlock(&stream->Lock);
+    return 0;
+}
+
+static inline int ObjToBinStreamStartThreads(ObjToBinStream* stream) {
+    ObjToBinMutexInit(&stream->Lock);
+    ObjToBinCondInit(&stream->WorkReady);
+    ObjToBinCondInit(&stream->WorkDone);
+    stream->Backend = OBJTOBIN_STREAM_THREADS;
+    for (uint32_t t = 0; t < OBJTOBIN_STREAM_READERS; ++t) {
+#ifdef _WIN32
+        stream->Threads[stream->ThreadCount] = CreateThread(NULL, 0, ObjToBinStreamWorker, stream, 0, NULL);
+        if (stream->Threads[stream->ThreadCount]) stream->ThreadCount++;
+#else
+        if (pthread_create(&stream->Threads[stream->ThreadCount], NULL, ObjToBinStreamWorker, stream) == 0) stream->ThreadCount++;
+#endif
+    }
+    return stream->ThreadCount > 0;
+}
+
+static inline void ObjToBinStreamStopThreads(ObjToBinStream* stream) {
+    ObjToBinMutexLock(&stream->Lock);
+    stream->Stop = 1;
+    ObjToBinCondBroadcast(&stream->WorkReady);
+    ObjToBinMutexUnlock(&stream->Lock);
+    for (uint32_t t = 0; t < stream->ThreadCount; ++t) {
+#ifdef _WIN32
+        WaitForSingleObject(stream->Threads[t], INFINITE);
+        CloseHandle(stream->Threads[t]);
+#else
+        pthread_join(stream->Threads[t], NULL);
+#endif
+    }
+    ObjToBinCondDestroy(&stream->WorkReady);
+    ObjToBinCondDestroy(&stream->WorkDone);
+    ObjToBinMutexDestroy(&stream->Lock);
+}
+
+#ifdef OBJTOBIN_IO_URING
+static inline void ObjToBinRingClose(ObjToBinRing* ring) {
+    if (ring->Sqes) munmap(ring->Sqes, ring->SqesSize);
+    if (ring->CqMap && ring->CqMap != ring->SqMap) munmap(ring->CqMap, ring->CqMapSize);
+    if (ring->SqMap) munmap(ring->SqMap, ring->SqMapSize);
+    if (ring->Fd >= 0) close(ring->Fd);
+    memset(ring, 0, sizeof(ObjToBinRing));
+    ring->Fd = -1;
+}
+
+// Sets up a ring with room for both parts of every op, returns 0 if the kernel does not allow io_uring
+static inline int ObjToBinRingOpen(ObjToBinRing* ring) {
+    struct io_uring_params params;
+    memset(ring, 0, sizeof(ObjToBinRing));
+    memset(&params, 0, sizeof(params));
+    ring->Fd = (int)syscall(__NR_io_uring_setup, OBJTOBIN_STREAM_DEPTH * 2, &params);
+    if (ring->Fd < 0) return 0;
+    ring->SqMapSize = params.sq_off.array + params.sq_entries * sizeof(uint32_t);
+    ring->CqMapSize = params.cq_off.cqes + params.cq_entries * sizeof(struct io_uring_cqe);
+    if (params.features & IORING_FEAT_SINGLE_MMAP) {
+        if (ring->CqMapSize > ring->SqMapSize) ring->SqMapSize = ring->CqMapSize;
+        ring->CqMapSize = ring->SqMapSize;
+    }
+    void* sq = mmap(NULL, ring->SqMapSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring->Fd, IORING_OFF_SQ_RING);
+    ring->SqMap = sq == MAP_FAILED ? NULL : sq;
+    void* cq = params.features & IORING_FEAT_SINGLE_MMAP ? sq :
+               mmap(NULL, ring->CqMapSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring->Fd, IORING_OFF_CQ_RING);
+    ring->CqMap = cq == MAP_FAILED ? NULL : cq;
+    ring->SqesSize = params.sq_entries * sizeof(struct io_uring_sqe);
+    void* sqes = mmap(NULL, ring->SqesSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring->Fd, IORING_OFF_SQES);
+    ring->Sqes = sqes == MAP_FAILED ? NULL : (struct io_uring_sqe*)sqes;
+    if (!ring->SqMap || !ring->CqMap || !ring->Sqes) {
+        ObjToBinRingClose(ring);
+        return 0;
+    }
+    unsigned char* sqBase = (unsigned char*)ring->SqMap;
+    unsigned char* cqBase = (unsigned char*)ring->CqMap;
+    ring->SqHead = (uint32_t*)(sqBase + params.sq_off.head);
+    ring->SqTail = (uint32_t*)(sqBase + params.sq_off.tail);
+    ring->SqMask = *(uint32_t*)(sqBase + params.sq_off.ring_mask);
+    ring->SqArray = (uint32_t*)(sqBase + params.sq_off.array);
+    ring->CqHead = (uint32_t*)(cqBase + params.cq_off.head);
+    ring->CqTail = (uint32_t*)(cqBase + params.cq_off.tail);
+    ring->CqMask = *(uint32_t*)(cqBase + params.cq_off.ring_mask);
+    ring->Cqes = (struct io_uring_cqe*)(cqBase + params.cq_off.cqes);
+    return 1;
+}
+
+// Queues the read of what is left of a part, submitted by ObjToBinRingEnter. There is always room as the ring holds
+// both parts of every op.
+static inline void ObjToBinRingRead(ObjToBinStream* stream, uint32_t index, int part) {
+    ObjToBinRing* ring = &stream->Ring;
+    ObjToBinStreamOp* op = &stream->Ops[index];
+    uint64_t left = op->Size[part] - op->Done[part];
+    op->Iov[part].iov_base = op->Dst[part] + op->Done[part];
+    op->Iov[part].iov_len = left < OBJTOBIN_STREAM_MAX_READ ? (size_t)left : OBJTOBIN_STREAM_MAX_READ;
+    uint32_t tail = *ring->SqTail;
+    uint32_t slot = tail & ring->SqMask;
+    struct io_uring_sqe* sqe = &ring->Sqes[slot];
+    memset(sqe, 0, sizeof(struct io_uring_sqe));
+    sqe->opcode = IORING_OP_READV;
+    sqe->fd = stream->File;
+    sqe->off = op->Offset[part] + op->Done[part];
+    sqe->addr = (uint64_t)(uintptr_t)&op->Iov[part];
+    sqe->len = 1;
+    sqe->user_data = (uint64_t)index * 2 + (uint64_t)part;
+    ring->SqArray[slot] = slot;
+    __atomic_store_n(ring->SqTail, tail + 1, __ATOMIC_RELEASE);
+    ring->Queued++;
+}
+
+// Submits the queued reads, and waits for a completion if wait is set
+static inline int ObjToBinRingEnter(ObjToBinRing* ring, int wait) {
+    for (;;) {
+        long submitted = syscall(__NR_io_uring_enter, ring->Fd, ring->Queued, wait ? 1 : 0, wait ? IORING_ENTER_GETEVENTS : 0, NULL, 0);
+        if (submitted >= 0) {
+            ring->Queued -= (uint32_t)submitted;
+            return 1;
+        }
+        if (errno != EINTR && errno != EAGAIN && errno != EBUSY) return 0;
+    }
+}
+
+// Takes every completion off the ring, resubmitting short reads and completing ops with every part read
+static inline void ObjToBinRingReap(ObjToBinStream* stream) {
+    ObjToBinRing* ring = &stream->Ring;
+    uint32_t head = *ring->CqHead;
+    uint32_t tail = __atomic_load_n(ring->CqTail, __ATOMIC_ACQUIRE);
+    for (; head != tail; ++head) {
+        const struct io_uring_cqe* cqe = &ring->Cqes[head & ring->CqMask];
+        uint32_t index = (uint32_t)(cqe->user_data / 2);
+        int part = (int)(cqe->user_data % 2);
+        ObjToBinStreamOp* op = &stream->Ops[index];
+        if (cqe->res == -EINTR || cqe->res == -EAGAIN) {
+            ObjToBinRingRead(stream, index, part);
+            continue;
+        }
+        if (cqe->res > 0) op->Done[part] += (uint64_t)cqe->res;
+        if (cqe->res > 0 && op->Done[part] < op->Size[part]) {
+            ObjToBinRingRead(stream, index, part);
+            continue;
+        }
+        // An error, or the end of the file before the part was read
+        if (op->Done[part] < op->Size[part]) op->Result = cqe->res < 0 ? OBJTOBIN_ERROR_OPEN : OBJTOBIN_ERROR_CORRUPT;
+        if (--op->Parts == 0) ObjToBinStreamComplete(stream, index, 0);
+    }
+    __atomic_store_n(ring->CqHead, head, __ATOMIC_RELEASE);
+}
+#endif
+
+// Starts reading queued requests, loads first, while there are free ops
+static inline void ObjToBinStreamSubmit(ObjToBinStream* stream) {
+    int queued = 0;
+    while (stream->FreeCount > 0 && (stream->Loads.Count > 0 || stream->Prefetches.Count > 0)) {
+        ObjToBinStreamQueue* queue = stream->Loads.Count > 0 ? &stream->Loads : &stream->Prefetches;
+        ObjToBinStreamRequest request = queue->Items[queue->Head];
+        queue->Head = (queue->Head + 1) % queue->Capacity;
+        queue->Count--;
+        uint32_t index = stream->FreeOps[--stream->FreeCount];
+        ObjToBinStreamOp* op = &stream->Ops[index];
+        stream->Reading++;
+        op->Result = ObjToBinStreamBeginOp(stream, op, &request);
+        if (op->Result != OBJTOBIN_OK || op->Parts == 0) {
+            ObjToBinStreamComplete(stream, index, 0);
+            continue;
+        }
+#ifdef OBJTOBIN_IO_URING
+        if (stream->Backend == OBJTOBIN_STREAM_IO_URING) {
+            for (int part = 0; part < 2; ++part) {
+                if (op->Size[part] > 0) ObjToBinRingRead(stream, index, part);
+            }
+            queued = 1;
+            continue;
+        }
+#endif
+        ObjToBinMutexLock(&stream->Lock);
+        stream->Work[(stream->WorkHead + stream->WorkCount++) % OBJTOBIN_STREAM_DEPTH] = index;
+        ObjToBinCondSignal(&stream->WorkReady);
+        ObjToBinMutexUnlock(&stream->Lock);
+    }
+#ifdef OBJTOBIN_IO_URING
+    // Reads the kernel did not take stay queued for the next submit
+    if (queued) ObjToBinRingEnter(&stream->Ring, 0);
+#endif
+    (void)queued;
+}
+
+// Takes the completed ops, waiting for one if wait is set and any are being read. Callbacks are run if run is set.
+// Returns the number of requests completed.
+static inline uint32_t ObjToBinStreamFinish(ObjToBinStream* stream, int wait, int run) {
+    uint32_t completed[OBJTOBIN_STREAM_DEPTH];
+    uint32_t count = 0;
+#ifdef OBJTOBIN_IO_URING
+    if (stream->Backend == OBJTOBIN_STREAM_IO_URING) {
+        ObjToBinRingReap(stream);
+        while (wait && stream->CompletedCount == 0 && stream->Reading > 0 && ObjToBinRingEnter(&stream->Ring, 1)) ObjToBinRingReap(stream);
+        // Short reads queued while reaping
+        if (stream->Ring.Queued > 0) ObjToBinRingEnter(&stream->Ring, 0);
+    }
+#endif
+    if (stream->Backend == OBJTOBIN_STREAM_THREADS) ObjToBinMutexLock(&stream->Lock);
+    while (stream->Backend == OBJTOBIN_STREAM_THREADS && wait && stream->CompletedCount == 0 && stream->Reading > 0) {
+        ObjToBinCondWait(&stream->WorkDone, &stream->Lock);
+    }
+    count = stream->CompletedCount;
+    memcpy(completed, stream->Completed, count * sizeof(uint32_t));
+    stream->CompletedCount = 0;
+    if (stream->Backend == OBJTOBIN_STREAM_THREADS) ObjToBinMutexUnlock(&stream->Lock);
+
+    for (uint32_t c = 0; c < count; ++c) {
+        ObjToBinStreamOp* op = &stream->Ops[completed[c]];
+        ObjToBinStreamRequest request = op->Request;
+        int result = op->Result;
+        // The op is free before the callback, which may make requests of its own
+        ObjToBinStreamEndOp(stream, completed[c]);
+        if (run && request.Callback) request.Callback(request.User, request.Mesh, result);
+    }
+    return count;
+}
+
+static inline int ObjToBinStreamPush(ObjToBinStreamQueue* queue, const ObjToBinStreamRequest* request) {
+    if (queue->Count == queue->Capacity) {
+        uint32_t capacity = queue->Capacity > 0 ? queue->Capacity * 2 : OBJTOBIN_STREAM_DEPTH;
+        ObjToBinStreamRequest* items = (ObjToBinStreamRequest*)malloc(capacity * sizeof(ObjToBinStreamRequest));
+        if (!items) return OBJTOBIN_ERROR_MEMORY;
+        for (uint32_t i = 0; i < queue->Count; ++i) items[i] = queue->Items[(queue->Head + i) % queue->Capacity];
+        free(queue->Items);
+        queue->Items = items;
+        queue->Head = 0;
+        queue->Capacity = capacity;
+    }
+    queue->Items[(queue->Head + queue->Count++) % queue->Capacity] = *request;
+    return OBJTOBIN_OK;
+}
+
+static inline void ObjToBinStreamClose(ObjToBinStream* stream) {
+    // Reads in flight write to the caller's buffers, so are waited for, queued requests are dropped
+    stream->Loads.Count = 0;
+    stream->Prefetches.Count = 0;
+    while (stream->Reading > 0) ObjToBinStreamFinish(stream, 1, 0);
+    if (stream->Backend == OBJTOBIN_STREAM_THREADS) ObjToBinStreamStopThreads(stream);
+#ifdef OBJTOBIN_IO_URING
+    if (stream->Backend == OBJTOBIN_STREAM_IO_URING) ObjToBinRingClose(&stream->Ring);
+#endif
+#ifdef _WIN32
+    if (stream->File && stream->File != INVALID_HANDLE_VALUE) CloseHandle(stream->File);
+#else
+    if (stream->File >= 0) close(stream->File);
+#endif
+    free(stream->Meshes);
+    free(stream->Lods);
+    free(stream->Blocks[0]);
+    free(stream->Blocks[1]);
+    free(stream->Loads.Items);
+    free(stream->Prefetches.Items);
+    memset(stream, 0, sizeof(ObjToBinStream));
+    // Closed streams hold no file, so closing one again closes nothing
+#ifdef _WIN32
+    stream->File = INVALID_HANDLE_VALUE;
+#else
+    stream->File = -1;
+#endif
+}
+
+// Opens the pack at path and reads its tables, the stream is left closed on failure
+static inline int ObjToBinStreamOpen(ObjToBinStream* stream, const char* path, int backend) {
+    memset(stream, 0, sizeof(ObjToBinStream));
+#ifdef _WIN32
+    LARGE_INTEGER size;
+    stream->File = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+    if (stream->File == INVALID_HANDLE_VALUE || !GetFileSizeEx(stream->File, &size)) {
+        ObjToBinStreamClose(stream);
+        return OBJTOBIN_ERROR_OPEN;
+    }
+    stream->Size = (uint64_t)size.QuadPart;
+#else
+    struct stat info;
+    stream->File = open(path, O_RDONLY);
+    if (stream->File < 0 || fstat(stream->File, &info) != 0) {
+        ObjToBinStreamClose(stream);
+        return OBJTOBIN_ERROR_OPEN;
+    }
+    stream->Size = (uint64_t)info.st_size;
+#endif
+    for (uint32_t op = 0; op < OBJTOBIN_STREAM_DEPTH; ++op) stream->FreeOps[op] = OBJTOBIN_STREAM_DEPTH - 1 - op;
+    stream->FreeCount = OBJTOBIN_STREAM_DEPTH;
+    int result = ObjToBinStreamReadTables(stream);
+#ifdef OBJTOBIN_IO_URING
+    if (result == OBJTOBIN_OK && backend != OBJTOBIN_STREAM_THREADS && ObjToBinRingOpen(&stream->Ring)) stream->Backend = OBJTOBIN_STREAM_IO_URING;
+#endif
+    if (result == OBJTOBIN_OK && stream->Backend != OBJTOBIN_STREAM_IO_URING) {
+        if (backend == OBJTOBIN_STREAM_IO_URING) result = OBJTOBIN_ERROR_OPEN;
+        else if (!ObjToBinStreamStartThreads(stream)) result = OBJTOBIN_ERROR_MEMORY;
+    }
+    if (result != OBJTOBIN_OK) ObjToBinStreamClose(stream);
+    return result;
+}
+
+// Queues a request to be read as soon as there is room, before any prefetch. Fails if the mesh is not in the pack.
+static inline int ObjToBinStreamLoad(ObjToBinStream* stream, const ObjToBinStreamRequest* request) {
+    if (request->Mesh >= stream->Header.MeshCount) return OBJTOBIN_ERROR_CORRUPT;
+    int result = ObjToBinStreamPush(&stream->Loads, request);
+    if (result == OBJTOBIN_OK) ObjToBinStreamSubmit(stream);
+    return result;
+}
+
+// Queues a request to be read once no loads are waiting
+static inline int ObjToBinStreamPrefetch(ObjToBinStream* stream, const ObjToBinStreamRequest* request) {
+    if (request->Mesh >= stream->Header.MeshCount) return OBJTOBIN_ERROR_CORRUPT;
+    int result = ObjToBinStreamPush(&stream->Prefetches, request);
+    if (result == OBJTOBIN_OK) ObjToBinStreamSubmit(stream);
+    return result;
+}
+
+// Requests queued or being read
+static inline uint32_t ObjToBinStreamPending(const ObjToBinStream* stream) {
+    return stream->Reading + stream->Loads.Count + stream->Prefetches.Count;
+}
+
+// Runs the callbacks of completed requests and starts reading queued ones. With wait set it blocks until at least one
+// request completes, unless none are pending. Returns the number of requests completed.
+static inline uint32_t ObjToBinStreamPoll(ObjToBinStream* stream, int wait) {
+    ObjToBinStreamSubmit(stream);
+    uint32_t count = ObjToBinStreamFinish(stream, wait, 1);
+    ObjToBinStreamSubmit(stream);
+    return count;
+}
+
+#endif
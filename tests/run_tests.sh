@@ -0,0 +1,98 @@
+#!/bin/bash
+# Converts every obj in this directory as its first comment expects, then checks the round trips and modes that must
+# agree with each other. Usage: tests/run_tests.sh [objtobin binary], defaulting to ./objtobin
+# The tool returns 1 on success and 0 on failure.
+
+objtobin=$(realpath "${1:-./objtobin}")
+tests=$(cd "$(dirname "$0")" && pwd)
+work=$(mktemp -d)
+trap 'rm -rf "$work"' EXIT
+failures=0
+
+fail() {
+    echo "FAILED: $1"
+    failures=$((failures + 1))
+}
+
+# Succeeds if the tool does, keeping its output in $work/log
+run() {
+    "$objtobin" "$@" > "$work/log" 2>&1
+    [ $? -eq 1 ]
+}
+
+mesh_count() {
+    "$objtobin" -i "$1" | sed -n 's/^Mesh count: \([0-9]*\).*/\1/p'
+}
+
+# The pack as -i prints it, without the compressed section sizes
+dump() {
+    "$objtobin" -i "$1" | grep -v '^Compressed'
+}
+
+# Fixtures, "Expected to fail: ... line N ..." or "Expected to convert to N meshes [of M triangles]"
+for obj in "$tests"/*.obj; do
+    name=$(basename "$obj")
+    expected=$(head -n 1 "$obj")
+    for flags in "" "-j 4" "-s 1"; do
+        if [[ $expected == *"Expected to fail"* ]]; then
+            line=$(echo "$expected" | sed -n 's/.*line \([0-9]*\).*/\1/p')
+            if run -c "$obj" "$work/fixture.bin" $flags; then fail "$name [$flags] converted"
+            elif ! grep -qi "line $line\b" "$work/log"; then fail "$name [$flags] did not name line $line"
+            fi
+        else
+            meshes=$(echo "$expected" | sed -n 's/.*convert to \([0-9]*\) meshes.*/\1/p')
+            triangles=$(echo "$expected" | sed -n 's/.* of \([0-9]*\) triangles.*/\1/p')
+            if ! run -c "$obj" "$work/fixture.bin" $flags; then fail "$name [$flags] failed to convert"; continue; fi
+            [ "$(mesh_count "$work/fixture.bin")" = "$meshes" ] || fail "$name [$flags] did not give $meshes meshes"
+            if [ -n "$triangles" ] && "$objtobin" -i "$work/fixture.bin" | grep '^Object' | grep -qv "Index Count $((triangles * 3)) "; then
+                fail "$name [$flags] has meshes without $triangles triangles"
+            fi
+        fi
+    done
+done
+
+run -g grid 20000 "$work/grid.obj" ptn 3 || fail "generating a grid"
+run -g soup 20000 "$work/soup.obj" pn 5 || fail "generating a soup"
+
+# -c then -i, every mesh and vertex of the obj is read back
+if ! run -c "$work/grid.obj" "$work/grid.bin" -o -t; then fail "converting the grid"
+elif [ "$(mesh_count "$work/grid.bin")" != 3 ]; then fail "the grid did not read back as 3 meshes"
+else
+    vertices=$("$objtobin" -i "$work/grid.bin" | sed -n 's/.*Vertex Count \([0-9]*\).*/\1/p' | awk '{ s += $1 } END { print s }')
+    [ "$("$objtobin" -i "$work/grid.bin" | grep -c '^Vertex ')" = "$vertices" ] || fail "the grid did not read back all $vertices vertices"
+fi
+
+# -z decodes to the raw pack
+for obj in grid soup; do
+    run -c "$work/$obj.obj" "$work/raw.bin" -o -l 2 && run -c "$work/$obj.obj" "$work/compressed.bin" -o -l 2 -z || { fail "converting the $obj"; continue; }
+    cmp -s "$work/raw.bin" "$work/compressed.bin" && fail "the $obj was not compressed by -z"
+    [ "$(dump "$work/raw.bin" | md5sum)" = "$(dump "$work/compressed.bin" | md5sum)" ] || fail "the compressed $obj differs from the raw one"
+done
+
+# -b merges packs of one layout and rejects packs of another
+run -c "$work/grid.obj" "$work/a.bin" && run -c "$work/grid.obj" "$work/optimized.bin" -o && run -c "$work/soup.obj" "$work/b.bin" &&
+    run -c "$work/soup.obj" "$work/planar.bin" -p || fail "converting the packs to merge"
+if ! run -b "$work/merged.bin" "$work/a.bin" "$work/optimized.bin"; then fail "merging packs of one layout"
+elif [ "$(mesh_count "$work/merged.bin")" != 6 ]; then fail "the merged pack does not have 6 meshes"
+fi
+run -b "$work/merged.bin" "$work/a.bin" "$work/b.bin" && fail "merging packs with different attributes"
+run -b "$work/merged.bin" "$work/b.bin" "$work/planar.bin" && fail "merging interleaved and planar packs"
+
+# Parsing in parallel gives the same pack as parsing on one thread
+for obj in "$work/grid.obj" "$work/soup.obj" "$tests/interleaved_records.obj"; do
+    for flags in "" "-o --meshlets" "--shared"; do
+        run -c "$obj" "$work/one.bin" -j 1 $flags && run -c "$obj" "$work/many.bin" -j 8 $flags || { fail "$(basename "$obj") [$flags] failed to convert"; continue; }
+        cmp -s "$work/one.bin" "$work/many.bin" || fail "$(basename "$obj") [$flags] differs between -j 1 and -j 8"
+    done
+done
+
+# --cache misses then hits with the same pack
+run -c "$work/grid.obj" "$work/miss.bin" -o --cache "$work/cache" && run -c "$work/grid.obj" "$work/hit.bin" -o --cache "$work/cache" || fail "converting through the cache"
+[ "$(cut -d ' ' -f 1 "$work/cache/manifest.txt" | paste -sd ' ')" = "miss hit" ] || fail "the cache did not miss then hit"
+cmp -s "$work/miss.bin" "$work/hit.bin" || fail "the cache hit differs from the miss"
+
+if [ $failures -gt 0 ]; then
+    echo "$failures checks failed"
+    exit 1
+fi
+echo "All checks passed"